@@ -0,0 +1,488 @@
+/*
+	Benchmarks for the parser, lookups, serializer and json_node_free.
+	Every corpus is generated in memory from a fixed seed, so runs are comparable between versions.
+
+	usage: bench [output.json]
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../src/json.h"
+
+#define MIN_BENCH_SECONDS 0.25
+#define MAX_BENCH_ITERATIONS 10000
+
+typedef struct Buffer {
+	char* data;
+	ptrdiff_t length;
+	ptrdiff_t capacity;
+} Buffer;
+
+typedef struct Corpus {
+	char* name;
+	Buffer text;
+	bool isNdjson;
+} Corpus;
+
+typedef struct Result {
+	char* corpus;
+	char* operation;
+	ptrdiff_t bytes;		// bytes processed per iteration
+	ptrdiff_t nodes;		// nodes touched per iteration
+	ptrdiff_t iterations;
+	double seconds;
+	ptrdiff_t allocations;	// allocations per iteration
+	ptrdiff_t allocatedBytes; // bytes allocated per iteration
+} Result;
+
+typedef struct AllocStats {
+	ptrdiff_t allocations;
+	ptrdiff_t bytes;
+} AllocStats;
+
+
+static uint64_t seed = 0x9E3779B97F4A7C15ull;
+static uint64_t _random(void) {
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return seed;
+}
+
+static double _now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+// A counting allocator, installed into the benchmark's JsonContext
+static void* _countingAlloc(ptrdiff_t size, void* instance) {
+	AllocStats* stats = instance;
+	stats->allocations++;
+	stats->bytes += size;
+	return malloc((size_t)size);
+}
+
+static void _countingFree(void* ptr, ptrdiff_t size, void* instance) {
+	(void)size;
+	(void)instance;
+	free(ptr);
+}
+
+static void* _countingRealloc(void* ptr, ptrdiff_t newSize, ptrdiff_t oldSize, void* instance) {
+	AllocStats* stats = instance;
+	stats->allocations++;
+	stats->bytes += newSize - oldSize;
+	return realloc(ptr, (size_t)newSize);
+}
+
+
+static void _append(Buffer* buffer, const char* format, ...) {
+	va_list args;
+	while (true) {
+		va_start(args, format);
+		int written = vsnprintf(buffer->data + buffer->length, buffer->capacity - buffer->length, format, args);
+		va_end(args);
+		if (written < buffer->capacity - buffer->length) {
+			buffer->length += written;
+			return;
+		}
+		buffer->capacity = buffer->capacity * 2 + written;
+		buffer->data = realloc(buffer->data, buffer->capacity);
+	}
+}
+
+static Buffer _newBuffer(void) {
+	Buffer buffer = { malloc(1024), 0, 1024 };
+	return buffer;
+}
+
+static void _randomWord(char* out, int length) {
+	for (int i = 0; i < length; i++) {
+		out[i] = 'a' + (char)(_random() % 26);
+	}
+	out[length] = '\0';
+}
+
+static Corpus _numbersCorpus(void) {
+	Buffer text = _newBuffer();
+	_append(&text, "[");
+	for (int i = 0; i < 200000; i++) {
+		if (_random() % 2) {
+			_append(&text, "%s%lld", i ? "," : "", (long long)(_random() % 2000000) - 1000000);
+		} else {
+			_append(&text, "%s%.6f", i ? "," : "", (double)(_random() % 1000000) / 997.0);
+		}
+	}
+	_append(&text, "]");
+	return (Corpus){ "numbers", text, false };
+}
+
+static Corpus _stringsCorpus(void) {
+	Buffer text = _newBuffer();
+	char word[64];
+	_append(&text, "[");
+	for (int i = 0; i < 100000; i++) {
+		_randomWord(word, 4 + (int)(_random() % 40));
+		_append(&text, "%s\"%s%s\"", i ? "," : "", word, _random() % 8 ? "" : "\\n\\t\\\"escaped\\\"");
+	}
+	_append(&text, "]");
+	return (Corpus){ "strings", text, false };
+}
+
+static void _nested(Buffer* text, int depth) {
+	if (depth == 0) {
+		_append(text, "%d", (int)(_random() % 100));
+		return;
+	}
+	if (depth % 2) {
+		_append(text, "{\"level\":%d,\"child\":", depth);
+		_nested(text, depth - 1);
+		_append(text, "}");
+	} else {
+		_append(text, "[%d,", depth);
+		_nested(text, depth - 1);
+		_append(text, "]");
+	}
+}
+
+static Corpus _nestedCorpus(void) {
+	Buffer text = _newBuffer();
+	_append(&text, "[");
+	for (int i = 0; i < 2000; i++) {
+		_append(&text, "%s", i ? "," : "");
+		_nested(&text, 64);
+	}
+	_append(&text, "]");
+	return (Corpus){ "nested", text, false };
+}
+
+static Corpus _wideCorpus(void) {
+	Buffer text = _newBuffer();
+	char word[32];
+	_append(&text, "{");
+	for (int i = 0; i < 20000; i++) {
+		_randomWord(word, 8);
+		_append(&text, "%s\"%s_%d\":%d", i ? "," : "", word, i, i);
+	}
+	_append(&text, "}");
+	return (Corpus){ "wide", text, false };
+}
+
+static Corpus _ndjsonCorpus(void) {
+	Buffer text = _newBuffer();
+	char name[16];
+	for (int i = 0; i < 20000; i++) {
+		_randomWord(name, 10);
+		_append(
+			&text,
+			"{\"id\":%d,\"name\":\"%s\",\"score\":%.3f,\"active\":%s,\"tags\":[\"a\",\"b\"],\"parent\":null}\n",
+			i, name, (double)(_random() % 100000) / 7.0, _random() % 2 ? "true" : "false"
+		);
+	}
+	return (Corpus){ "ndjson", text, true };
+}
+
+
+// NOTE: NDJSON corpora are parsed one line at a time, everything else as a single document.
+// Lazily parsed roots mustn't be read, decoding would write into the corpus.
+static ptrdiff_t _parseAll(JsonContext* ctx, Corpus* corpus, JsonNode** roots, ptrdiff_t maxRoots, bool lazy) {
+	JsonNode* (*parse)(JsonContext*, char*, ptrdiff_t, JsonError*) = lazy ? json_parseLazyCtx : json_parseCtx;
+	if (!corpus->isNdjson) {
+		roots[0] = parse(ctx, corpus->text.data, corpus->text.length, NULL);
+		return 1;
+	}
+	ptrdiff_t count = 0;
+	char* line = corpus->text.data;
+	char* end = corpus->text.data + corpus->text.length;
+	while (line < end && count < maxRoots) {
+		char* newline = memchr(line, '\n', end - line);
+		ptrdiff_t lineLength = newline ? newline - line : end - line;
+		roots[count++] = parse(ctx, line, lineLength, NULL);
+		line += lineLength + 1;
+	}
+	return count;
+}
+
+static bool _countBytes(void* user, const char* bytes, ptrdiff_t length) {
+	(void)bytes;
+	*(ptrdiff_t*)user += length;
+	return true;
+}
+
+// Condenses the corpus without building it, returns how many bytes were written.
+static ptrdiff_t _reformatAll(Corpus* corpus) {
+	ptrdiff_t written = 0;
+	JsonSink sink = { _countBytes, &written };
+	if (!corpus->isNdjson) {
+		json_reformat(corpus->text.data, corpus->text.length, sink, JSON_WRITE_CONDENSED, NULL);
+		return written;
+	}
+	char* line = corpus->text.data;
+	char* end = corpus->text.data + corpus->text.length;
+	while (line < end) {
+		char* newline = memchr(line, '\n', end - line);
+		ptrdiff_t lineLength = newline ? newline - line : end - line;
+		json_reformat(line, lineLength, sink, JSON_WRITE_CONDENSED, NULL);
+		line += lineLength + 1;
+	}
+	return written;
+}
+
+static void _freeAll(JsonContext* ctx, JsonNode** roots, ptrdiff_t count) {
+	for (ptrdiff_t i = 0; i < count; i++) {
+		json_node_freeCtx(ctx, roots[i]);
+	}
+}
+
+static ptrdiff_t _countNodes(JsonNode** roots, ptrdiff_t count) {
+	ptrdiff_t nodes = 0;
+	for (ptrdiff_t i = 0; i < count; i++) {
+		nodes += json_node_childrenCount(roots[i]) + 1;
+	}
+	return nodes;
+}
+
+static ptrdiff_t _lookupAll(JsonNode* node) {
+	ptrdiff_t found = 0;
+	if (IS_OBJECT(node)) {
+		for (ptrdiff_t i = 0; i < AS_OBJECT(node).count; i++) {
+			JsonNode* child = AS_OBJECT(node).nodes[i];
+			found += json_property(node, child->identifier) == child;
+			found += _lookupAll(child);
+		}
+	} else if (IS_ARRAY(node) && !IS_PACKED(node)) { // Packed numbers have nothing to look up
+		for (ptrdiff_t i = 0; i < AS_ARRAY(node).count; i++) {
+			found += _lookupAll(json_index(node, i));
+		}
+	}
+	return found;
+}
+
+static ptrdiff_t _countLookups(JsonNode* node) {
+	ptrdiff_t lookups = IS_OBJECT(node) ? AS_OBJECT(node).count : 0;
+	if (json_type_isComplex(node->value.type) && !IS_PACKED(node)) {
+		for (ptrdiff_t i = 0; i < AS_COMPLEX(node).count; i++) {
+			lookups += _countLookups(AS_COMPLEX(node).nodes[i]);
+		}
+	}
+	return lookups;
+}
+
+// Writes the tree again through a JsonWriter, the way a handler writing its own data would
+static void _writeNode(JsonWriter* writer, JsonNode* node) {
+	JsonNode scratch;
+	switch (node->value.type) {
+		case JSON_OBJECT:
+		case JSON_ARRAY: {
+			bool isObject = IS_OBJECT(node);
+			if (isObject) {
+				json_writer_beginObject(writer);
+			} else {
+				json_writer_beginArray(writer);
+			}
+			for (ptrdiff_t i = 0; i < AS_COMPLEX(node).count; i++) {
+				JsonNode* child = json_node_childAt(node, i, &scratch);
+				if (isObject) {
+					json_writer_keyN(writer, child->identifier, child->identifierLength);
+				}
+				_writeNode(writer, child);
+			}
+			if (isObject) {
+				json_writer_endObject(writer);
+			} else {
+				json_writer_endArray(writer);
+			}
+			break;
+		}
+		case JSON_INT:
+			json_writer_int64(writer, AS_INT(node));
+			break;
+		case JSON_REAL:
+			json_writer_real(writer, AS_REAL(node));
+			break;
+		case JSON_STRING:
+			json_writer_stringN(writer, AS_STRING(node), AS_STRING_LEN(node));
+			break;
+		case JSON_BOOL:
+			json_writer_bool(writer, AS_BOOL(node));
+			break;
+		default:
+			json_writer_null(writer);
+			break;
+	}
+}
+
+
+static volatile ptrdiff_t lookupSink; // keeps the lookups from being optimized away
+
+static Result _benchCorpus(Corpus* corpus, char* operation, AllocStats* stats, JsonContext* ctx) {
+	ptrdiff_t maxRoots = corpus->isNdjson ? 1 << 20 : 1;
+	JsonNode** roots = malloc(sizeof(JsonNode*) * maxRoots);
+	Result result = { corpus->name, operation, 0, 0, 0, 0.0, 0, 0 };
+	json_context_setPackArrays(ctx, strcmp(operation, "parse_packed") == 0); // The other operations work on nodes
+	ptrdiff_t rootCount = _parseAll(ctx, corpus, roots, maxRoots, false);
+	result.nodes = _countNodes(roots, rootCount);
+	result.bytes = corpus->text.length;
+
+	JsonWriter* writer = strcmp(operation, "write_stream") == 0 ? json_writer_createCtx(ctx, JSON_WRITE_CONDENSED) : NULL;
+	double elapsed = 0.0;
+	AllocStats before = *stats;
+	while (elapsed < MIN_BENCH_SECONDS && result.iterations < MAX_BENCH_ITERATIONS) {
+		double start;
+		if (strcmp(operation, "parse") == 0 || strcmp(operation, "parse_lazy") == 0 || strcmp(operation, "parse_packed") == 0) {
+			_freeAll(ctx, roots, rootCount);
+			start = _now();
+			_parseAll(ctx, corpus, roots, maxRoots, strcmp(operation, "parse_lazy") == 0);
+			elapsed += _now() - start;
+		} else if (strcmp(operation, "lookup") == 0) {
+			ptrdiff_t found = 0;
+			start = _now();
+			for (ptrdiff_t i = 0; i < rootCount; i++) {
+				found += _lookupAll(roots[i]);
+			}
+			elapsed += _now() - start;
+			lookupSink += found;
+		} else if (strcmp(operation, "reformat") == 0) {
+			start = _now();
+			lookupSink += _reformatAll(corpus);
+			elapsed += _now() - start;
+		} else if (strcmp(operation, "free") == 0) {
+			start = _now();
+			_freeAll(ctx, roots, rootCount);
+			elapsed += _now() - start;
+			_parseAll(ctx, corpus, roots, maxRoots, false);
+		} else if (writer) { // One writer for every document, as a server would keep one per thread
+			result.bytes = 0;
+			start = _now();
+			for (ptrdiff_t i = 0; i < rootCount; i++) {
+				_writeNode(writer, roots[i]);
+				ptrdiff_t length = 0;
+				if (json_writer_finish(writer)) {
+					json_writer_text(writer, &length);
+				}
+				result.bytes += length;
+				json_writer_reset(writer);
+			}
+			elapsed += _now() - start;
+		} else {
+			enum JsonWriteOption option = strcmp(operation, "write_pretty") == 0 ? JSON_WRITE_PRETTY : JSON_WRITE_CONDENSED;
+			if (strcmp(operation, "write_parallel") == 0) {
+				option = JSON_WRITE_CONDENSED | JSON_WRITE_PARALLEL;
+			}
+			result.bytes = 0;
+			start = _now();
+			for (ptrdiff_t i = 0; i < rootCount; i++) {
+				char* text = json_toStringCtx(ctx, roots[i], option);
+				result.bytes += strlen(text);
+				json_context_free(ctx, text, strlen(text) + 1);
+			}
+			elapsed += _now() - start;
+		}
+		result.iterations++;
+	}
+	if (strcmp(operation, "lookup") == 0) {
+		result.bytes = 0;
+		result.nodes = 0;
+		for (ptrdiff_t i = 0; i < rootCount; i++) {
+			result.nodes += _countLookups(roots[i]);
+		}
+	}
+	if (strcmp(operation, "free") != 0) {
+		result.allocations = (stats->allocations - before.allocations) / result.iterations;
+		result.allocatedBytes = (stats->bytes - before.bytes) / result.iterations;
+	}
+	result.seconds = elapsed;
+	json_writer_destroy(writer);
+	_freeAll(ctx, roots, rootCount);
+	free(roots);
+	return result;
+}
+
+static void _printResult(const Result* result) {
+	double perIteration = result->seconds / result->iterations;
+	printf(
+		"%-8s %-16s %10.2f MB/s %10.2f ns/node %12td allocs %14td bytes\n",
+		result->corpus,
+		result->operation,
+		result->bytes ? (double)result->bytes / perIteration / 1e6 : 0.0,
+		result->nodes ? perIteration * 1e9 / (double)result->nodes : 0.0,
+		result->allocations,
+		result->allocatedBytes
+	);
+}
+
+static void _writeResults(FILE* stream, const Result* results, ptrdiff_t count) {
+	fprintf(stream, "[\n");
+	for (ptrdiff_t i = 0; i < count; i++) {
+		const Result* result = &results[i];
+		double perIteration = result->seconds / result->iterations;
+		fprintf(
+			stream,
+			"\t{\"corpus\": \"%s\", \"operation\": \"%s\", \"bytes\": %td, \"nodes\": %td, \"iterations\": %td, "
+			"\"mb_per_s\": %.3f, \"ns_per_node\": %.3f, \"allocations\": %td, \"allocated_bytes\": %td}%s\n",
+			result->corpus,
+			result->operation,
+			result->bytes,
+			result->nodes,
+			result->iterations,
+			result->bytes ? (double)result->bytes / perIteration / 1e6 : 0.0,
+			result->nodes ? perIteration * 1e9 / (double)result->nodes : 0.0,
+			result->allocations,
+			result->allocatedBytes,
+			i + 1 < count ? "," : ""
+		);
+	}
+	fprintf(stream, "]\n");
+}
+
+
+int main(int argc, char* argv[]) {
+	char* outputPath = argc > 1 ? argv[1] : "bench_results.json";
+	AllocStats stats = { 0, 0 };
+	JsonContext* ctx = json_context_create();
+	json_context_setAllocator(ctx, _countingAlloc, _countingFree, _countingRealloc, &stats);
+
+	Corpus corpora[] = {
+		_numbersCorpus(),
+		_stringsCorpus(),
+		_nestedCorpus(),
+		_wideCorpus(),
+		_ndjsonCorpus()
+	};
+	char* operations[] = { "parse", "parse_lazy", "parse_packed", "lookup", "write_condensed", "write_stream", "write_pretty", "write_parallel", "reformat", "free" };
+	ptrdiff_t corpusCount = sizeof(corpora) / sizeof(corpora[0]);
+	ptrdiff_t operationCount = sizeof(operations) / sizeof(operations[0]);
+	Result* results = malloc(sizeof(Result) * corpusCount * operationCount);
+	ptrdiff_t resultCount = 0;
+
+	for (ptrdiff_t i = 0; i < corpusCount; i++) {
+		for (ptrdiff_t j = 0; j < operationCount; j++) {
+			results[resultCount] = _benchCorpus(&corpora[i], operations[j], &stats, ctx);
+			_printResult(&results[resultCount]);
+			resultCount++;
+		}
+		free(corpora[i].text.data);
+	}
+
+	FILE* output = fopen(outputPath, "w");
+	if (!output) {
+		fprintf(stderr, "couldn't open %s\n", outputPath);
+		return 1;
+	}
+	_writeResults(output, results, resultCount);
+	fclose(output);
+	printf("results written to %s\n", outputPath);
+
+	free(results);
+	json_context_destroy(ctx);
+	return 0;
+}
@@ -3,11 +3,24 @@
 	All .c files are included here, so that way you only have to compile this file.
 */
 
+// Before any header, for clock_gettime in json_stats.c (the library is otherwise C99)
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
 #include "json.h"
 
 #include "json_types.c"
 #include "json_utils.c"
 #include "json_allocator.c"
+#include "json_context.c"
+#include "json_pool.c"
+#include "json_stats.c"
+#include "json_thread.c"
 #include "json_parser.c"
 #include "json_serializer.c"
 #include "json_error.c"
+#include "json_shared.c"
+#include "json_reclaimer.c"
+#include "json_patch.c"
+#include "json_writer.c"
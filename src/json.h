@@ -5,8 +5,16 @@
 #include "json_utils.h"
 #include "json_config.h"
 #include "json_allocator.h"
+#include "json_context.h"
+#include "json_pool.h"
+#include "json_stats.h"
 #include "json_parser.h"
 #include "json_serializer.h"
 #include "json_error.h"
+#include "json_thread.h"
+#include "json_shared.h"
+#include "json_reclaimer.h"
+#include "json_patch.h"
+#include "json_writer.h"
 
 #endif // JSON4C_GUARD
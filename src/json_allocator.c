@@ -2,16 +2,7 @@
 #include <string.h>
 
 #include "json_allocator.h"
-
-static void* _std_alloc(ptrdiff_t, void*);
-static void _std_free(void*, ptrdiff_t, void*);
-static void* _std_realloc(void*, ptrdiff_t, ptrdiff_t, void*);
-
-static void* _backupRealloc(void*, ptrdiff_t, ptrdiff_t, void*);
-static void _dummyFree(void*, ptrdiff_t, void*);
-
-
-struct Allocator json_allocator = (struct Allocator){_std_alloc, _std_free, _std_realloc, NULL};
+#include "json_context.h"
 
 
 void json_allocator_set(
@@ -20,46 +11,27 @@ void json_allocator_set(
 	void* (*custom_realloc)(void*, ptrdiff_t, ptrdiff_t, void*),
 	void* context
 ) {
-	json_allocator = (struct Allocator){custom_alloc, custom_free, custom_realloc, context};
-	if (!json_allocator.realloc) {
-		json_allocator.realloc = _backupRealloc;
-	}
-	if (!json_allocator.free) {
-		json_allocator.free = _dummyFree;
-	}
+	json_context_setAllocator(json_context_default(), custom_alloc, custom_free, custom_realloc, context);
 }
 
 void json_allocator_reset(void) {
-	json_allocator = (struct Allocator){_std_alloc, _std_free, _std_realloc, NULL};
+	json_context_resetAllocator(json_context_default());
 }
 
 
-static void* _std_alloc(ptrdiff_t size, void* context) {
+void* json_std_alloc(ptrdiff_t size, void* context) {
 	(void)context;
 	return malloc((size_t)size);
 }
 
-static void _std_free(void* ptr, ptrdiff_t size, void* context) {
+void json_std_free(void* ptr, ptrdiff_t size, void* context) {
 	(void)size;
 	(void)context;
 	free(ptr);
 }
 
-static void* _std_realloc(void* ptr, ptrdiff_t newSize, ptrdiff_t oldSize, void* context) {
+void* json_std_realloc(void* ptr, ptrdiff_t newSize, ptrdiff_t oldSize, void* context) {
 	(void)oldSize;
 	(void)context;
 	return realloc(ptr, (size_t)newSize);
 }
-
-static void* _backupRealloc(void* ptr, ptrdiff_t newSize, ptrdiff_t oldSize, void* context) {
-	void* newptr = json_allocator.alloc(newSize, context);
-	memcpy(newptr, ptr, oldSize);
-	json_allocator.free(ptr, oldSize, context);
-	return newptr;
-}
-
-static void _dummyFree(void* ptr, ptrdiff_t size, void* context) {
-	(void)ptr;
-	(void)size;
-	(void)context;
-}
@@ -12,18 +12,13 @@ struct Allocator {
 	void* context;
 };
 
-// NOTE: The libraries' allocator is a global variable.
-extern struct Allocator json_allocator;
-
 // stdlib wrappers
 void* json_std_alloc(ptrdiff_t, void*);
 void json_std_free(void*, ptrdiff_t, void*);
 void* json_std_realloc(void*, ptrdiff_t, ptrdiff_t, void*);
 
-// Is used if json_realloc is set to NULL.
-void* json_allocator_backupRealloc(void*, ptrdiff_t, ptrdiff_t, void*);
-
-// NOTE: Only set/reset the allocator before nodes have been allocated or after they have all been freed.
+// NOTE: These set/reset the allocator of the default context, see json_context_setAllocator.
+// Only set/reset the allocator before nodes have been allocated or after they have all been freed.
 void json_allocator_set(
 	void* (*custom_alloc)(ptrdiff_t, void*), 
 	void (*custom_free)(void*, ptrdiff_t, void*),
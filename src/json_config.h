@@ -11,8 +11,14 @@
 #ifndef JSON_BUFFER_CAPACITY
 #define JSON_BUFFER_CAPACITY 256
 #endif
+#ifndef JSON_INLINE_CHILDREN
+#define JSON_INLINE_CHILDREN 3
+#endif
+#ifndef JSON_INLINE_STRING_SIZE
+#define JSON_INLINE_STRING_SIZE 11 // Makes a JsonNode 64 bytes on 64-bit targets
+#endif
 #ifndef JSON_DYNAMIC_ARRAY_CAPACITY
-#define JSON_DYNAMIC_ARRAY_CAPACITY 16
+#define JSON_DYNAMIC_ARRAY_CAPACITY 8
 #endif
 #ifndef JSON_DYNAMIC_ARRAY_GROW_BY
 #define JSON_DYNAMIC_ARRAY_GROW_BY 2
@@ -20,5 +26,51 @@
 #ifndef JSON_MAX_ERRORS_RECORDED
 #define JSON_MAX_ERRORS_RECORDED 64
 #endif
+#ifndef JSON_PARSER_STACK_CAPACITY
+#define JSON_PARSER_STACK_CAPACITY 64
+#endif
+#ifndef JSON_PACK_MIN_COUNT
+#define JSON_PACK_MIN_COUNT 2 // Shorter arrays of numbers are parsed into nodes, -D JSON_NO_PACKED_ARRAYS never packs
+#endif
+#ifndef JSON_OUTPUT_CACHE_MIN_SIZE
+#define JSON_OUTPUT_CACHE_MIN_SIZE 128 // Containers written shorter than this aren't worth caching
+#endif
+#ifndef JSON_DECODE_CHUNK_SIZE
+#define JSON_DECODE_CHUNK_SIZE 256 // Undecoded strings are read this much at a time by the library, see json_node_readString
+#endif
+#ifndef JSON_SINK_BUFFER_SIZE
+#define JSON_SINK_BUFFER_SIZE 8192 // Output is collected into blocks of this size before going to a JsonSink
+#endif
+#ifndef JSON_WRITE_THREADS
+#define JSON_WRITE_THREADS 0 // Threads writing with JSON_WRITE_PARALLEL, 0 for one per processor
+#endif
+#ifndef JSON_PARALLEL_MIN_CHILDREN
+#define JSON_PARALLEL_MIN_CHILDREN 1024 // Containers with fewer children aren't split by JSON_WRITE_PARALLEL
+#endif
+#ifndef JSON_VALIDATE_INLINE_DEPTH
+#define JSON_VALIDATE_INLINE_DEPTH 4096 // json_validate keeps a bit per level, on the stack up to this depth
+#endif
+#ifndef JSON_WRITER_MAX_DEPTH
+#define JSON_WRITER_MAX_DEPTH 128 // A JsonWriter keeps a byte for each level it can nest containers
+#endif
+#ifndef JSON_FILE_BLOCK_SIZE
+#define JSON_FILE_BLOCK_SIZE 1048576 // json_parseFileStreamed reads the file in blocks of this size
+#endif
+#ifndef JSON_FILE_RING_BLOCKS
+#define JSON_FILE_RING_BLOCKS 4 // and reads at most this many blocks ahead of the parser
+#endif
+#ifndef JSON_POOL_SLAB_SIZE
+#define JSON_POOL_SLAB_SIZE 65536
+#endif
+#ifndef JSON_POOL_MAX_SIZE
+#define JSON_POOL_MAX_SIZE 4096
+#endif
+// SSE2 is used where the compiler targets it (every x86-64 build does), -D JSON_NO_SIMD forces the plain C paths
+#if defined(__SSE2__) && defined(__GNUC__) && !defined(JSON_NO_SIMD)
+#define JSON_SIMD_SSE2
+#endif
+#ifndef JSON_THREAD_LOCAL
+#define JSON_THREAD_LOCAL // e.g. -D JSON_THREAD_LOCAL=_Thread_local
+#endif
 
 #endif // JSON4C_CONFIG
@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_context.h"
+
+#ifdef JSON_STATS
+static void _countBytes(JsonContext*, ptrdiff_t);
+#endif
+
+
+JSON_THREAD_LOCAL JsonContext json_defaultContext = {
+	.allocator = {json_std_alloc, json_std_free, json_std_realloc, NULL},
+	.errorStack = { .count = 0 },
+	.onErrorReported = NULL,
+	.onCriticalErrorReported = NULL,
+	.onMaxErrors = NULL
+};
+
+
+JsonContext* json_context_default(void) {
+	return &json_defaultContext;
+}
+
+void json_context_init(JsonContext* ctx) {
+	memset(ctx, 0, sizeof(JsonContext));
+	json_context_resetAllocator(ctx);
+}
+
+JsonContext* json_context_create(void) {
+	JsonContext* ctx = malloc(sizeof(JsonContext));
+	if (!ctx) return NULL;
+	json_context_init(ctx);
+	return ctx;
+}
+
+void json_context_destroy(JsonContext* ctx) {
+	if (!ctx || ctx == &json_defaultContext) return;
+	free(ctx);
+}
+
+void json_context_setAllocator(
+	JsonContext* ctx,
+	void* (*custom_alloc)(ptrdiff_t, void*),
+	void (*custom_free)(void*, ptrdiff_t, void*),
+	void* (*custom_realloc)(void*, ptrdiff_t, ptrdiff_t, void*),
+	void* instance
+) {
+	// NOTE: a NULL free or realloc is handled by json_context_free and json_context_realloc
+	ctx->allocator = (struct Allocator){custom_alloc, custom_free, custom_realloc, instance};
+}
+
+void json_context_resetAllocator(JsonContext* ctx) {
+	ctx->allocator = (struct Allocator){json_std_alloc, json_std_free, json_std_realloc, NULL};
+}
+
+void json_context_setLimits(JsonContext* ctx, JsonLimits limits) {
+	ctx->limits = limits;
+}
+
+void json_context_setPackArrays(JsonContext* ctx, bool packArrays) {
+	ctx->packArrays = packArrays;
+}
+
+
+void* json_context_alloc(JsonContext* ctx, ptrdiff_t size) {
+	void* ptr = ctx->allocator.alloc(size, ctx->allocator.context);
+#ifdef JSON_STATS
+	if (ptr) {
+		_countBytes(ctx, size);
+		ctx->stats.allocations++;
+	}
+#endif
+	return ptr;
+}
+
+void json_context_free(JsonContext* ctx, void* ptr, ptrdiff_t size) {
+	if (!ptr) return;
+	JSON_STATS_ADD(ctx, frees, 1);
+	JSON_STATS_ADD(ctx, bytesInUse, -size);
+	if (!ctx->allocator.free) return;
+	ctx->allocator.free(ptr, size, ctx->allocator.context);
+}
+
+void* json_context_realloc(JsonContext* ctx, void* ptr, ptrdiff_t newSize, ptrdiff_t oldSize) {
+	if (ctx->allocator.realloc) {
+		void* newptr = ctx->allocator.realloc(ptr, newSize, oldSize, ctx->allocator.context);
+#ifdef JSON_STATS
+		if (newptr) {
+			_countBytes(ctx, newSize - oldSize);
+			ctx->stats.reallocations++;
+		}
+#endif
+		return newptr;
+	}
+	void* newptr = json_context_alloc(ctx, newSize);
+	if (!newptr) return NULL;
+	if (ptr) {
+		memcpy(newptr, ptr, oldSize < newSize ? oldSize : newSize);
+		json_context_free(ctx, ptr, oldSize);
+	}
+	return newptr;
+}
+
+
+#ifdef JSON_STATS
+static void _countBytes(JsonContext* ctx, ptrdiff_t size) {
+	if (size > 0) {
+		ctx->stats.bytesAllocated += size;
+	}
+	ctx->stats.bytesInUse += size;
+	if (ctx->stats.bytesInUse > ctx->stats.peakBytesInUse) {
+		ctx->stats.peakBytesInUse = ctx->stats.bytesInUse;
+	}
+}
+#endif
@@ -0,0 +1,78 @@
+/*
+	A JsonContext holds the state the library would otherwise keep in globals,
+	that being the allocator, the error stack, the error callbacks and the parsing options.
+	Every function that allocates or reports errors has a '...Ctx' variant that
+	takes a context, the plain functions just forward to the default context.
+
+	NOTE: A context isn't synchronized, give each thread its own context
+	(or define JSON_THREAD_LOCAL to make the default context thread-local).
+*/
+
+#ifndef JSON4C_CONTEXT
+#define JSON4C_CONTEXT
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "json_config.h"
+#include "json_allocator.h"
+#include "json_stats.h"
+
+/*
+	Budgets for parsing untrusted input, 0 leaves that one unlimited (all of them are by default). Every parser
+	checks the limits of the context it allocates through, and fails with the matching JSON_ERROR_LIMIT_ code
+	as soon as a document goes over one, before parsing or allocating any more of it.
+*/
+typedef struct JsonLimits {
+	ptrdiff_t maxSize;			// Bytes of input, a file's size is checked before it's read
+	ptrdiff_t maxDepth;			// Containers nested in one another, a root container is at depth 1
+	ptrdiff_t maxNodes;			// Values in the document, counting each element of a packed array
+	ptrdiff_t maxStringLength;	// Bytes of a string or key, once decoded
+	ptrdiff_t maxAllocated;		// Bytes allocated for the tree, not counting strings short enough to go in their node
+} JsonLimits;
+
+typedef struct JsonContext {
+	struct Allocator allocator;
+	struct {
+		char* errors[JSON_MAX_ERRORS_RECORDED];
+		ptrdiff_t count;
+	} errorStack;
+	void (*onErrorReported)(char* errorMsg);
+	void (*onCriticalErrorReported)(char* errorMsg);
+	void (*onMaxErrors)(void);
+	JsonLimits limits;
+	bool packArrays; // Parsers pack arrays of numbers, off by default (see json_array_asInt64s)
+#ifdef JSON_STATS
+	JsonStats stats;
+#endif
+} JsonContext;
+
+extern JSON_THREAD_LOCAL JsonContext json_defaultContext;
+
+// The allocator of the default context, kept for compatibility.
+#define json_allocator (json_defaultContext.allocator)
+
+JsonContext* json_context_default(void);
+void json_context_init(JsonContext*);
+// NOTE: json_context_create allocates the context itself with malloc, not the context's allocator.
+JsonContext* json_context_create(void);
+void json_context_destroy(JsonContext*);
+
+// NOTE: Only set/reset the allocator before nodes have been allocated or after they have all been freed.
+void json_context_setAllocator(
+	JsonContext*,
+	void* (*custom_alloc)(ptrdiff_t, void*),
+	void (*custom_free)(void*, ptrdiff_t, void*),
+	void* (*custom_realloc)(void*, ptrdiff_t, ptrdiff_t, void*),
+	void* instance
+);
+void json_context_resetAllocator(JsonContext*);
+void json_context_setLimits(JsonContext*, JsonLimits); // e.g. (JsonLimits){ .maxSize = 1 << 20, .maxDepth = 64 }
+void json_context_setPackArrays(JsonContext*, bool);
+
+// All allocations made by the library go through these.
+void* json_context_alloc(JsonContext*, ptrdiff_t size);
+void json_context_free(JsonContext*, void* ptr, ptrdiff_t size);
+void* json_context_realloc(JsonContext*, void* ptr, ptrdiff_t newSize, ptrdiff_t oldSize);
+
+#endif // JSON4C_CONTEXT
@@ -1,71 +1,158 @@
 #include <stddef.h>
 
 #include "json_config.h"
+#include "json_context.h"
 #include "json_error.h"
 
-struct {
-	char* errors[JSON_MAX_ERRORS_RECORDED];
-	ptrdiff_t count;
-} errorStack = { .count = 0 };
 
-void (*json_error_onErrorReported)(char* errorMsg) = NULL;
-void (*json_error_onCriticalErrorReported)(char* errorMsg) = NULL;
-void (*json_error_onMaxErrors)(void) = NULL;
+static void _reportError(JsonContext*, char*);
 
 
-void _reportError(char*);
+#define ERROR_NODE(msg) { .identifier = msg, .value = { JSON_ERROR, .string = NULL } }
+static JsonNode _errorNodes[JSON_ERROR_CODE_COUNT] = {
+	[JSON_ERROR_NONE]						= ERROR_NODE("JSON_ERROR: no error"),
+	[JSON_ERROR_UNEXPECTED_END]				= ERROR_NODE("JSON_ERROR: unexpected end of input"),
+	[JSON_ERROR_UNEXPECTED_CHARACTER]		= ERROR_NODE("JSON_ERROR: unexpected character"),
+	[JSON_ERROR_INVALID_LITERAL]			= ERROR_NODE("JSON_ERROR: invalid literal"),
+	[JSON_ERROR_INVALID_NUMBER]				= ERROR_NODE("JSON_ERROR: invalid number"),
+	[JSON_ERROR_INVALID_ESCAPE]				= ERROR_NODE("JSON_ERROR: invalid escape sequence"),
+	[JSON_ERROR_CONTROL_CHARACTER]			= ERROR_NODE("JSON_ERROR: unescaped control character in string"),
+	[JSON_ERROR_INVALID_UTF8]				= ERROR_NODE("JSON_ERROR: invalid UTF-8 in string"),
+	[JSON_ERROR_EXPECTED_KEY]				= ERROR_NODE("JSON_ERROR: expected a string key"),
+	[JSON_ERROR_EXPECTED_COLON]				= ERROR_NODE("JSON_ERROR: expected ( : )"),
+	[JSON_ERROR_EXPECTED_COMMA_OR_BRACE]	= ERROR_NODE("JSON_ERROR: expected ( , ) or ( } )"),
+	[JSON_ERROR_EXPECTED_COMMA_OR_BRACKET]	= ERROR_NODE("JSON_ERROR: expected ( , ) or ( ] )"),
+	[JSON_ERROR_TRAILING_CHARACTERS]		= ERROR_NODE("JSON_ERROR: unexpected character(s) after the root value"),
+	[JSON_ERROR_OUT_OF_MEMORY]				= ERROR_NODE("JSON_ERROR: out of memory"),
+	[JSON_ERROR_FILE]						= ERROR_NODE("JSON_ERROR: the file couldn't be read"),
+	[JSON_ERROR_OUTPUT]						= ERROR_NODE("JSON_ERROR: the output couldn't be written"),
+	[JSON_ERROR_LIMIT_SIZE]					= ERROR_NODE("JSON_ERROR: the document is larger than the limit"),
+	[JSON_ERROR_LIMIT_DEPTH]				= ERROR_NODE("JSON_ERROR: containers are nested deeper than the limit"),
+	[JSON_ERROR_LIMIT_NODES]				= ERROR_NODE("JSON_ERROR: the document has more values than the limit"),
+	[JSON_ERROR_LIMIT_STRING]				= ERROR_NODE("JSON_ERROR: a string is longer than the limit"),
+	[JSON_ERROR_LIMIT_ALLOCATED]			= ERROR_NODE("JSON_ERROR: the document needs more memory than the limit"),
+	[JSON_ERROR_INVALID_WRITE]				= ERROR_NODE("JSON_ERROR: the write doesn't fit where the writer is in the document")
+};
+#undef ERROR_NODE
 
 
 void json_error_report(char* errorMsg) {
-	if (json_error_onErrorReported) {
-		json_error_onErrorReported(errorMsg);
-	}
-	_reportError(errorMsg);
+	json_error_reportCtx(json_context_default(), errorMsg);
 }
 
 void json_error_reportCritical(char* errorMsg) {
-	if (json_error_onCriticalErrorReported) {
-		json_error_onCriticalErrorReported(errorMsg);
-	}
-	_reportError(errorMsg);
+	json_error_reportCriticalCtx(json_context_default(), errorMsg);
 }
 
 void json_error_reset(void) {
-	ptrdiff_t i;
-	for (i = 0; i < errorStack.count; i++) {
-		errorStack.errors[i] = NULL;
-	}
-	errorStack.count = 0;
+	json_error_resetCtx(json_context_default());
 }
 
 ptrdiff_t json_error_count(void) {
-	return errorStack.count;
+	return json_error_countCtx(json_context_default());
 }
 
 char* json_error_pop(void) {
-	if (errorStack.count - 1 < 0) return NULL;
-	return errorStack.errors[--errorStack.count];
+	return json_error_popCtx(json_context_default());
 }
 
 char** json_error_all(ptrdiff_t* count) {
-	*count = errorStack.count;
-	return errorStack.errors;
+	return json_error_allCtx(json_context_default(), count);
 }
 
 void json_error_printAll(FILE* stream) {
+	json_error_printAllCtx(json_context_default(), stream);
+}
+
+
+void json_error_reportCtx(JsonContext* ctx, char* errorMsg) {
+	if (ctx->onErrorReported) {
+		ctx->onErrorReported(errorMsg);
+	}
+	_reportError(ctx, errorMsg);
+}
+
+void json_error_reportCriticalCtx(JsonContext* ctx, char* errorMsg) {
+	if (ctx->onCriticalErrorReported) {
+		ctx->onCriticalErrorReported(errorMsg);
+	}
+	_reportError(ctx, errorMsg);
+}
+
+void json_error_resetCtx(JsonContext* ctx) {
 	ptrdiff_t i;
-	for (i = 0; i < errorStack.count; i++) {
-		fputs(errorStack.errors[i], stream);
+	for (i = 0; i < ctx->errorStack.count; i++) {
+		ctx->errorStack.errors[i] = NULL;
+	}
+	ctx->errorStack.count = 0;
+}
+
+ptrdiff_t json_error_countCtx(JsonContext* ctx) {
+	return ctx->errorStack.count;
+}
+
+char* json_error_popCtx(JsonContext* ctx) {
+	if (ctx->errorStack.count - 1 < 0) return NULL;
+	return ctx->errorStack.errors[--ctx->errorStack.count];
+}
+
+char** json_error_allCtx(JsonContext* ctx, ptrdiff_t* count) {
+	*count = ctx->errorStack.count;
+	return ctx->errorStack.errors;
+}
+
+void json_error_printAllCtx(JsonContext* ctx, FILE* stream) {
+	ptrdiff_t i;
+	for (i = 0; i < ctx->errorStack.count; i++) {
+		fputs(ctx->errorStack.errors[i], stream);
+	}
+}
+
+
+char* json_error_message(JsonErrorCode code) {
+	if (code < 0 || code >= JSON_ERROR_CODE_COUNT) return NULL;
+	return _errorNodes[code].identifier;
+}
+
+JsonNode* json_error_node(JsonErrorCode code) {
+	if (code < 0 || code >= JSON_ERROR_CODE_COUNT) return NULL;
+	return &_errorNodes[code];
+}
+
+void json_error_locate(JsonError* error, const char* buffer) {
+	if (!error || !buffer) return;
+	ptrdiff_t line = 1;
+	ptrdiff_t column = 1;
+	for (ptrdiff_t i = 0; i < error->offset; i++) {
+		if (buffer[i] == '\n') {
+			line++;
+			column = 1;
+		} else {
+			column++;
+		}
+	}
+	error->line = line;
+	error->column = column;
+}
+
+ptrdiff_t json_error_format(const JsonError* error, char* buffer, ptrdiff_t length) {
+	if (!error) return 0;
+	if (error->line > 0) {
+		return snprintf(
+			buffer, (size_t)length, "%s, at line %td column %td (byte %td)",
+			json_error_message(error->code), error->line, error->column, error->offset
+		);
 	}
+	return snprintf(buffer, (size_t)length, "%s, at byte %td", json_error_message(error->code), error->offset);
 }
 
 
-void _reportError(char* errorMsg) {
-	if (errorStack.count >= JSON_MAX_ERRORS_RECORDED) {
-		if (json_error_onMaxErrors) {
-			json_error_onMaxErrors();
+static void _reportError(JsonContext* ctx, char* errorMsg) {
+	if (ctx->errorStack.count >= JSON_MAX_ERRORS_RECORDED) {
+		if (ctx->onMaxErrors) {
+			ctx->onMaxErrors();
 		}
-		json_error_reset();
+		json_error_resetCtx(ctx);
 	}
-	errorStack.errors[errorStack.count++] = errorMsg;
+	ctx->errorStack.errors[ctx->errorStack.count++] = errorMsg;
 }
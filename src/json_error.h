@@ -4,10 +4,50 @@
 #include <stdio.h>
 
 #include "json_types.h"
+#include "json_context.h"
 
-extern void (*json_error_onErrorReported)(char* errorMsg);
-extern void (*json_error_onCriticalErrorReported)(char* errorMsg);
-extern void (*json_error_onMaxErrors)(void);
+typedef enum {
+	JSON_ERROR_NONE,
+	JSON_ERROR_UNEXPECTED_END,
+	JSON_ERROR_UNEXPECTED_CHARACTER,
+	JSON_ERROR_INVALID_LITERAL,
+	JSON_ERROR_INVALID_NUMBER,
+	JSON_ERROR_INVALID_ESCAPE,
+	JSON_ERROR_CONTROL_CHARACTER,
+	JSON_ERROR_INVALID_UTF8,
+	JSON_ERROR_EXPECTED_KEY,
+	JSON_ERROR_EXPECTED_COLON,
+	JSON_ERROR_EXPECTED_COMMA_OR_BRACE,
+	JSON_ERROR_EXPECTED_COMMA_OR_BRACKET,
+	JSON_ERROR_TRAILING_CHARACTERS,
+	JSON_ERROR_OUT_OF_MEMORY,
+	JSON_ERROR_FILE,
+	JSON_ERROR_OUTPUT,
+	// The document went over one of the context's JsonLimits
+	JSON_ERROR_LIMIT_SIZE,
+	JSON_ERROR_LIMIT_DEPTH,
+	JSON_ERROR_LIMIT_NODES,
+	JSON_ERROR_LIMIT_STRING,
+	JSON_ERROR_LIMIT_ALLOCATED,
+	JSON_ERROR_INVALID_WRITE, // A JsonWriter call out of place in the document
+	JSON_ERROR_CODE_COUNT
+} JsonErrorCode;
+
+/*
+	A JsonError describes why and where parsing failed. Filling one in never allocates,
+	'line' and 'column' stay 0 until json_error_locate is called with the parsed buffer.
+*/
+typedef struct JsonError {
+	JsonErrorCode code;
+	ptrdiff_t offset;
+	ptrdiff_t line;
+	ptrdiff_t column;
+} JsonError;
+
+// The callbacks of the default context, kept for compatibility.
+#define json_error_onErrorReported (json_defaultContext.onErrorReported)
+#define json_error_onCriticalErrorReported (json_defaultContext.onCriticalErrorReported)
+#define json_error_onMaxErrors (json_defaultContext.onMaxErrors)
 
 void json_error_report(char*);
 void json_error_reportCritical(char*);
@@ -17,4 +57,18 @@ char* json_error_pop(void); // pop the most recent error off the error stack
 char** json_error_all(ptrdiff_t*);
 void json_error_printAll(FILE*);
 
+void json_error_reportCtx(JsonContext*, char*);
+void json_error_reportCriticalCtx(JsonContext*, char*);
+void json_error_resetCtx(JsonContext*);
+ptrdiff_t json_error_countCtx(JsonContext*);
+char* json_error_popCtx(JsonContext*);
+char** json_error_allCtx(JsonContext*, ptrdiff_t*);
+void json_error_printAllCtx(JsonContext*, FILE*);
+
+char* json_error_message(JsonErrorCode); // NOTE: returns a static string
+JsonNode* json_error_node(JsonErrorCode); // NOTE: returns a static JSON_ERROR node, freeing it does nothing
+void json_error_locate(JsonError*, const char* buffer);
+// Formats the error into 'buffer' like snprintf, returning the length of the full message.
+ptrdiff_t json_error_format(const JsonError*, char* buffer, ptrdiff_t length);
+
 #endif // JSON4C_ERROR
@@ -1,7 +1,9 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <math.h>
-#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -12,16 +14,108 @@
 #include "json_types.h"
 #include "json_config.h"
 #include "json_utils.h"
+#include "json_thread.h"
 
-// TODO: String parser needs extra work to support escaped characters.
-// TODO: Remove _scanUntil and replace it with a function tailored to string parsing
+#ifdef JSON_SIMD_SSE2
+#include <emmintrin.h>
+#endif
 
+// NOTE: The parser state lives on the stack of json_parseCtx (or json_parser_parse), and failing never allocates.
+// Children are collected on the shared scratch stack and only copied into their container,
+// at its final size, once the closing bracket is reached. The stack starts out in the state
+// itself and only moves to the heap for documents that need a deeper/wider one.
+typedef struct ParserState {
+	JsonContext* ctx;
+	JsonContext* scratchCtx; // allocates the stack, which a JsonParser keeps beyond its documents
+	char* buffer;
+	ptrdiff_t length;
+	ptrdiff_t offset;
+	JsonError error;
+	struct {
+		JsonNode** nodes;
+		ptrdiff_t max;
+		ptrdiff_t count;
+		JsonNode* inlineNodes[JSON_PARSER_STACK_CAPACITY];
+	} stack;
+	// The numbers of the arrays being parsed, for as long as they may still be packed (see _array). Only allocated
+	// once an array of numbers is seen, through scratchCtx like the heap stack.
+	struct {
+		JsonPackedValue* values;
+		ptrdiff_t max;
+		ptrdiff_t count;
+	} numbers;
+	struct Reformatter* out; // Where the validator copies what it skips, only set by json_reformat
+	struct FileSource* source; // Where more of the buffer comes from, only set by json_parseFileStreamed
+	bool lazy; // Reals and strings are left undecoded, in the buffer, set by json_parseLazy
+	const JsonLimits* limits; // The context's, NULL when it sets none, so unlimited parsing checks nothing else
+	// What the document has used of the limits so far, only counted when there are some
+	struct {
+		ptrdiff_t depth;
+		ptrdiff_t nodes;
+		ptrdiff_t bytes;
+	} used;
+} ParserState;
 
-// Parsers
-typedef JsonNode* (*parserFunc)(char*, ptrdiff_t, ptrdiff_t*);
-typedef JsonNode* parser(char*, ptrdiff_t, ptrdiff_t*);
+// Feeds json_parseFileStreamed. A reader thread fills a ring of blocks from the file, and whenever the parser
+// scans to the end of what it has, it drops the bytes it's done with from its window and copies the next block in.
+// NOTE: Offsets stay offsets into the file, state->buffer points windowStart bytes before the window, so
+// state->buffer[offset] is always the file's byte at 'offset' (for offsets inside the window).
+typedef struct FileSource {
+	JsonContext* ctx;
+	FILE* stream;
+	char* blocks; // JSON_FILE_RING_BLOCKS blocks of JSON_FILE_BLOCK_SIZE bytes
+	ptrdiff_t lengths[JSON_FILE_RING_BLOCKS];
+	ptrdiff_t filled; // Blocks read, only the reader changes it
+	ptrdiff_t taken; // Blocks copied into the window, only the parser changes it
+	bool ended; // Everything's been read (or reading failed)
+	bool failed;
+	bool stopping; // The parser is done, so the reader should be too
+#ifndef JSON_NO_THREADS
+	bool threaded; // Without a reader thread the parser reads each block itself, when it needs it
+	JsonThread reader;
+	JsonMutex mutex;
+	JsonCond changed;
+#endif
+	char* window;
+	ptrdiff_t windowStart;
+	ptrdiff_t windowLength;
+	ptrdiff_t windowCapacity;
+	// Keys are decoded as soon as they're scanned, the window may have moved past them by the time their value is
+	// parsed. They're held here (nested objects on top of their parents') until their nodes exist.
+	char* keys;
+	ptrdiff_t keysLength;
+	ptrdiff_t keysMax;
+} FileSource;
+
+// The output of json_reformat, collected in blocks so the sink isn't called for every token
+typedef struct Reformatter {
+	JsonSink sink;
+	bool pretty;
+	ptrdiff_t depth;
+	ptrdiff_t count;
+	char bytes[JSON_SINK_BUFFER_SIZE];
+} Reformatter;
+
+// A scanned (and validated) string literal, which can then be decoded straight into its node
+typedef struct StringSpan {
+	ptrdiff_t start;	// Just past the opening '"'
+	ptrdiff_t end;		// At the closing '"'
+	ptrdiff_t length;	// Decoded length
+} StringSpan;
+
+// The containers open around the validator, one bit per level (set for an object), so nesting costs it a bit instead
+// of a stack frame. The bits start out in the struct and only move to the heap for documents nested deeper.
+typedef struct NestingStack {
+	uint64_t* bits;
+	ptrdiff_t max; // Levels the bits have room for
+	ptrdiff_t depth;
+	uint64_t inlineBits[(JSON_VALIDATE_INLINE_DEPTH + 63) / 64];
+} NestingStack;
+
+// Parsers, a parser that fails records the error in the state and returns NULL
+typedef JsonNode* (*parserFunc)(ParserState*);
+typedef JsonNode* parser(ParserState*);
 static parser _error;
-static parser _skip;
 static parser _object;
 static parser _array;
 static parser _boolean;
@@ -31,254 +125,1343 @@ static parser _null;
 
 // Helpers
 static parserFunc _getParser(char character);
-static char* _scanWhile(bool (*predicate)(char), char*, ptrdiff_t, ptrdiff_t*);
+static void _initState(ParserState*, JsonContext* ctx, JsonContext* scratchCtx, char* buffer, ptrdiff_t length);
+static JsonNode* _parse(ParserState*, JsonError*);
+static JsonNode* _parseBuffer(JsonContext*, char*, ptrdiff_t, JsonError*, bool lazy);
+static bool _skipDocument(ParserState*);
+static bool _skipValue(ParserState*, NestingStack*);
+static bool _skipScalar(ParserState*);
+static bool _skipKey(ParserState*);
+static bool _pushLevel(ParserState*, NestingStack*, bool isObject);
+static bool _outWrite(ParserState*, const char*, ptrdiff_t);
+static bool _outNewline(ParserState*);
+static bool _outFlush(ParserState*);
+static JsonNode* _value(ParserState*);
+static JsonNode* _fail(ParserState*, JsonErrorCode, ptrdiff_t offset);
+static void _skipWhitespace(ParserState*);
+static bool _refill(ParserState*, ptrdiff_t keep);
+static bool _ensure(ParserState*, ptrdiff_t end, ptrdiff_t keep);
+static char _byteAt(ParserState*, ptrdiff_t, ptrdiff_t keep);
+static ptrdiff_t _holdKey(ParserState*, const StringSpan*);
+#ifndef JSON_NO_THREADS
+static void _readFile(void*);
+#endif
+static ptrdiff_t _takeBlock(FileSource*);
+static void _releaseBlock(FileSource*);
+static bool _consume(ParserState*, char);
+static bool _literal(ParserState*, char*, ptrdiff_t);
+static bool _scanNumber(ParserState*, bool*);
+static bool _scanString(ParserState*, StringSpan*);
+static ptrdiff_t _skipPlainChars(const char*, ptrdiff_t, ptrdiff_t);
+static void _decodeString(ParserState*, const StringSpan*, char*);
+static bool _push(ParserState*, JsonNode*);
+static JsonNode* _popContainer(ParserState*, JsonType, ptrdiff_t base, ptrdiff_t start);
+static void _discard(ParserState*, ptrdiff_t base);
+static bool _numberValue(ParserState*, JsonValue*);
+static bool _decodeNumber(ParserState*, ptrdiff_t start, bool isInteger, JsonValue*);
+static bool _pushNumber(ParserState*, JsonValue);
+static bool _unpackNumbers(ParserState*, JsonType, ptrdiff_t numbersBase);
+static JsonNode* _popNumbers(ParserState*, JsonType, ptrdiff_t base, ptrdiff_t numbersBase, ptrdiff_t start);
+static const JsonLimits* _limitsOf(JsonContext*);
+static JsonNode* _overSize(JsonContext*, ptrdiff_t size, JsonError*);
+static bool _countValue(ParserState*, char first);
+static bool _countNode(ParserState*, ptrdiff_t bytes, ptrdiff_t offset);
+static bool _countString(ParserState*, const StringSpan*, bool isDecoded);
+static bool _charge(ParserState*, ptrdiff_t bytes, ptrdiff_t offset);
 
 
 JsonNode* json_parse(char* buffer, ptrdiff_t length) {
-	if (length <= 0) return NULL;
-	ptrdiff_t offset = 0;
-	parserFunc firstParser = _getParser(json_buf_peek(buffer, length, offset));
-	JsonNode* root = firstParser(buffer, length, &offset);
-	if (IS_ERROR(root)) {
-		DEBUG("a parsing error occurred");
-		json_error_report(json_toString(root, JSON_WRITE_PRETTY));
-	}
-	return root;
+	return json_parseCtx(json_context_default(), buffer, length, NULL);
 }
 
 JsonNode* json_parseFile(char* path) {
+	return json_parseFileCtx(json_context_default(), path, NULL);
+}
+
+JsonNode* json_parseCtx(JsonContext* ctx, char* buffer, ptrdiff_t length, JsonError* error) {
+	return _parseBuffer(ctx, buffer, length, error, false);
+}
+
+JsonNode* json_parseLazy(char* buffer, ptrdiff_t length) {
+	return json_parseLazyCtx(json_context_default(), buffer, length, NULL);
+}
+
+JsonNode* json_parseLazyCtx(JsonContext* ctx, char* buffer, ptrdiff_t length, JsonError* error) {
+	return _parseBuffer(ctx, buffer, length, error, true);
+}
+
+JsonNode* json_parseFileCtx(JsonContext* ctx, char* path, JsonError* error) {
 	FILE* jsonStream = fopen(path, "rb");
 	if (!jsonStream) {
-		json_error_report("JSON_ERROR: fopen returned NULL, in json_parseFile");
+		if (error) {
+			*error = (JsonError){ JSON_ERROR_FILE, 0, 0, 0 };
+		}
+		json_error_reportCtx(ctx, "JSON_ERROR: fopen returned NULL, in json_parseFile");
+		return NULL;
+	}
+	// ftell fails with -1, and gives LONG_MAX for a directory, neither leaves room for the terminator
+	long length = fseek(jsonStream, 0, SEEK_END) == 0 ? ftell(jsonStream) : -1;
+	if (length < 0 || length == LONG_MAX) {
+		fclose(jsonStream);
+		if (error) {
+			*error = (JsonError){ JSON_ERROR_FILE, 0, 0, 0 };
+		}
+		json_error_reportCtx(ctx, "JSON_ERROR: ftell failed, in json_parseFile");
 		return NULL;
 	}
-	fseek(jsonStream, 0, SEEK_END);
-	long length = ftell(jsonStream);
 	rewind(jsonStream);
-	
-	char* buffer = json_allocator.alloc(length + 1, json_allocator.context);
+	JsonNode* overSize = _overSize(ctx, length, error);
+	if (overSize) { // Not worth reading
+		fclose(jsonStream);
+		return overSize;
+	}
+
+	char* buffer = json_context_alloc(ctx, length + 1);
 	if (!buffer) {
 		fclose(jsonStream);
+		if (error) {
+			*error = (JsonError){ JSON_ERROR_OUT_OF_MEMORY, 0, 0, 0 };
+		}
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_parseFile failed, alloc returned NULL");
 		return NULL;
 	}
 	size_t bytesRead = fread(buffer, 1, length, jsonStream);
 	fclose(jsonStream);
 	buffer[bytesRead] = '\0';
 	DEBUG("file contents:\n%s\n", buffer);
-	
-	return json_parse(buffer, length);
+
+	JsonNode* root = json_parseCtx(ctx, buffer, bytesRead, error);
+	if (error && error->code != JSON_ERROR_NONE) {
+		json_error_locate(error, buffer); // The buffer won't outlive this function
+	}
+	json_context_free(ctx, buffer, length + 1);
+	return root;
+}
+
+JsonNode* json_parseFileStreamed(char* path) {
+	return json_parseFileStreamedCtx(json_context_default(), path, NULL);
+}
+
+JsonNode* json_parseFileStreamedCtx(JsonContext* ctx, char* path, JsonError* error) {
+	FILE* stream = fopen(path, "rb");
+	if (!stream) {
+		if (error) {
+			*error = (JsonError){ JSON_ERROR_FILE, 0, 0, 0 };
+		}
+		json_error_reportCtx(ctx, "JSON_ERROR: fopen returned NULL, in json_parseFileStreamed");
+		return NULL;
+	}
+	FileSource source;
+	memset(&source, 0, sizeof(source));
+	source.ctx = ctx;
+	source.stream = stream;
+	source.blocks = json_context_alloc(ctx, JSON_FILE_RING_BLOCKS * JSON_FILE_BLOCK_SIZE);
+	source.windowCapacity = 2 * JSON_FILE_BLOCK_SIZE;
+	source.window = json_context_alloc(ctx, source.windowCapacity);
+	JsonNode* root = NULL;
+	if (source.blocks && source.window) {
+#ifndef JSON_NO_THREADS
+		json_mutex_init(&source.mutex);
+		json_cond_init(&source.changed);
+		source.threaded = json_thread_start(&source.reader, _readFile, &source);
+#endif
+		ParserState state;
+		_initState(&state, ctx, ctx, source.window, 0);
+		state.source = &source;
+		root = _parse(&state, error);
+		if (state.stack.nodes != state.stack.inlineNodes) {
+			json_context_free(ctx, state.stack.nodes, state.stack.max * sizeof(JsonNode*));
+		}
+		json_context_free(ctx, state.numbers.values, state.numbers.max * sizeof(JsonPackedValue));
+#ifndef JSON_NO_THREADS
+		if (source.threaded) { // The parser may have stopped early, with the reader waiting for room in the ring
+			json_mutex_lock(&source.mutex);
+			source.stopping = true;
+			json_cond_broadcast(&source.changed);
+			json_mutex_unlock(&source.mutex);
+			json_thread_join(&source.reader);
+		}
+		json_cond_destroy(&source.changed);
+		json_mutex_destroy(&source.mutex);
+#endif
+	} else {
+		if (error) {
+			*error = (JsonError){ JSON_ERROR_OUT_OF_MEMORY, 0, 0, 0 };
+		}
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_parseFileStreamed failed, alloc returned NULL");
+	}
+	fclose(stream);
+	json_context_free(ctx, source.blocks, JSON_FILE_RING_BLOCKS * JSON_FILE_BLOCK_SIZE);
+	json_context_free(ctx, source.window, source.windowCapacity);
+	json_context_free(ctx, source.keys, source.keysMax);
+	return root;
+}
+
+
+bool json_validate(const char* buffer, ptrdiff_t length, JsonError* error) {
+	return json_validateCtx(json_context_default(), buffer, length, error);
 }
 
+bool json_validateCtx(JsonContext* ctx, const char* buffer, ptrdiff_t length, JsonError* error) {
+	if (!buffer || length < 0) return false;
+	// NOTE: The buffer is only ever read, the context only allocates for deep nesting (see _pushLevel)
+	ParserState state;
+	_initState(&state, ctx, ctx, (char*)buffer, length);
+	bool valid = _skipDocument(&state);
+	if (error) {
+		*error = state.error;
+	}
+	return valid;
+}
 
-// Predicates
-static bool _numberPredicate(char c) { // TODO: fix bandaid fix
-	return c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-' || isdigit((unsigned char)c); 
+bool json_reformat(const char* buffer, ptrdiff_t length, JsonSink sink, enum JsonWriteOption option, JsonError* error) {
+	return json_reformatCtx(json_context_default(), buffer, length, sink, option, error);
 }
-static bool _letterPredicate(char c) { return isalpha((unsigned char)c); }
-static bool _errorPredicate(char c) { return _getParser(c) == _error; }
 
-static JsonNode* _error(char* buffer, ptrdiff_t length, ptrdiff_t* offset) {
-	char* string = _scanWhile(_errorPredicate, buffer, length, offset);
-	return json_node_create("JSON_ERROR: unexpected character(s) ", (JsonValue){JSON_ERROR, .string = string});
+bool json_reformatCtx
+	(JsonContext* ctx, const char* buffer, ptrdiff_t length, JsonSink sink, enum JsonWriteOption option, JsonError* error) {
+	if (!buffer || length < 0 || !sink.write) return false;
+	if (option != JSON_WRITE_PRETTY && option != JSON_WRITE_CONDENSED) return false;
+	Reformatter out;
+	out.sink = sink;
+	out.pretty = option == JSON_WRITE_PRETTY;
+	out.depth = 0;
+	out.count = 0;
+	ParserState state;
+	_initState(&state, ctx, ctx, (char*)buffer, length);
+	state.out = &out;
+	bool valid = _skipDocument(&state) && _outFlush(&state);
+	if (error) {
+		*error = state.error;
+	}
+	return valid;
 }
 
-// NOTE: a parser returning NULL means an unimportant character was parsed, a parser that fails returns JSON_ERROR
-static JsonNode* _skip(char* buffer, ptrdiff_t length, ptrdiff_t* offset) {
-	char c = json_buf_get(buffer, length, offset);
-	if (c == ' ' || c == ',' || c == ':') {
-		DEBUG("( %c ) skipped", c);
+
+JsonParser* json_parser_create(void) {
+	return json_parser_createCtx(json_context_default());
+}
+
+JsonParser* json_parser_createCtx(JsonContext* ctx) {
+	JsonParser* parser = json_context_alloc(ctx, sizeof(JsonParser));
+	if (!parser) return NULL;
+	parser->pool = json_pool_create();
+	if (!parser->pool) {
+		json_context_free(ctx, parser, sizeof(JsonParser));
+		return NULL;
+	}
+	json_context_init(&parser->context);
+	json_context_setAllocator(&parser->context, json_pool_alloc, json_pool_free, json_pool_realloc, parser->pool);
+	parser->context.onErrorReported = ctx->onErrorReported;
+	parser->context.onCriticalErrorReported = ctx->onCriticalErrorReported;
+	parser->context.onMaxErrors = ctx->onMaxErrors;
+	parser->context.limits = ctx->limits;
+	parser->context.packArrays = ctx->packArrays;
+	parser->owner = ctx;
+	parser->stack = NULL;
+	parser->stackMax = 0;
+	parser->numbers = NULL;
+	parser->numbersMax = 0;
+	return parser;
+}
+
+JsonNode* json_parser_parse(JsonParser* parser, char* buffer, ptrdiff_t length, JsonError* error) {
+	if (!parser || !buffer || length < 0) return NULL;
+	JsonNode* overSize = _overSize(&parser->context, length, error);
+	if (overSize) return overSize;
+	ParserState state;
+	_initState(&state, &parser->context, parser->owner, buffer, length);
+	if (parser->stack) {
+		state.stack.nodes = parser->stack;
+		state.stack.max = parser->stackMax;
+	}
+	state.numbers.values = parser->numbers;
+	state.numbers.max = parser->numbersMax;
+	JsonNode* root = _parse(&state, error);
+	if (state.stack.nodes != state.stack.inlineNodes) { // Kept for the next document
+		parser->stack = state.stack.nodes;
+		parser->stackMax = state.stack.max;
+	}
+	parser->numbers = state.numbers.values;
+	parser->numbersMax = state.numbers.max;
+	return root;
+}
+
+void json_parser_reset(JsonParser* parser) {
+	if (!parser) return;
+	json_pool_reset(parser->pool);
+	json_error_resetCtx(&parser->context);
+}
+
+void json_parser_destroy(JsonParser* parser) {
+	if (!parser) return;
+	json_pool_destroy(parser->pool);
+	json_context_free(parser->owner, parser->stack, parser->stackMax * sizeof(JsonNode*));
+	json_context_free(parser->owner, parser->numbers, parser->numbersMax * sizeof(JsonPackedValue));
+	json_context_free(parser->owner, parser, sizeof(JsonParser));
+}
+
+
+// Readies a state for parsing (or skipping) the buffer, with the stack in the state itself. Only the callers that
+// reformat, stream or parse lazily set out, source or lazy afterwards.
+static void _initState(ParserState* state, JsonContext* ctx, JsonContext* scratchCtx, char* buffer, ptrdiff_t length) {
+	state->ctx = ctx;
+	state->scratchCtx = scratchCtx;
+	state->buffer = buffer;
+	state->length = length;
+	state->offset = 0;
+	state->error = (JsonError){ JSON_ERROR_NONE, 0, 0, 0 };
+	state->stack.nodes = state->stack.inlineNodes; // Nothing is read from inlineNodes before it's pushed
+	state->stack.max = JSON_PARSER_STACK_CAPACITY;
+	state->stack.count = 0;
+	state->numbers.values = NULL;
+	state->numbers.max = 0;
+	state->numbers.count = 0;
+	state->out = NULL;
+	state->source = NULL;
+	state->lazy = false;
+	state->limits = _limitsOf(ctx);
+	state->used.depth = 0;
+	state->used.nodes = 0;
+	state->used.bytes = 0;
+}
+
+static JsonNode* _parseBuffer(JsonContext* ctx, char* buffer, ptrdiff_t length, JsonError* error, bool lazy) {
+	if (!buffer || length < 0) return NULL;
+	JsonNode* overSize = _overSize(ctx, length, error);
+	if (overSize) return overSize;
+	ParserState state;
+	_initState(&state, ctx, ctx, buffer, length);
+	state.lazy = lazy;
+	JsonNode* root = _parse(&state, error);
+	if (state.stack.nodes != state.stack.inlineNodes) {
+		json_context_free(ctx, state.stack.nodes, state.stack.max * sizeof(JsonNode*));
+	}
+	json_context_free(ctx, state.numbers.values, state.numbers.max * sizeof(JsonPackedValue));
+	return root;
+}
+
+// Parses the whole buffer, the stack is left for the caller to free (or keep).
+static JsonNode* _parse(ParserState* state, JsonError* error) {
+	JSON_STATS_START(timer);
+	JsonContext* ctx = state->ctx;
+	JsonNode* root = _value(state);
+	if (root) {
+		_skipWhitespace(state);
+		if (state->offset < state->length) {
+			json_node_freeCtx(ctx, root);
+			root = _fail(state, JSON_ERROR_TRAILING_CHARACTERS, state->offset);
+		}
+	}
+	if (error) {
+		*error = state->error;
+	}
+	JSON_STATS_ADD(ctx, bytesParsed, state->offset);
+	JSON_STATS_STOP(ctx, parseTime, timer);
+	if (!root) {
+		DEBUG("a parsing error occurred at byte %td", state->error.offset);
+		json_error_reportCtx(ctx, json_error_message(state->error.code));
+		return json_error_node(state->error.code);
+	}
+	return root;
+}
+
+// The validator, which follows the same grammar (and reports the same errors) as the parsers below,
+// but only moves past each value. With state->out set, it copies each token it moves past there,
+// separated by the layout's whitespace instead of the buffer's. Of the limits, only the size and depth
+// bound what validating takes, the others bound the tree a parser would build.
+static bool _skipDocument(ParserState* state) {
+	if (state->limits && state->limits->maxSize && state->length > state->limits->maxSize) {
+		_fail(state, JSON_ERROR_LIMIT_SIZE, state->limits->maxSize);
+		return false;
+	}
+	NestingStack nesting;
+	nesting.bits = nesting.inlineBits;
+	nesting.max = (ptrdiff_t)sizeof(nesting.inlineBits) * 8;
+	nesting.depth = 0;
+	bool valid = _skipValue(state, &nesting);
+	if (nesting.bits != nesting.inlineBits) {
+		json_context_free(state->scratchCtx, nesting.bits, nesting.max / 8);
+	}
+	if (!valid) return false;
+	_skipWhitespace(state);
+	if (state->offset < state->length) {
+		_fail(state, JSON_ERROR_TRAILING_CHARACTERS, state->offset);
+		return false;
+	}
+	return true;
+}
+
+// Moves past a value and everything nested in it. Containers don't recurse, opening one pushes a level and
+// each value is followed by the ',' or the closing brackets after it, until the value the walk started at is done.
+static bool _skipValue(ParserState* state, NestingStack* nesting) {
+	Reformatter* out = state->out;
+	while (true) {
+		_skipWhitespace(state);
+		if (state->offset < state->length && (state->buffer[state->offset] == '{' || state->buffer[state->offset] == '[')) {
+			bool isObject = state->buffer[state->offset] == '{';
+			if (state->limits && state->limits->maxDepth && nesting->depth >= state->limits->maxDepth) {
+				_fail(state, JSON_ERROR_LIMIT_DEPTH, state->offset);
+				return false;
+			}
+			state->offset++;
+			_skipWhitespace(state);
+			if (_consume(state, isObject ? '}' : ']')) {
+				if (!_outWrite(state, isObject ? "{}" : "[]", 2)) return false;
+			} else {
+				if (!_outWrite(state, isObject ? "{" : "[", 1) || !_pushLevel(state, nesting, isObject)) return false;
+				if (out) out->depth++;
+				if (isObject ? !_skipKey(state) : !_outNewline(state)) return false;
+				continue; // On to its first value
+			}
+		} else if (!_skipScalar(state)) {
+			return false;
+		}
+		// The value's done, so is every container it was the last value of
+		while (true) {
+			if (nesting->depth == 0) return true;
+			ptrdiff_t level = nesting->depth - 1;
+			bool isObject = (nesting->bits[level / 64] >> (level % 64)) & 1;
+			_skipWhitespace(state);
+			if (_consume(state, ',')) {
+				if (!_outWrite(state, ",", 1)) return false;
+				if (isObject ? !_skipKey(state) : !_outNewline(state)) return false;
+				break; // On to the next value
+			}
+			if (!_consume(state, isObject ? '}' : ']')) {
+				_fail(state, isObject ? JSON_ERROR_EXPECTED_COMMA_OR_BRACE : JSON_ERROR_EXPECTED_COMMA_OR_BRACKET, state->offset);
+				return false;
+			}
+			nesting->depth--;
+			if (out) out->depth--;
+			if (!_outNewline(state) || !_outWrite(state, isObject ? "}" : "]", 1)) return false;
+		}
+	}
+}
+
+// Moves past a value that isn't a container
+static bool _skipScalar(ParserState* state) {
+	if (state->offset >= state->length) {
+		_fail(state, JSON_ERROR_UNEXPECTED_END, state->offset);
+		return false;
+	}
+	ptrdiff_t start = state->offset;
+	StringSpan span;
+	bool isInteger;
+	bool skipped;
+	switch (state->buffer[start]) {
+		case '"':
+			skipped = _scanString(state, &span);
+			break;
+		case 't':
+		case 'f':
+			skipped = _literal(state, "true", 4) || _literal(state, "false", 5);
+			if (!skipped) _fail(state, JSON_ERROR_INVALID_LITERAL, start);
+			break;
+		case 'n':
+			skipped = _literal(state, "null", 4);
+			if (!skipped) _fail(state, JSON_ERROR_INVALID_LITERAL, start);
+			break;
+		case '-':
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+			skipped = _scanNumber(state, &isInteger);
+			break;
+		default:
+			_fail(state, JSON_ERROR_UNEXPECTED_CHARACTER, start);
+			return false;
+	}
+	return skipped && _outWrite(state, state->buffer + start, state->offset - start);
+}
+
+// Moves past an object member's key and its ':', up to the value
+static bool _skipKey(ParserState* state) {
+	_skipWhitespace(state);
+	if (state->offset >= state->length || state->buffer[state->offset] != '"') {
+		_fail(state, JSON_ERROR_EXPECTED_KEY, state->offset);
+		return false;
+	}
+	ptrdiff_t keyStart = state->offset;
+	StringSpan key;
+	if (!_scanString(state, &key)) return false;
+	if (!_outNewline(state) || !_outWrite(state, state->buffer + keyStart, state->offset - keyStart)) return false;
+	_skipWhitespace(state);
+	if (!_consume(state, ':')) {
+		_fail(state, JSON_ERROR_EXPECTED_COLON, state->offset);
+		return false;
+	}
+	return !state->out || _outWrite(state, ": ", state->out->pretty ? 2 : 1);
+}
+
+// Opens a level, doubling the bits once they're full
+static bool _pushLevel(ParserState* state, NestingStack* nesting, bool isObject) {
+	if (nesting->depth == nesting->max) {
+		JsonContext* ctx = state->scratchCtx;
+		uint64_t* bits = json_context_alloc(ctx, nesting->max / 4);
+		if (!bits) {
+			_fail(state, JSON_ERROR_OUT_OF_MEMORY, state->offset);
+			return false;
+		}
+		memcpy(bits, nesting->bits, nesting->max / 8);
+		if (nesting->bits != nesting->inlineBits) {
+			json_context_free(ctx, nesting->bits, nesting->max / 8);
+		}
+		nesting->bits = bits;
+		nesting->max *= 2;
+	}
+	ptrdiff_t level = nesting->depth++;
+	uint64_t bit = (uint64_t)1 << (level % 64);
+	if (isObject) {
+		nesting->bits[level / 64] |= bit;
 	} else {
-		char* escaped = json_utils_escapeChar(c);
-		DEBUG("( %s ) skipped", escaped);
-		json_allocator.free(escaped, strlen(escaped), json_allocator.context);
+		nesting->bits[level / 64] &= ~bit;
 	}
-	return NULL;
+	return true;
 }
 
-static JsonNode* _object(char* buffer, ptrdiff_t length, ptrdiff_t* offset) {
-	if (!json_buf_expect('{', buffer, length, offset)) 
-		return json_node_create("JSON_ERROR: ( { ) missing ", (JsonValue){JSON_ERROR, .string = NULL});
+// Copies bytes to the reformatted output, if there is one. Anything larger than the block goes to the sink directly.
+static bool _outWrite(ParserState* state, const char* bytes, ptrdiff_t length) {
+	Reformatter* out = state->out;
+	if (!out) return true;
+	if (out->count + length > JSON_SINK_BUFFER_SIZE) {
+		if (!_outFlush(state)) return false;
+		if (length > JSON_SINK_BUFFER_SIZE) {
+			if (out->sink.write(out->sink.user, bytes, length)) return true;
+			_fail(state, JSON_ERROR_OUTPUT, state->offset);
+			return false;
+		}
+	}
+	memcpy(out->bytes + out->count, bytes, length);
+	out->count += length;
+	return true;
+}
+
+// Starts a new, indented line in pretty output.
+static bool _outNewline(ParserState* state) {
+	Reformatter* out = state->out;
+	if (!out || !out->pretty) return true;
+	if (!_outWrite(state, "\n", 1)) return false;
+	for (ptrdiff_t i = 0; i < out->depth; i++) {
+		if (!_outWrite(state, "\t", 1)) return false;
+	}
+	return true;
+}
+
+static bool _outFlush(ParserState* state) {
+	Reformatter* out = state->out;
+	if (out->count > 0 && !out->sink.write(out->sink.user, out->bytes, out->count)) {
+		_fail(state, JSON_ERROR_OUTPUT, state->offset);
+		return false;
+	}
+	out->count = 0;
+	return true;
+}
+
+
+static JsonNode* _error(ParserState* state) {
+	return _fail(state, JSON_ERROR_UNEXPECTED_CHARACTER, state->offset);
+}
+
+static JsonNode* _object(ParserState* state) {
+	JsonContext* ctx = state->ctx;
+	ptrdiff_t start = state->offset++; // We know it's '{'
+	ptrdiff_t base = state->stack.count;
 	DEBUG("( { ) parsed");
-	JsonNode* jobject = json_node_create(NULL, (JsonValue){JSON_OBJECT, {0}});
-	char* identifier = NULL;
-	char nextChar;
-	while ((nextChar = json_buf_peek(buffer, length, *offset)) != '}' && *offset < length) {
-		parserFunc currentParser = _getParser(nextChar);
-		JsonNode* appendee = currentParser(buffer, length, offset);
+	_skipWhitespace(state);
+	if (_consume(state, '}'))
+		return _popContainer(state, JSON_OBJECT, base, start);
+	while (true) {
+		_skipWhitespace(state);
+		if (state->offset >= state->length || state->buffer[state->offset] != '"') {
+			_discard(state, base);
+			return _fail(state, JSON_ERROR_EXPECTED_KEY, state->offset);
+		}
+		StringSpan key;
+		if (!_scanString(state, &key) || (state->limits && !_countString(state, &key, true))) {
+			_discard(state, base);
+			return NULL;
+		}
+		ptrdiff_t heldKey = state->source ? _holdKey(state, &key) : 0;
+		if (heldKey < 0) {
+			_discard(state, base);
+			return _fail(state, JSON_ERROR_OUT_OF_MEMORY, key.start - 1);
+		}
+		_skipWhitespace(state);
+		if (!_consume(state, ':')) {
+			_discard(state, base);
+			return _fail(state, JSON_ERROR_EXPECTED_COLON, state->offset);
+		}
+		JsonNode* appendee = _value(state);
 		if (!appendee) {
-			continue;
-		} else if (appendee->value.type == JSON_ERROR) {
-			json_node_free(jobject);
-			return appendee;
-		} else if (!identifier && appendee->value.type == JSON_STRING) {
-			identifier = json_allocator.alloc(strlen(appendee->value.string) + 1, json_allocator.context);
-			sprintf(identifier, "%s", appendee->value.string);
-			json_node_free(appendee);
+			_discard(state, base);
+			return NULL;
+		}
+		// The key is only decoded now that its node exists, so short keys go straight into it
+		char* identifier = json_node_allocIdentifierCtx(ctx, appendee, key.length);
+		if (!identifier) {
+			json_node_freeCtx(ctx, appendee);
+			_discard(state, base);
+			return _fail(state, JSON_ERROR_OUT_OF_MEMORY, key.start - 1);
+		}
+		if (state->source) {
+			memcpy(identifier, state->source->keys + heldKey, key.length + 1);
+			state->source->keysLength = heldKey;
 		} else {
-			appendee->identifier = identifier;
-			json_node_append(jobject, appendee);
-			identifier = NULL;
+			_decodeString(state, &key, identifier);
 		}
-	}
-	if (!json_buf_expect('}', buffer, length, offset)) {
-		json_node_free(jobject);
-		DEBUG("( } ) missing");
-		return json_node_create("JSON_ERROR: ( } ) missing ", (JsonValue){JSON_ERROR, .string = NULL});
+		if (!_push(state, appendee)) {
+			_discard(state, base);
+			return _fail(state, JSON_ERROR_OUT_OF_MEMORY, start);
+		}
+		_skipWhitespace(state);
+		if (_consume(state, ','))
+			continue;
+		if (_consume(state, '}'))
+			break;
+		_discard(state, base);
+		return _fail(state, JSON_ERROR_EXPECTED_COMMA_OR_BRACE, state->offset);
 	}
 	DEBUG("( } ) parsed");
-	return jobject;
+	return _popContainer(state, JSON_OBJECT, base, start);
 }
 
-static JsonNode* _array(char* buffer, ptrdiff_t length, ptrdiff_t* offset) {
-	if (!json_buf_expect('[', buffer, length, offset))
-		json_node_create("JSON_ERROR: ( [ ) missing ", (JsonValue){JSON_ERROR, .string = NULL});
+// While every element so far is a number of the same type, the elements are collected as values on the numbers
+// stack rather than as nodes, for the array to be packed. The first element that doesn't fit turns the numbers
+// collected into nodes, and the array is parsed as usual from there on.
+// NOTE: The numbers need no freeing, so failing only discards the nodes. And only this array's numbers are ever
+// on top of the stack, since they're unpacked before any other value (e.g. a nested array) is parsed.
+static JsonNode* _array(ParserState* state) {
+	ptrdiff_t start = state->offset++; // We know it's '['
+	ptrdiff_t base = state->stack.count;
+	ptrdiff_t numbersBase = state->numbers.count;
+#ifdef JSON_NO_PACKED_ARRAYS
+	JsonType packing = JSON_ERROR;
+#else
+	// The type of the numbers so far, JSON_NULL before the first, JSON_ERROR once it can't be packed (or isn't asked to be)
+	JsonType packing = state->ctx->packArrays ? JSON_NULL : JSON_ERROR;
+#endif
 	DEBUG("( [ ) parsed");
-	JsonNode* jarray = json_node_create(NULL, (JsonValue){JSON_ARRAY, {0}});
-	char nextChar;
-	while ((nextChar = json_buf_peek(buffer, length, *offset)) != ']' && *offset < length) {
-		parserFunc currentParser = _getParser(nextChar);
-		JsonNode* appendee = currentParser(buffer, length, offset);
-		if (!appendee) {
-			continue;
-		} else if (appendee->value.type == JSON_ERROR) {
-			json_node_free(jarray);
-			return appendee;
+	_skipWhitespace(state);
+	if (_consume(state, ']'))
+		return _popContainer(state, JSON_ARRAY, base, start);
+	while (true) {
+		_skipWhitespace(state);
+		ptrdiff_t valueStart = state->offset;
+		JsonValue number = {JSON_ERROR, {0}};
+		if (packing != JSON_ERROR && state->offset < state->length && _getParser(state->buffer[state->offset]) == _number
+			&& !_numberValue(state, &number)) {
+			_discard(state, base);
+			return NULL;
 		}
-		json_node_append(jarray, appendee);
-	}
-	if (!json_buf_expect(']', buffer, length, offset)) {
-		json_node_free(jarray);
-		return json_node_create("JSON_ERROR: ( ] ) missing ", (JsonValue){JSON_ERROR, .string = NULL});
+		if (number.type != JSON_ERROR && state->limits) { // Numbers read here are counted here, not by _value
+			bool fits = packing == JSON_NULL || packing == number.type;
+			if (!_countNode(state, fits ? (ptrdiff_t)sizeof(JsonPackedValue) : (ptrdiff_t)sizeof(JsonNode), valueStart)) {
+				_discard(state, base);
+				return NULL;
+			}
+		}
+		if (number.type != JSON_ERROR && (packing == JSON_NULL || packing == number.type)) {
+			packing = number.type;
+			if (!_pushNumber(state, number)) {
+				_discard(state, base);
+				return _fail(state, JSON_ERROR_OUT_OF_MEMORY, start);
+			}
+		} else {
+			if (packing != JSON_ERROR) {
+				bool unpacked = _unpackNumbers(state, packing, numbersBase);
+				packing = JSON_ERROR;
+				if (!unpacked) {
+					_discard(state, base);
+					return _fail(state, JSON_ERROR_OUT_OF_MEMORY, start);
+				}
+			}
+			// A number of the other type has been scanned already
+			JsonNode* appendee = number.type != JSON_ERROR ? json_node_createCtx(state->ctx, NULL, number) : _value(state);
+			if (!appendee) {
+				_discard(state, base);
+				return _fail(state, JSON_ERROR_OUT_OF_MEMORY, state->offset); // Unless _value failed first
+			}
+			if (!_push(state, appendee)) {
+				_discard(state, base);
+				return _fail(state, JSON_ERROR_OUT_OF_MEMORY, start);
+			}
+		}
+		_skipWhitespace(state);
+		if (_consume(state, ','))
+			continue;
+		if (_consume(state, ']'))
+			break;
+		_discard(state, base);
+		return _fail(state, JSON_ERROR_EXPECTED_COMMA_OR_BRACKET, state->offset);
 	}
 	DEBUG("( ] ) parsed");
-	return jarray;
+	if (packing != JSON_ERROR)
+		return _popNumbers(state, packing, base, numbersBase, start);
+	return _popContainer(state, JSON_ARRAY, base, start);
 }
 
-static JsonNode* _boolean(char* buffer, ptrdiff_t length, ptrdiff_t* offset) {
-	char* boolString = _scanWhile(_letterPredicate, buffer, length, offset);
-	JsonNode* jnode;
-	if (strcmp(boolString, "true") == 0) {
+static JsonNode* _boolean(ParserState* state) {
+	if (_literal(state, "true", 4)) {
 		DEBUG("( true ) parsed");
-		jnode = json_node_create(NULL, (JsonValue){JSON_BOOL, .boolean = true});
-		json_allocator.free(boolString, strlen(boolString), json_allocator.context);
-	} else if (strcmp(boolString, "false") == 0) {
+		return json_node_createCtx(state->ctx, NULL, (JsonValue){JSON_BOOL, .boolean = true});
+	} else if (_literal(state, "false", 5)) {
 		DEBUG("( false ) parsed");
-		jnode = json_node_create(NULL, (JsonValue){JSON_BOOL, .boolean = false});
-		json_allocator.free(boolString, strlen(boolString), json_allocator.context);
-	} else {
-		jnode = json_node_create("JSON_ERROR: unexpected character(s) ", (JsonValue){JSON_ERROR, .string = boolString});
+		return json_node_createCtx(state->ctx, NULL, (JsonValue){JSON_BOOL, .boolean = false});
 	}
+	return _fail(state, JSON_ERROR_INVALID_LITERAL, state->offset);
+}
+
+static JsonNode* _string(ParserState* state) {
+	ptrdiff_t start = state->offset;
+	StringSpan span;
+	if (!_scanString(state, &span))
+		return NULL;
+	if (state->limits && !_countString(state, &span, !state->lazy))
+		return NULL;
+	JsonNode* jnode = json_node_createCtx(state->ctx, NULL, (JsonValue){JSON_STRING, .string = NULL});
+	if (jnode && state->lazy) { // Left as it is in the buffer, escapes and all, until it's read
+		bool isEscaped = span.length != span.end - span.start; // Every escape is longer than what it stands for
+		jnode->value.string = state->buffer + span.start;
+		jnode->value.stringLength = span.end - span.start;
+		jnode->flags |= JSON_FLAG_RAW | JSON_FLAG_UNDECODED | (isEscaped ? JSON_FLAG_ESCAPED : 0);
+		return jnode;
+	}
+	char* string = json_node_allocStringCtx(state->ctx, jnode, span.length);
+	if (!string) {
+		json_node_freeCtx(state->ctx, jnode);
+		return _fail(state, JSON_ERROR_OUT_OF_MEMORY, start);
+	}
+	_decodeString(state, &span, string);
+	DEBUG("( \"%s\" ) parsed", string);
 	return jnode;
 }
 
-// TODO: _string should unescape hex codes (\uA25D)
-static JsonNode* _string(char* buffer, ptrdiff_t length, ptrdiff_t* offset) {
-	json_buf_get(buffer, length, offset); // Not json_bufexpect because at this point we know it's '"'
-	ptrdiff_t originalOffset = *offset;
-	ptrdiff_t bytesToAlloc = 0;
-	char currentChar;
-	while ((currentChar = json_buf_get(buffer, length, offset)) != '"') {
-		if (currentChar == '\\') {
-			bytesToAlloc++;
-			// TODO: support hexcodes
-			json_buf_get(buffer, length, offset); // Discard the next character
-			continue;
+// NOTE: Integers are decoded right away even when parsing lazily, that's hardly more work than scanning them.
+static JsonNode* _number(ParserState* state) {
+	ptrdiff_t start = state->offset;
+	bool isInteger;
+	if (!_scanNumber(state, &isInteger))
+		return NULL;
+	ptrdiff_t length = state->offset - start;
+	if (state->lazy && !isInteger && length < JSON_RAW_REAL_SIZE) {
+		JsonNode* jnode = json_node_createCtx(state->ctx, NULL, (JsonValue){JSON_REAL, {0}});
+		if (jnode) { // The text is kept in place of the value, see json_node_decode
+			jnode->value.string = state->buffer + start;
+			jnode->value.stringLength = length;
+			jnode->flags |= JSON_FLAG_RAW | JSON_FLAG_UNDECODED;
 		}
-		bytesToAlloc++;
-	}
-	char* string = json_allocator.alloc(bytesToAlloc + 1, json_allocator.context);
-	if (!string)
-		return json_node_create("JSON_ERROR: out of memory ", (JsonValue){JSON_ERROR, .string = NULL});
-	ptrdiff_t i = 0;
-	*offset = originalOffset;
-	while ((currentChar = json_buf_get(buffer, length, offset)) != '"') {
-		char unescapedChar = json_utils_unescapeChar(buffer + *offset - 1);
-		if (unescapedChar != '\0') {
-			string[i++] = unescapedChar;
-			// TODO: support hexcodes
-			json_buf_get(buffer, length, offset); // Discard the next character
-			continue;
+		return jnode;
+	}
+	JsonValue value;
+	if (!_decodeNumber(state, start, isInteger, &value))
+		return NULL;
+	return json_node_createCtx(state->ctx, NULL, value);
+}
+
+static bool _numberValue(ParserState* state, JsonValue* value) {
+	ptrdiff_t start = state->offset;
+	bool isInteger;
+	return _scanNumber(state, &isInteger) && _decodeNumber(state, start, isInteger, value);
+}
+
+// Decodes the number scanned from 'start' up to the offset.
+static bool _decodeNumber(ParserState* state, ptrdiff_t start, bool isInteger, JsonValue* value) {
+	char* buffer = state->buffer; // Only now, scanning a streamed file may have moved it
+	ptrdiff_t i = state->offset;
+
+	// Up to 18 digits can't overflow an int64_t, so the common case skips strtoll/strtod entirely
+	ptrdiff_t numLength = i - start;
+	if (isInteger && numLength - (buffer[start] == '-') <= 18) {
+		int64_t integer = 0;
+		for (ptrdiff_t j = start + (buffer[start] == '-'); j < i; j++) {
+			integer = integer * 10 + (buffer[j] - '0');
 		}
-		string[i++] = currentChar;
+		integer = buffer[start] == '-' ? -integer : integer;
+		DEBUG("( %" PRId64 " ) parsed", integer);
+		*value = (JsonValue){JSON_INT, .integer = integer};
+		return true;
 	}
-	string[i] = '\0';
-	DEBUG("( \"%s\" ) parsed", string);
-	return json_node_create(NULL, (JsonValue){JSON_STRING, .string = string});
-}
-
-// TODO: _number isn't compliant with the JSON standard
-static JsonNode* _number(char* buffer, ptrdiff_t length, ptrdiff_t* offset) {
-	char* numString = _scanWhile(_numberPredicate, buffer, length, offset);
-	if (!numString)
-		return json_node_create("JSON_ERROR: out of memory ", (JsonValue){JSON_ERROR, .string = NULL});
-	char* end;
-	double real = strtod(numString, &end);
-	*offset -= &numString[strlen(numString) - 1] - end;
-	double integer;
-	json_allocator.free(numString, strlen(numString), json_allocator.context);
-	if (modf(real, &integer) == 0.0) {
-		DEBUG("( %d ) parsed", (int)integer);
-		return json_node_create(NULL, (JsonValue){JSON_INT, .integer = (int64_t)integer});
-	}
-	DEBUG("( %lf ) parsed", real);
-	return json_node_create(NULL, (JsonValue){JSON_REAL, .real = real});
-}
-
-static JsonNode* _null(char* buffer, ptrdiff_t length, ptrdiff_t* offset) {
-	char* nullString = _scanWhile(_letterPredicate, buffer, length, offset);
-	if (!nullString)
-		return json_node_create("JSON_ERROR: out of memory ", (JsonValue){JSON_ERROR, .string = NULL});
-	JsonNode* jnode = NULL;
-	if (strcmp(nullString, "null") == 0) {
-		DEBUG("( null ) parsed");
-		jnode = json_node_create(NULL, (JsonValue){JSON_NULL, {0}});
-	}
-	json_allocator.free(nullString, strlen(nullString), json_allocator.context);
-	return jnode;
+
+	// The buffer isn't necessarily null terminated, so the number is copied out first
+	char stackString[64];
+	char* numString = numLength < (ptrdiff_t)sizeof(stackString)
+		? stackString
+		: json_context_alloc(state->ctx, numLength + 1);
+	if (!numString) {
+		_fail(state, JSON_ERROR_OUT_OF_MEMORY, start);
+		return false;
+	}
+	memcpy(numString, buffer + start, numLength);
+	numString[numLength] = '\0';
+	*value = (JsonValue){JSON_REAL, {0}};
+	errno = 0;
+	if (isInteger && ((value->integer = strtoll(numString, NULL, 10)), errno != ERANGE)) {
+		value->type = JSON_INT;
+	} else {
+		double integer;
+		value->real = strtod(numString, NULL);
+		if (modf(value->real, &integer) == 0.0 && integer >= -9223372036854775808.0 && integer < 9223372036854775808.0) {
+			*value = (JsonValue){JSON_INT, .integer = (int64_t)integer};
+		}
+	}
+	if (numString != stackString) {
+		json_context_free(state->ctx, numString, numLength + 1);
+	}
+	DEBUG("( %.*s ) parsed", (int)numLength, buffer + start);
+	return true;
+}
+
+static JsonNode* _null(ParserState* state) {
+	if (!_literal(state, "null", 4))
+		return _fail(state, JSON_ERROR_INVALID_LITERAL, state->offset);
+	DEBUG("( null ) parsed");
+	return json_node_createCtx(state->ctx, NULL, (JsonValue){JSON_NULL, {0}});
 }
 
 static parserFunc _getParser(char character) {
 	switch (character) {
 		case '{':
-		case '}':
 			return _object;
 		case '[':
-		case ']':
 			return _array;
 		case '"':
 			return _string;
-		case ',':
-		case ':':
-			return _skip;
 		case 't': // true
 		case 'f': // false
 			return _boolean;
 		case 'n': // null
 			return _null;
-		default: // number or whitespace
-			if (isdigit(character)) {
-				return _number;
-			} else if (isspace(character)) {
-				return _skip;
-			}
+		case '-':
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+			return _number;
+		default:
 			return _error;
 	}
 }
 
-char* _scanWhile(bool (*predicate)(char), char* buffer, ptrdiff_t length, ptrdiff_t* offset) {
-	if (!predicate || !buffer || !offset) return NULL;
-	ptrdiff_t max = JSON_DYNAMIC_ARRAY_CAPACITY;
-	ptrdiff_t current = 0;
-	char* string = json_allocator.alloc(max, json_allocator.context);
-	if (!string) {
+static JsonNode* _value(ParserState* state) {
+	_skipWhitespace(state);
+	if (state->offset >= state->length)
+		return _fail(state, JSON_ERROR_UNEXPECTED_END, state->offset);
+	char first = state->buffer[state->offset];
+	if (state->limits && !_countValue(state, first))
 		return NULL;
+	JsonNode* jnode = _getParser(first)(state);
+	if (state->limits && (first == '{' || first == '[')) {
+		state->used.depth--;
+	}
+	if (!jnode && state->error.code == JSON_ERROR_NONE) {
+		return _fail(state, JSON_ERROR_OUT_OF_MEMORY, state->offset);
+	}
+	return jnode;
+}
+
+static JsonNode* _fail(ParserState* state, JsonErrorCode code, ptrdiff_t offset) {
+	if (code < JSON_ERROR_OUT_OF_MEMORY && offset >= state->length) { // Only errors in the input come from it ending
+		code = JSON_ERROR_UNEXPECTED_END;
+	}
+	if (state->error.code == JSON_ERROR_NONE) {
+		state->error = (JsonError){ code, offset, 0, 0 };
+	}
+	return NULL;
+}
+
+static void _skipWhitespace(ParserState* state) {
+	ptrdiff_t i = state->offset;
+	do {
+		char* buffer = state->buffer;
+		while (i < state->length && (buffer[i] == ' ' || buffer[i] == '\n' || buffer[i] == '\r' || buffer[i] == '\t')) {
+			i++;
+		}
+	} while (i >= state->length && _refill(state, i));
+	state->offset = i;
+}
+
+static bool _consume(ParserState* state, char c) {
+	if (state->offset >= state->length && !_refill(state, state->offset))
+		return false;
+	if (state->buffer[state->offset] == c) {
+		state->offset++;
+		return true;
+	}
+	return false;
+}
+
+// NOTE: The literal must not run on into other letters, so 'truee' isn't accepted as 'true'.
+static bool _literal(ParserState* state, char* literal, ptrdiff_t literalLength) {
+	ptrdiff_t end = state->offset + literalLength;
+	if (end >= state->length) { // The byte after it is needed too, to see that it ends there
+		_ensure(state, end + 1, state->offset);
 	}
-	char currentChar;
-	while (*offset < length && predicate(currentChar = json_buf_get(buffer, length, offset))) {
-		json_utils_ensureCapacity(&string, &max, current + 1);
-		string[current++] = currentChar;
+	if (end > state->length || memcmp(state->buffer + state->offset, literal, literalLength) != 0)
+		return false;
+	if (end < state->length) {
+		char next = state->buffer[end];
+		if ((next >= 'a' && next <= 'z') || (next >= 'A' && next <= 'Z') || (next >= '0' && next <= '9'))
+			return false;
+	}
+	state->offset = end;
+	return true;
+}
+
+#define isDigit(c) ((c) >= '0' && (c) <= '9')
+// Scans and validates the number starting at the current offset, without converting it.
+static bool _scanNumber(ParserState* state, bool* isInteger) {
+	ptrdiff_t start = state->offset;
+	ptrdiff_t i = start;
+	*isInteger = true;
+
+	// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+	char c = _byteAt(state, i, start);
+	if (c == '-') c = _byteAt(state, ++i, start);
+	if (!isDigit(c)) {
+		_fail(state, JSON_ERROR_INVALID_NUMBER, start);
+		return false;
+	}
+	if (c == '0') {
+		c = _byteAt(state, ++i, start);
+	} else {
+		while (isDigit(c)) c = _byteAt(state, ++i, start);
+	}
+	if (c == '.') {
+		*isInteger = false;
+		c = _byteAt(state, ++i, start);
+		if (!isDigit(c)) {
+			_fail(state, JSON_ERROR_INVALID_NUMBER, start);
+			return false;
+		}
+		while (isDigit(c)) c = _byteAt(state, ++i, start);
+	}
+	if (c == 'e' || c == 'E') {
+		*isInteger = false;
+		c = _byteAt(state, ++i, start);
+		if (c == '+' || c == '-') c = _byteAt(state, ++i, start);
+		if (!isDigit(c)) {
+			_fail(state, JSON_ERROR_INVALID_NUMBER, start);
+			return false;
+		}
+		while (isDigit(c)) c = _byteAt(state, ++i, start);
+	}
+	state->offset = i;
+	return true;
+}
+#undef isDigit
+
+// Scans and validates the string starting at the current '"', without allocating.
+// Runs of plain ASCII are skipped in bulk, and only escapes and UTF-8 sequences are looked at one by one.
+static bool _scanString(ParserState* state, StringSpan* span) {
+	char* buffer = state->buffer;
+	ptrdiff_t length = state->length;
+	ptrdiff_t start = ++state->offset; // Skip the '"'
+	ptrdiff_t saved = 0; // How much shorter the escapes are once decoded
+	ptrdiff_t i = start;
+	while (true) {
+		i = _skipPlainChars(buffer, i, length);
+		if (i >= length) {
+			if (_refill(state, start)) {
+				buffer = state->buffer;
+				length = state->length;
+				continue;
+			}
+			_fail(state, JSON_ERROR_UNEXPECTED_END, length);
+			return false;
+		}
+		unsigned char c = buffer[i];
+		if (c == '"') break;
+		if (c >= 0x80 || c == '\\') {
+			if (length - i < 12) { // An escape is at most 12 bytes (a surrogate pair), a UTF-8 sequence 4
+				_ensure(state, i + 12, start);
+				buffer = state->buffer;
+				length = state->length;
+			}
+		}
+		if (c == '\\') {
+			if (i + 1 >= length) {
+				_fail(state, JSON_ERROR_UNEXPECTED_END, length);
+				return false;
+			}
+			char decoded[4];
+			ptrdiff_t written;
+			ptrdiff_t used = json_utils_unescape(buffer + i, length - i, decoded, &written);
+			if (used == 0) {
+				_fail(state, JSON_ERROR_INVALID_ESCAPE, i);
+				return false;
+			}
+			saved += used - written;
+			i += used;
+		} else if (c < 0x20) {
+			_fail(state, JSON_ERROR_CONTROL_CHARACTER, i);
+			return false;
+		} else {
+			ptrdiff_t sequenceLength = json_utils_utf8Decode(buffer + i, length - i, NULL);
+			if (sequenceLength == 0) {
+				_fail(state, JSON_ERROR_INVALID_UTF8, i);
+				return false;
+			}
+			i += sequenceLength;
+		}
+	}
+	*span = (StringSpan){ start, i, i - start - saved };
+	state->offset = i + 1; // Skip the closing '"'
+	return true;
+}
+
+// Returns the offset of the first '"', '\\', control character or non-ASCII byte from 'i' on, or 'length'.
+static ptrdiff_t _skipPlainChars(const char* buffer, ptrdiff_t i, ptrdiff_t length) {
+#ifdef JSON_SIMD_SSE2
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i space = _mm_set1_epi8(0x20);
+	while (i + 16 <= length) {
+		__m128i chunk = _mm_loadu_si128((const __m128i*)(buffer + i));
+		// A signed compare against ' ' catches the control characters and (being negative) bytes from 0x80 up
+		__m128i special = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+			_mm_cmplt_epi8(chunk, space)
+		);
+		int mask = _mm_movemask_epi8(special);
+		if (mask != 0) return i + __builtin_ctz(mask);
+		i += 16;
+	}
+#endif
+	while (i < length) {
+		unsigned char c = buffer[i];
+		if (c == '"' || c == '\\' || c < 0x20 || c >= 0x80) break;
+		i++;
+	}
+	return i;
+}
+
+// Writes the unescaped string into 'string', which has room for span->length + 1 chars.
+static void _decodeString(ParserState* state, const StringSpan* span, char* string) {
+	char* buffer = state->buffer;
+	if (span->length == span->end - span->start) {
+		memcpy(string, buffer + span->start, span->length);
+	} else {
+		ptrdiff_t j = 0;
+		ptrdiff_t k = span->start;
+		while (k < span->end) {
+			// Copy everything up to the next escape at once, the scan already validated it
+			const char* escape = memchr(buffer + k, '\\', span->end - k);
+			ptrdiff_t run = escape ? escape - (buffer + k) : span->end - k;
+			memcpy(string + j, buffer + k, run);
+			j += run;
+			k += run;
+			if (k < span->end) {
+				ptrdiff_t written;
+				k += json_utils_unescape(buffer + k, span->end - k, string + j, &written);
+				j += written;
+			}
+		}
+	}
+	string[span->length] = '\0';
+}
+
+// NOTE: On failure the node isn't owned by the stack, the caller is left to free it.
+static bool _push(ParserState* state, JsonNode* jnode) {
+	if (state->stack.count >= state->stack.max) {
+		ptrdiff_t max = state->stack.max * JSON_DYNAMIC_ARRAY_GROW_BY;
+		JsonNode** nodes = state->stack.nodes == state->stack.inlineNodes
+			? json_context_alloc(state->scratchCtx, max * sizeof(JsonNode*))
+			: json_context_realloc(state->scratchCtx, state->stack.nodes, max * sizeof(JsonNode*), state->stack.max * sizeof(JsonNode*));
+		if (!nodes) {
+			json_node_freeCtx(state->ctx, jnode);
+			return false;
+		}
+		if (state->stack.nodes == state->stack.inlineNodes) {
+			memcpy(nodes, state->stack.inlineNodes, state->stack.count * sizeof(JsonNode*));
+		}
+		state->stack.nodes = nodes;
+		state->stack.max = max;
+	}
+	state->stack.nodes[state->stack.count++] = jnode;
+	return true;
+}
+
+// Creates a container holding the children pushed since 'base', sized exactly to fit them.
+static JsonNode* _popContainer(ParserState* state, JsonType type, ptrdiff_t base, ptrdiff_t start) {
+	ptrdiff_t count = state->stack.count - base;
+	if (state->limits && count > JSON_INLINE_CHILDREN && !_charge(state, count * sizeof(JsonNode*), start)) {
+		_discard(state, base);
+		return NULL;
+	}
+	JsonNode* jnode = json_node_createCtx(state->ctx, NULL, (JsonValue){type, {0}});
+	if (!jnode || !json_node_reserveCtx(state->ctx, jnode, count)) {
+		json_node_freeCtx(state->ctx, jnode);
+		_discard(state, base);
+		return _fail(state, JSON_ERROR_OUT_OF_MEMORY, start);
+	}
+	memcpy(jnode->value.jcomplex.nodes, state->stack.nodes + base, count * sizeof(JsonNode*));
+	jnode->value.jcomplex.count = count;
+	for (ptrdiff_t i = 0; i < count; i++) {
+		jnode->value.jcomplex.nodes[i]->parent = jnode;
+	}
+	state->stack.count = base;
+	return jnode;
+}
+
+// Frees the children pushed since 'base', used when a container fails to parse.
+static void _discard(ParserState* state, ptrdiff_t base) {
+	for (ptrdiff_t i = base; i < state->stack.count; i++) {
+		json_node_freeCtx(state->ctx, state->stack.nodes[i]);
+	}
+	state->stack.count = base;
+}
+
+static bool _pushNumber(ParserState* state, JsonValue number) {
+	if (state->numbers.count >= state->numbers.max) {
+		ptrdiff_t max = state->numbers.max ? state->numbers.max * JSON_DYNAMIC_ARRAY_GROW_BY : JSON_PARSER_STACK_CAPACITY;
+		JsonPackedValue* values = state->numbers.values
+			? json_context_realloc(state->scratchCtx, state->numbers.values, max * sizeof(JsonPackedValue), state->numbers.max * sizeof(JsonPackedValue))
+			: json_context_alloc(state->scratchCtx, max * sizeof(JsonPackedValue));
+		if (!values) return false;
+		state->numbers.values = values;
+		state->numbers.max = max;
+	}
+	JsonPackedValue* packed = &state->numbers.values[state->numbers.count++];
+	if (number.type == JSON_INT) {
+		packed->integer = number.integer;
+	} else {
+		packed->real = number.real;
+	}
+	return true;
+}
+
+// Turns the numbers (of 'type') collected since 'numbersBase' into nodes on the stack, for an array that can't be
+// packed after all. The numbers are taken off their stack even on failure, the nodes pushed are left to _discard.
+static bool _unpackNumbers(ParserState* state, JsonType type, ptrdiff_t numbersBase) {
+	ptrdiff_t count = state->numbers.count;
+	state->numbers.count = numbersBase;
+	if (state->limits && !_charge(state, (count - numbersBase) * (sizeof(JsonNode) - sizeof(JsonPackedValue)), state->offset))
+		return false;
+	for (ptrdiff_t i = numbersBase; i < count; i++) {
+		JsonValue value = type == JSON_INT
+			? (JsonValue){JSON_INT, .integer = state->numbers.values[i].integer}
+			: (JsonValue){JSON_REAL, .real = state->numbers.values[i].real};
+		JsonNode* jnode = json_node_createCtx(state->ctx, NULL, value);
+		if (!jnode || !_push(state, jnode)) return false;
+	}
+	return true;
+}
+
+// Creates the array of the numbers collected since 'numbersBase', packed unless there are too few of them.
+static JsonNode* _popNumbers(ParserState* state, JsonType type, ptrdiff_t base, ptrdiff_t numbersBase, ptrdiff_t start) {
+	ptrdiff_t count = state->numbers.count - numbersBase;
+	if (count < JSON_PACK_MIN_COUNT) {
+		if (!_unpackNumbers(state, type, numbersBase)) {
+			_discard(state, base);
+			return _fail(state, JSON_ERROR_OUT_OF_MEMORY, start);
+		}
+		return _popContainer(state, JSON_ARRAY, base, start);
+	}
+	if (state->limits && !_charge(state, sizeof(JsonPackedArray), start)) {
+		state->numbers.count = numbersBase;
+		return NULL;
+	}
+	JsonNode* jnode = json_packedArrayCtx(state->ctx, type, state->numbers.values + numbersBase, count);
+	state->numbers.count = numbersBase;
+	if (!jnode)
+		return _fail(state, JSON_ERROR_OUT_OF_MEMORY, start);
+	return jnode;
+}
+
+// The limits parsing through the context has to check, NULL if it sets none.
+static const JsonLimits* _limitsOf(JsonContext* ctx) {
+	const JsonLimits* limits = &ctx->limits;
+	if (!limits->maxSize && !limits->maxDepth && !limits->maxNodes && !limits->maxStringLength && !limits->maxAllocated)
+		return NULL;
+	return limits;
+}
+
+// Fails a document of 'size' bytes over the size limit before it's parsed (or read), NULL if it isn't over it.
+static JsonNode* _overSize(JsonContext* ctx, ptrdiff_t size, JsonError* error) {
+	const JsonLimits* limits = _limitsOf(ctx);
+	if (!limits || !limits->maxSize || size <= limits->maxSize)
+		return NULL;
+	if (error) {
+		*error = (JsonError){ JSON_ERROR_LIMIT_SIZE, limits->maxSize, 0, 0 };
+	}
+	json_error_reportCtx(ctx, json_error_message(JSON_ERROR_LIMIT_SIZE));
+	return json_error_node(JSON_ERROR_LIMIT_SIZE);
+}
+
+// Counts the value starting with 'first' against the limits, before it's parsed. A container stays a level
+// deeper until _value is done with it.
+static bool _countValue(ParserState* state, char first) {
+	bool isContainer = first == '{' || first == '[';
+	if (isContainer && ++state->used.depth > state->limits->maxDepth && state->limits->maxDepth) {
+		_fail(state, JSON_ERROR_LIMIT_DEPTH, state->offset);
+		return false;
+	}
+	return _countNode(state, isContainer ? (ptrdiff_t)sizeof(JsonContainer) : (ptrdiff_t)sizeof(JsonNode), state->offset);
+}
+
+static bool _countNode(ParserState* state, ptrdiff_t bytes, ptrdiff_t offset) {
+	if (++state->used.nodes > state->limits->maxNodes && state->limits->maxNodes) {
+		_fail(state, JSON_ERROR_LIMIT_NODES, offset);
+		return false;
+	}
+	return _charge(state, bytes, offset);
+}
+
+// Checks a scanned string (or key) against the length limit, and charges for its copy unless it's left undecoded.
+// NOTE: Strings short enough to be stored in their node are taken to be, they aren't charged for.
+static bool _countString(ParserState* state, const StringSpan* span, bool isDecoded) {
+	if (span->length > state->limits->maxStringLength && state->limits->maxStringLength) {
+		_fail(state, JSON_ERROR_LIMIT_STRING, span->start - 1);
+		return false;
+	}
+	return !isDecoded || span->length + 1 <= JSON_INLINE_STRING_SIZE || _charge(state, span->length + 1, span->start - 1);
+}
+
+// Charges 'bytes' the tree is about to be allocated against the allocation limit, so going over it fails first.
+static bool _charge(ParserState* state, ptrdiff_t bytes, ptrdiff_t offset) {
+	state->used.bytes += bytes;
+	if (state->used.bytes > state->limits->maxAllocated && state->limits->maxAllocated) {
+		_fail(state, JSON_ERROR_LIMIT_ALLOCATED, offset);
+		return false;
+	}
+	return true;
+}
+
+// Moves the window on by a block, dropping the bytes before 'keep', false at the end of the file (or without one).
+static bool _refill(ParserState* state, ptrdiff_t keep) {
+	FileSource* source = state->source;
+	if (!source || state->error.code != JSON_ERROR_NONE)
+		return false;
+	ptrdiff_t blockLength = _takeBlock(source);
+	if (blockLength == 0) {
+		if (source->failed) {
+			_fail(state, JSON_ERROR_FILE, state->length);
+		}
+		return false;
+	}
+	if (state->limits && state->limits->maxSize && state->length + blockLength > state->limits->maxSize) {
+		_releaseBlock(source);
+		_fail(state, JSON_ERROR_LIMIT_SIZE, state->limits->maxSize);
+		return false;
+	}
+	ptrdiff_t kept = source->windowStart + source->windowLength - keep;
+	if (kept + blockLength > source->windowCapacity) { // Only a token longer than a block gets here
+		ptrdiff_t capacity = source->windowCapacity * JSON_DYNAMIC_ARRAY_GROW_BY;
+		capacity = capacity < kept + blockLength ? kept + blockLength : capacity;
+		char* window = json_context_realloc(source->ctx, source->window, capacity, source->windowCapacity);
+		if (!window) {
+			_releaseBlock(source);
+			_fail(state, JSON_ERROR_OUT_OF_MEMORY, keep);
+			return false;
+		}
+		source->window = window;
+		source->windowCapacity = capacity;
+	}
+	memmove(source->window, source->window + (keep - source->windowStart), kept);
+	memcpy(source->window + kept, source->blocks + (source->taken % JSON_FILE_RING_BLOCKS) * JSON_FILE_BLOCK_SIZE, blockLength);
+	_releaseBlock(source);
+	source->windowStart = keep;
+	source->windowLength = kept + blockLength;
+	state->buffer = source->window - source->windowStart;
+	state->length = source->windowStart + source->windowLength;
+	return true;
+}
+
+// Refills until the bytes up to 'end' are in the window, false if the file ends first.
+static bool _ensure(ParserState* state, ptrdiff_t end, ptrdiff_t keep) {
+	while (state->length < end && _refill(state, keep)) {}
+	return state->length >= end;
+}
+
+// The byte at 'i', or '\0' past the end of the input.
+static char _byteAt(ParserState* state, ptrdiff_t i, ptrdiff_t keep) {
+	if (i < state->length)
+		return state->buffer[i];
+	return _ensure(state, i + 1, keep) ? state->buffer[i] : '\0';
+}
+
+// Decodes the key onto the source's key stack, returning where it starts there, or -1 when out of memory.
+static ptrdiff_t _holdKey(ParserState* state, const StringSpan* key) {
+	FileSource* source = state->source;
+	ptrdiff_t at = source->keysLength;
+	if (at + key->length + 1 > source->keysMax) {
+		ptrdiff_t max = source->keysMax ? source->keysMax * JSON_DYNAMIC_ARRAY_GROW_BY : 256;
+		max = max < at + key->length + 1 ? at + key->length + 1 : max;
+		char* keys = source->keys
+			? json_context_realloc(source->ctx, source->keys, max, source->keysMax)
+			: json_context_alloc(source->ctx, max);
+		if (!keys)
+			return -1;
+		source->keys = keys;
+		source->keysMax = max;
+	}
+	_decodeString(state, key, source->keys + at);
+	source->keysLength = at + key->length + 1;
+	return at;
+}
+
+// The reader thread, it fills the free blocks of the ring until the file ends or the parser stops.
+#ifndef JSON_NO_THREADS
+static void _readFile(void* argument) {
+	FileSource* source = argument;
+	json_mutex_lock(&source->mutex);
+	while (!source->ended && !source->stopping) {
+		if (source->filled - source->taken == JSON_FILE_RING_BLOCKS) {
+			json_cond_wait(&source->changed, &source->mutex);
+			continue;
+		}
+		// The parser doesn't look at this block until 'filled' moves past it, so it's read unlocked
+		char* block = source->blocks + (source->filled % JSON_FILE_RING_BLOCKS) * JSON_FILE_BLOCK_SIZE;
+		json_mutex_unlock(&source->mutex);
+		ptrdiff_t length = (ptrdiff_t)fread(block, 1, JSON_FILE_BLOCK_SIZE, source->stream);
+		bool failed = length < JSON_FILE_BLOCK_SIZE && ferror(source->stream);
+		json_mutex_lock(&source->mutex);
+		if (length > 0) {
+			source->lengths[source->filled % JSON_FILE_RING_BLOCKS] = length;
+			source->filled++;
+		}
+		source->ended = length < JSON_FILE_BLOCK_SIZE;
+		source->failed = failed;
+		json_cond_broadcast(&source->changed);
+	}
+	json_mutex_unlock(&source->mutex);
+}
+#endif
+
+// Waits for the next block, returning its length, or 0 once the file has ended.
+static ptrdiff_t _takeBlock(FileSource* source) {
+#ifndef JSON_NO_THREADS
+	if (source->threaded) {
+		json_mutex_lock(&source->mutex);
+		while (source->filled == source->taken && !source->ended) {
+			json_cond_wait(&source->changed, &source->mutex);
+		}
+		ptrdiff_t length = source->filled > source->taken ? source->lengths[source->taken % JSON_FILE_RING_BLOCKS] : 0;
+		json_mutex_unlock(&source->mutex);
+		return length;
+	}
+#endif
+	if (source->filled == source->taken && !source->ended) { // Without a reader, the block is read right here
+		char* block = source->blocks + (source->filled % JSON_FILE_RING_BLOCKS) * JSON_FILE_BLOCK_SIZE;
+		ptrdiff_t length = (ptrdiff_t)fread(block, 1, JSON_FILE_BLOCK_SIZE, source->stream);
+		if (length > 0) {
+			source->lengths[source->filled % JSON_FILE_RING_BLOCKS] = length;
+			source->filled++;
+		}
+		source->ended = length < JSON_FILE_BLOCK_SIZE;
+		source->failed = source->ended && ferror(source->stream);
+	}
+	return source->filled > source->taken ? source->lengths[source->taken % JSON_FILE_RING_BLOCKS] : 0;
+}
+
+// Hands the block taken last back to the reader.
+static void _releaseBlock(FileSource* source) {
+#ifndef JSON_NO_THREADS
+	if (source->threaded) {
+		json_mutex_lock(&source->mutex);
+		source->taken++;
+		json_cond_broadcast(&source->changed);
+		json_mutex_unlock(&source->mutex);
+		return;
 	}
-	json_buf_unget(currentChar, buffer, length, offset);
-	string[current] = '\0';
-	return string;
+#endif
+	source->taken++;
 }
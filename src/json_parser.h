@@ -5,8 +5,87 @@
 #include <stdarg.h>
 
 #include "json_types.h"
+#include "json_error.h"
+#include "json_context.h"
+#include "json_pool.h"
+#include "json_serializer.h"
 
 JsonNode* json_parse(char* buffer, ptrdiff_t length);
 JsonNode* json_parseFile(char* path);
 
+// NOTE: On failure these return a static JSON_ERROR node, and fill in *error if it isn't NULL.
+// Every parser checks the JsonLimits of the context it parses through (see json_context_setLimits).
+JsonNode* json_parseCtx(JsonContext*, char* buffer, ptrdiff_t length, JsonError* error);
+JsonNode* json_parseFileCtx(JsonContext*, char* path, JsonError* error);
+
+// Parses without decoding reals and strings: they keep where their text is in the buffer (and whether a string
+// has escapes), and are decoded when they're first read, see json_node_decode. So what's never read costs only
+// its scan. Written out undecoded, their text is copied as is, which keeps numbers exactly as they were written.
+// NOTE: The tree uses the buffer, which has to outlive it and not be changed. Decoding writes into it (strings are
+// unescaped and terminated in place), so a lazy tree has to be frozen before it's decoded from many threads at
+// once, but equality, hashing, cloning, writing and patching read it without decoding it. Reals with a fraction or an exponent stay reals, even if they're integral
+// (json_parse makes an integer of "2.0"), and arrays of numbers that are packed are decoded while parsing.
+JsonNode* json_parseLazy(char* buffer, ptrdiff_t length);
+JsonNode* json_parseLazyCtx(JsonContext*, char* buffer, ptrdiff_t length, JsonError* error);
+
+// Parses the file while it's still being read: a reader thread fills a ring of JSON_FILE_RING_BLOCKS blocks of
+// JSON_FILE_BLOCK_SIZE bytes, and the parser works through them as they come in. Memory stays at the ring plus a
+// window of a couple of blocks (more only for a single string or number longer than a block), however big the file.
+// NOTE: Error offsets are offsets into the file, but the line and column aren't filled in.
+JsonNode* json_parseFileStreamed(char* path);
+JsonNode* json_parseFileStreamedCtx(JsonContext*, char* path, JsonError* error);
+
+// Checks that the buffer holds exactly one well-formed JSON value, without building it. Nesting is tracked with a
+// bit per level, not recursion, so any depth is checked, and only documents nested deeper than
+// JSON_VALIDATE_INLINE_DEPTH allocate (through the context). Reports the same errors json_parse would, *error is
+// filled in if it isn't NULL. Of the context's limits, the size and depth are checked.
+bool json_validate(const char* buffer, ptrdiff_t length, JsonError* error);
+bool json_validateCtx(JsonContext*, const char* buffer, ptrdiff_t length, JsonError* error);
+
+// Writes the document again in the option's layout (JSON_WRITE_PRETTY or JSON_WRITE_CONDENSED), straight from
+// the buffer to the sink without building it or recursing, in memory that doesn't grow with the document (but for
+// a bit per level of nesting beyond JSON_VALIDATE_INLINE_DEPTH, allocated through the context, whose size and depth
+// limits are checked like json_validateCtx checks them). Strings and numbers are copied as they're written
+// in the buffer, only the whitespace changes. Pretty, every level is indented by a tab and empty containers are
+// written as {} and [], unlike JSON_WRITE_PRETTY in json_toString, which indents containers in arrays twice.
+// The document is validated on the way, so on failure (false, with *error filled in if it isn't NULL) the sink may
+// have been given part of it.
+bool json_reformat(const char* buffer, ptrdiff_t length, JsonSink sink, enum JsonWriteOption option, JsonError* error);
+bool json_reformatCtx(JsonContext*, const char* buffer, ptrdiff_t length, JsonSink, enum JsonWriteOption, JsonError* error);
+
+/*
+	A JsonParser keeps its memory warm between documents, for parsing many small documents one
+	after another (e.g. request bodies). The documents it parses are allocated from its own pool and
+	belong to it, they stay valid until json_parser_reset or json_parser_destroy drops all of them at
+	once, without walking them. Its scratch stack is kept between documents too, so once it's seen the
+	largest document it'll get, parsing and resetting don't call malloc or free at all.
+
+		JsonParser* parser = json_parser_create();
+		while (...) {
+			JsonNode* request = json_parser_parse(parser, body, length, NULL);
+			...
+			json_parser_reset(parser);
+		}
+		json_parser_destroy(parser);
+
+	NOTE: Its documents are allocated through (and report errors to) parser->context, so anything
+	added to or removed from them has to go through the ...Ctx functions with that context.
+	Like a context, a parser isn't synchronized.
+*/
+typedef struct JsonParser {
+	JsonContext context; // allocates from 'pool'
+	JsonPool* pool;
+	JsonContext* owner; // allocated the parser and its scratch stack
+	JsonNode** stack;
+	ptrdiff_t stackMax;
+	JsonPackedValue* numbers; // The scratch stack of the numbers of arrays that may be packed
+	ptrdiff_t numbersMax;
+} JsonParser;
+
+JsonParser* json_parser_create(void);
+JsonParser* json_parser_createCtx(JsonContext*); // The parser uses the context's error callbacks, limits and packing
+JsonNode* json_parser_parse(JsonParser*, char* buffer, ptrdiff_t length, JsonError* error);
+void json_parser_reset(JsonParser*); // Frees every document parsed since the last reset
+void json_parser_destroy(JsonParser*);
+
 #endif // JSON4C_PARSER
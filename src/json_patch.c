@@ -0,0 +1,535 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "json_patch.h"
+#include "json_types.h"
+#include "json_utils.h"
+#include "json_error.h"
+
+typedef struct DiffState {
+	JsonContext* ctx;
+	JsonNode* ops;
+	char* path; // The JSON Pointer of the nodes being compared, not '\0' terminated
+	ptrdiff_t pathMax;
+	ptrdiff_t pathLength;
+	bool failed;
+} DiffState;
+
+// One reference token of a JSON Pointer, as written (so "~0" and "~1" are still escaped)
+typedef struct Token {
+	const char* start;
+	ptrdiff_t length;
+} Token;
+
+static void _diff(DiffState*, const JsonNode*, const JsonNode*);
+static void _diffObjects(DiffState*, const JsonNode*, const JsonNode*);
+static void _diffArrays(DiffState*, const JsonNode*, const JsonNode*);
+static bool _same(const JsonNode*, const JsonNode*);
+static void _addOp(DiffState*, const char*, const JsonNode*);
+static bool _addMember(JsonContext*, JsonNode*, const char*, JsonNode*);
+static bool _pushKey(DiffState*, const char*, ptrdiff_t);
+static bool _pushIndex(DiffState*, ptrdiff_t);
+static JsonNode* _diffMerge(JsonContext*, const JsonNode*, const JsonNode*);
+static JsonNode* _merge(JsonContext*, JsonNode*, const JsonNode*, bool*);
+static bool _applyOp(JsonContext*, JsonNode**, const JsonNode*);
+static bool _applyDecodedOp(JsonContext*, JsonNode**, const JsonNode*, const JsonNode*, const JsonNode*, const JsonNode*);
+static JsonNode* _resolve(JsonNode*, const JsonNode*);
+static JsonNode* _take(JsonNode*, const JsonNode*);
+static bool _add(JsonContext*, JsonNode**, const JsonNode*, JsonNode*);
+static bool _replace(JsonContext*, JsonNode**, const JsonNode*, JsonNode*);
+static bool _locate(JsonNode*, const JsonNode*, JsonNode**, Token*);
+static ptrdiff_t _childIndex(const JsonNode*, Token, bool);
+static ptrdiff_t _findMember(const JsonNode*, const char*, ptrdiff_t, ptrdiff_t);
+static bool _tokenEquals(Token, const char*, ptrdiff_t);
+static bool _nameAfter(JsonContext*, JsonNode*, Token);
+static const JsonNode* _member(const JsonNode*, const char*);
+
+
+JsonNode* json_diff(const JsonNode* from, const JsonNode* to) {
+	return json_diffCtx(json_context_default(), from, to);
+}
+
+JsonNode* json_diffMerge(const JsonNode* from, const JsonNode* to) {
+	return json_diffMergeCtx(json_context_default(), from, to);
+}
+
+bool json_patch_apply(JsonNode** document, const JsonNode* patch) {
+	return json_patch_applyCtx(json_context_default(), document, patch);
+}
+
+bool json_patch_applyMerge(JsonNode** document, const JsonNode* mergePatch) {
+	return json_patch_applyMergeCtx(json_context_default(), document, mergePatch);
+}
+
+JsonNode* json_diffCtx(JsonContext* ctx, const JsonNode* from, const JsonNode* to) {
+	if (!from || !to) return NULL;
+	DiffState state = {ctx, json_emptyArrayCtx(ctx), NULL, 0, 0, false};
+	if (!state.ops) return NULL;
+	_diff(&state, from, to);
+	json_context_free(ctx, state.path, state.pathMax);
+	if (state.failed) {
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_diff failed, alloc returned NULL");
+		json_node_freeCtx(ctx, state.ops);
+		return NULL;
+	}
+	return state.ops;
+}
+
+JsonNode* json_diffMergeCtx(JsonContext* ctx, const JsonNode* from, const JsonNode* to) {
+	if (!from || !to) return NULL;
+	JsonNode* patch = _diffMerge(ctx, from, to);
+	if (!patch || !json_node_setIdentifierCtx(ctx, patch, NULL, 0)) {
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_diffMerge failed, alloc returned NULL");
+		json_node_freeCtx(ctx, patch);
+		return NULL;
+	}
+	return patch;
+}
+
+bool json_patch_applyCtx(JsonContext* ctx, JsonNode** document, const JsonNode* patch) {
+	if (!document || !*document || !IS_ARRAY(patch) || IS_FROZEN(*document)) return false;
+	JsonNode scratch; // A packed patch holds only numbers, which fail as operations
+	for (ptrdiff_t i = 0; i < AS_ARRAY(patch).count; i++) {
+		if (!_applyOp(ctx, document, json_node_childAt(patch, i, &scratch))) return false;
+	}
+	return true;
+}
+
+bool json_patch_applyMergeCtx(JsonContext* ctx, JsonNode** document, const JsonNode* mergePatch) {
+	if (!document || !mergePatch || (*document && IS_FROZEN(*document))) return false;
+	bool failed = false;
+	*document = _merge(ctx, *document, mergePatch, &failed);
+	return !failed;
+}
+
+
+// Adds the operations turning 'from' into 'to' (found at state->path)
+static void _diff(DiffState* state, const JsonNode* from, const JsonNode* to) {
+	if (_same(from, to)) return;
+	if (from->value.type == JSON_OBJECT && to->value.type == JSON_OBJECT) {
+		_diffObjects(state, from, to);
+	} else if (from->value.type == JSON_ARRAY && to->value.type == JSON_ARRAY) {
+		_diffArrays(state, from, to);
+	} else {
+		_addOp(state, "replace", to);
+	}
+}
+
+static void _diffObjects(DiffState* state, const JsonNode* from, const JsonNode* to) {
+	ptrdiff_t pathLength = state->pathLength;
+	// Removals first, then the members in both, then the new ones, so no operation depends on a later one
+	for (ptrdiff_t i = 0; i < AS_OBJECT(from).count && !state->failed; i++) {
+		const JsonNode* child = AS_OBJECT(from).nodes[i];
+		if (_findMember(to, child->identifier, child->identifierLength, i) >= 0) continue;
+		if (_pushKey(state, child->identifier, child->identifierLength)) {
+			_addOp(state, "remove", NULL);
+		}
+		state->pathLength = pathLength;
+	}
+	for (ptrdiff_t i = 0; i < AS_OBJECT(to).count && !state->failed; i++) {
+		const JsonNode* child = AS_OBJECT(to).nodes[i];
+		ptrdiff_t index = _findMember(from, child->identifier, child->identifierLength, i);
+		if (index >= 0 && _pushKey(state, child->identifier, child->identifierLength)) {
+			_diff(state, AS_OBJECT(from).nodes[index], child);
+		}
+		state->pathLength = pathLength;
+	}
+	for (ptrdiff_t i = 0; i < AS_OBJECT(to).count && !state->failed; i++) {
+		const JsonNode* child = AS_OBJECT(to).nodes[i];
+		if (_findMember(from, child->identifier, child->identifierLength, i) >= 0) continue;
+		if (_pushKey(state, child->identifier, child->identifierLength)) {
+			_addOp(state, "add", child);
+		}
+		state->pathLength = pathLength;
+	}
+}
+
+// The elements both arrays start and end with are skipped, what's left in between is compared
+// pairwise, and whichever array is longer there gets the rest added or removed.
+// NOTE: Either array may be packed, so the elements are read through scratch nodes rather than unpacked.
+static void _diffArrays(DiffState* state, const JsonNode* from, const JsonNode* to) {
+	JsonNode fromScratch, toScratch;
+	ptrdiff_t fromCount = AS_ARRAY(from).count;
+	ptrdiff_t toCount = AS_ARRAY(to).count;
+	ptrdiff_t start = 0;
+	while (start < fromCount && start < toCount
+		&& _same(json_node_childAt(from, start, &fromScratch), json_node_childAt(to, start, &toScratch))) {
+		start++;
+	}
+	while (fromCount > start && toCount > start
+		&& _same(json_node_childAt(from, fromCount - 1, &fromScratch), json_node_childAt(to, toCount - 1, &toScratch))) {
+		fromCount--;
+		toCount--;
+	}
+
+	ptrdiff_t pathLength = state->pathLength;
+	ptrdiff_t paired = fromCount < toCount ? fromCount : toCount;
+	for (ptrdiff_t i = start; i < paired && !state->failed; i++) {
+		if (_pushIndex(state, i)) {
+			_diff(state, json_node_childAt(from, i, &fromScratch), json_node_childAt(to, i, &toScratch));
+		}
+		state->pathLength = pathLength;
+	}
+	// Removing from the back, so the indices of the ones still to go don't shift
+	for (ptrdiff_t i = fromCount - 1; i >= paired && !state->failed; i--) {
+		if (_pushIndex(state, i)) {
+			_addOp(state, "remove", NULL);
+		}
+		state->pathLength = pathLength;
+	}
+	for (ptrdiff_t i = paired; i < toCount && !state->failed; i++) {
+		if (_pushIndex(state, i)) {
+			_addOp(state, "add", json_node_childAt(to, i, &toScratch));
+		}
+		state->pathLength = pathLength;
+	}
+}
+
+// Whether the two are equal, by their (cached) hashes first, so an unchanged subtree costs a single comparison.
+// A match is confirmed with json_node_valueEquals, which walks the subtree only this once.
+static bool _same(const JsonNode* from, const JsonNode* to) {
+	return json_node_hash(from, JSON_HASH_ORDERED) == json_node_hash(to, JSON_HASH_ORDERED)
+		&& json_node_valueEquals(from, to);
+}
+
+// Appends {"op": op, "path": state->path, "value": a copy of 'value'} to the patch
+static void _addOp(DiffState* state, const char* op, const JsonNode* value) {
+	JsonContext* ctx = state->ctx;
+	JsonNode* jop = json_emptyObjectCtx(ctx);
+	bool ok = jop
+		&& _addMember(ctx, jop, "op", json_stringCtx(ctx, (char*)op))
+		&& _addMember(ctx, jop, "path", json_stringNCtx(ctx, state->path ? state->path : "", state->pathLength))
+		&& (!value || _addMember(ctx, jop, "value", json_node_cloneCtx(ctx, value)));
+	ptrdiff_t count = ok ? AS_ARRAY(state->ops).count : 0;
+	if (ok) {
+		json_node_appendCtx(ctx, state->ops, jop);
+	}
+	if (!ok || AS_ARRAY(state->ops).count == count) {
+		json_node_freeCtx(ctx, jop);
+		state->failed = true;
+	}
+}
+
+// Names 'child' and appends it to 'jobject', or frees it
+static bool _addMember(JsonContext* ctx, JsonNode* jobject, const char* key, JsonNode* child) {
+	if (!child) return false;
+	ptrdiff_t count = AS_OBJECT(jobject).count;
+	if (json_node_setIdentifierCtx(ctx, child, key, strlen(key))) {
+		json_node_appendCtx(ctx, jobject, child);
+	}
+	if (AS_OBJECT(jobject).count == count) {
+		json_node_freeCtx(ctx, child);
+		return false;
+	}
+	return true;
+}
+
+// Adds "/key" to the path, escaping '~' and '/' as "~0" and "~1"
+static bool _pushKey(DiffState* state, const char* key, ptrdiff_t length) {
+	bool ok = json_utils_dynAppendNCtx(state->ctx, &state->path, &state->pathMax, &state->pathLength, "/", 1);
+	ptrdiff_t start = 0;
+	for (ptrdiff_t i = 0; i < length && ok; i++) {
+		if (key[i] != '~' && key[i] != '/') continue;
+		ok = json_utils_dynAppendNCtx(state->ctx, &state->path, &state->pathMax, &state->pathLength, key + start, i - start)
+			&& json_utils_dynAppendNCtx(state->ctx, &state->path, &state->pathMax, &state->pathLength, key[i] == '~' ? "~0" : "~1", 2);
+		start = i + 1;
+	}
+	ok = ok && json_utils_dynAppendNCtx(state->ctx, &state->path, &state->pathMax, &state->pathLength, key + start, length - start);
+	state->failed |= !ok;
+	return ok;
+}
+
+static bool _pushIndex(DiffState* state, ptrdiff_t index) {
+	char digits[32];
+	int length = snprintf(digits, sizeof(digits), "/%td", index);
+	bool ok = json_utils_dynAppendNCtx(state->ctx, &state->path, &state->pathMax, &state->pathLength, digits, length);
+	state->failed |= !ok;
+	return ok;
+}
+
+
+// Returns a merge patch turning 'from' into 'to', named like 'to'
+static JsonNode* _diffMerge(JsonContext* ctx, const JsonNode* from, const JsonNode* to) {
+	if (from->value.type != JSON_OBJECT || to->value.type != JSON_OBJECT) return json_node_cloneCtx(ctx, to);
+	JsonNode* patch = json_emptyObjectCtx(ctx);
+	if (!patch || (to->identifier && !json_node_setIdentifierCtx(ctx, patch, to->identifier, to->identifierLength))) {
+		json_node_freeCtx(ctx, patch);
+		return NULL;
+	}
+	bool ok = true;
+	for (ptrdiff_t i = 0; i < AS_OBJECT(from).count && ok; i++) {
+		const JsonNode* child = AS_OBJECT(from).nodes[i];
+		if (_findMember(to, child->identifier, child->identifierLength, i) >= 0) continue;
+		JsonNode* removal = json_nullCtx(ctx);
+		ok = removal && json_node_setIdentifierCtx(ctx, removal, child->identifier, child->identifierLength);
+		if (ok) {
+			json_node_appendCtx(ctx, patch, removal);
+		} else {
+			json_node_freeCtx(ctx, removal);
+		}
+	}
+	for (ptrdiff_t i = 0; i < AS_OBJECT(to).count && ok; i++) {
+		const JsonNode* child = AS_OBJECT(to).nodes[i];
+		ptrdiff_t index = _findMember(from, child->identifier, child->identifierLength, i);
+		const JsonNode* previous = index >= 0 ? AS_OBJECT(from).nodes[index] : NULL;
+		if (previous && _same(previous, child)) continue;
+		JsonNode* change = previous ? _diffMerge(ctx, previous, child) : json_node_cloneCtx(ctx, child);
+		ok = change != NULL;
+		if (ok) {
+			json_node_appendCtx(ctx, patch, change);
+		}
+	}
+	if (!ok) {
+		json_node_freeCtx(ctx, patch);
+		return NULL;
+	}
+	return patch;
+}
+
+// RFC 7386's MergePatch(target, patch), returning the new target. 'target' may be NULL, and is consumed.
+static JsonNode* _merge(JsonContext* ctx, JsonNode* target, const JsonNode* patch, bool* failed) {
+	if (patch->value.type != JSON_OBJECT) {
+		JsonNode* copy = json_node_cloneCtx(ctx, patch);
+		*failed |= !copy;
+		json_node_freeCtx(ctx, target);
+		return copy;
+	}
+	if (!target || target->value.type != JSON_OBJECT) {
+		json_node_freeCtx(ctx, target);
+		target = json_emptyObjectCtx(ctx);
+		if (!target) {
+			*failed = true;
+			return NULL;
+		}
+	}
+	for (ptrdiff_t i = 0; i < AS_OBJECT(patch).count && !*failed; i++) {
+		const JsonNode* change = AS_OBJECT(patch).nodes[i];
+		ptrdiff_t index = _findMember(target, change->identifier, change->identifierLength, i);
+		JsonNode* previous = index >= 0 ? AS_OBJECT(target).nodes[index] : NULL;
+		if (IS_FROZEN(target)) {
+			*failed = true;
+		} else if (change->value.type == JSON_NULL) {
+			json_node_freeCtx(ctx, json_node_detach(previous));
+		} else if (IS_OBJECT(previous) && change->value.type == JSON_OBJECT) {
+			_merge(ctx, previous, change, failed); // Merged in place
+		} else {
+			JsonNode* merged = _merge(ctx, NULL, change, failed);
+			*failed |= !json_object_setNCtx(ctx, target, change->identifier, change->identifierLength, merged);
+		}
+	}
+	return target;
+}
+
+
+static bool _applyOp(JsonContext* ctx, JsonNode** document, const JsonNode* op) {
+	const JsonNode* strings[3] = { _member(op, "op"), _member(op, "path"), _member(op, "from") };
+	if (!IS_STRING(strings[0]) || !IS_STRING(strings[1]) || (strings[2] && !IS_STRING(strings[2]))) return false;
+	// A patch parsed by json_parseLazy may still have them as raw text, which is decoded into copies (so the
+	// patch itself is only read) since they're read as terminated strings
+	JsonNode* copies[3] = { NULL, NULL, NULL };
+	bool ok = true;
+	for (int i = 0; i < 3; i++) {
+		if (strings[i] && IS_UNDECODED(strings[i])) {
+			copies[i] = json_node_cloneCtx(ctx, strings[i]);
+			strings[i] = copies[i];
+			ok = ok && copies[i];
+		}
+	}
+	ok = ok && _applyDecodedOp(ctx, document, strings[0], strings[1], strings[2], _member(op, "value"));
+	for (int i = 0; i < 3; i++) {
+		json_node_freeCtx(ctx, copies[i]);
+	}
+	return ok;
+}
+
+static bool _applyDecodedOp(JsonContext* ctx, JsonNode** document,
+	const JsonNode* name, const JsonNode* path, const JsonNode* from, const JsonNode* value) {
+	if (strcmp(AS_STRING(name), "add") == 0 && value) {
+		return _add(ctx, document, path, json_node_cloneCtx(ctx, value));
+	} else if (strcmp(AS_STRING(name), "remove") == 0) {
+		JsonNode* removed = _take(*document, path);
+		json_node_freeCtx(ctx, removed);
+		return removed != NULL;
+	} else if (strcmp(AS_STRING(name), "replace") == 0 && value) {
+		if (!_resolve(*document, path)) return false;
+		return _replace(ctx, document, path, json_node_cloneCtx(ctx, value));
+	} else if (strcmp(AS_STRING(name), "move") == 0 && from) {
+		ptrdiff_t length = AS_STRING_LEN(from);
+		if (AS_STRING_LEN(path) == length && memcmp(AS_STRING(path), AS_STRING(from), length) == 0)
+			return _resolve(*document, path) != NULL;
+		// A node can't be moved into itself
+		if (AS_STRING_LEN(path) > length && memcmp(AS_STRING(path), AS_STRING(from), length) == 0 && AS_STRING(path)[length] == '/')
+			return false;
+		JsonNode* moved = _take(*document, from);
+		return moved && _add(ctx, document, path, moved);
+	} else if (strcmp(AS_STRING(name), "copy") == 0 && from) {
+		JsonNode* source = _resolve(*document, from);
+		return source && _add(ctx, document, path, json_node_cloneCtx(ctx, source));
+	} else if (strcmp(AS_STRING(name), "test") == 0 && value) {
+		JsonNode* target = _resolve(*document, path);
+		return target && json_node_valueEquals(target, value);
+	}
+	return false;
+}
+
+static JsonNode* _resolve(JsonNode* root, const JsonNode* pointer) {
+	JsonNode* parent;
+	Token last;
+	if (!_locate(root, pointer, &parent, &last)) return NULL;
+	if (!parent) return root;
+	ptrdiff_t index = _childIndex(parent, last, false);
+	return index >= 0 ? AS_COMPLEX(parent).nodes[index] : NULL;
+}
+
+// Detaches and returns the node at 'pointer', which can't be the root
+static JsonNode* _take(JsonNode* root, const JsonNode* pointer) {
+	JsonNode* parent;
+	Token last;
+	if (!_locate(root, pointer, &parent, &last) || !parent) return NULL;
+	ptrdiff_t index = _childIndex(parent, last, false);
+	return index >= 0 ? json_node_detach(AS_COMPLEX(parent).nodes[index]) : NULL;
+}
+
+// Puts 'jnode' at 'pointer', replacing what's there for objects and inserting for arrays. 'jnode' is consumed.
+static bool _add(JsonContext* ctx, JsonNode** document, const JsonNode* pointer, JsonNode* jnode) {
+	JsonNode* parent;
+	Token last;
+	if (!jnode || !_locate(*document, pointer, &parent, &last) || (parent && IS_FROZEN(parent))) {
+		json_node_freeCtx(ctx, jnode);
+		return false;
+	}
+	if (!parent || parent->value.type == JSON_OBJECT)
+		return _replace(ctx, document, pointer, jnode);
+
+	return json_array_insertCtx(ctx, parent, _childIndex(parent, last, true), jnode);
+}
+
+// Puts 'jnode' in place of the node at 'pointer'. An object member that doesn't exist yet is added. 'jnode' is consumed.
+static bool _replace(JsonContext* ctx, JsonNode** document, const JsonNode* pointer, JsonNode* jnode) {
+	JsonNode* parent;
+	Token last;
+	if (!jnode || !_locate(*document, pointer, &parent, &last) || (parent && IS_FROZEN(parent))) {
+		json_node_freeCtx(ctx, jnode);
+		return false;
+	}
+	if (!parent) { // The whole document
+		if (!json_node_setIdentifierCtx(ctx, jnode, NULL, 0)) {
+			json_node_freeCtx(ctx, jnode);
+			return false;
+		}
+		json_node_freeCtx(ctx, *document);
+		*document = jnode;
+		return true;
+	}
+
+	if (parent->value.type == JSON_ARRAY)
+		return json_array_replaceCtx(ctx, parent, _childIndex(parent, last, false), jnode);
+	if (!_nameAfter(ctx, jnode, last)) {
+		json_node_freeCtx(ctx, jnode);
+		return false;
+	}
+	return json_object_setNCtx(ctx, parent, jnode->identifier, jnode->identifierLength, jnode);
+}
+
+// Finds the container holding the node 'pointer' refers to, and the last token naming it in there.
+// The container is NULL when the pointer refers to the root.
+static bool _locate(JsonNode* root, const JsonNode* pointer, JsonNode** parent, Token* last) {
+	const char* path = AS_STRING(pointer);
+	ptrdiff_t length = AS_STRING_LEN(pointer);
+	*parent = NULL;
+	if (length == 0) return true;
+	if (path[0] != '/') return false;
+	for (ptrdiff_t i = 0; i < length; i++) {
+		if (path[i] == '~' && (i + 1 == length || (path[i + 1] != '0' && path[i + 1] != '1'))) return false;
+	}
+
+	JsonNode* jnode = root;
+	ptrdiff_t start = 1;
+	while (true) {
+		if (!json_node_unpack(jnode)) return false; // The nodes found are changed or returned
+		ptrdiff_t end = start;
+		while (end < length && path[end] != '/') {
+			end++;
+		}
+		Token token = {path + start, end - start};
+		if (end == length) {
+			*parent = jnode;
+			*last = token;
+			return json_type_isComplex(jnode->value.type);
+		}
+		ptrdiff_t index = _childIndex(jnode, token, false);
+		if (index < 0) return false;
+		jnode = AS_COMPLEX(jnode).nodes[index];
+		start = end + 1;
+	}
+}
+
+// Returns the index of the child 'token' refers to, or -1 if there's none. With 'allowEnd', an array's
+// length (written as "-" or the number) is allowed too, for inserting at the end.
+static ptrdiff_t _childIndex(const JsonNode* jnode, Token token, bool allowEnd) {
+	if (jnode->value.type == JSON_OBJECT) {
+		for (ptrdiff_t i = 0; i < AS_OBJECT(jnode).count; i++) {
+			const JsonNode* child = AS_OBJECT(jnode).nodes[i];
+			if (_tokenEquals(token, child->identifier, child->identifierLength)) return i;
+		}
+		return -1;
+	}
+	if (jnode->value.type != JSON_ARRAY || token.length == 0) return -1;
+	ptrdiff_t count = AS_ARRAY(jnode).count;
+	if (token.length == 1 && token.start[0] == '-') return allowEnd ? count : -1;
+	if (token.start[0] == '0' && token.length > 1) return -1; // No leading zeros
+	ptrdiff_t index = 0;
+	for (ptrdiff_t i = 0; i < token.length; i++) {
+		if (token.start[i] < '0' || token.start[i] > '9' || index > count) return -1;
+		index = index * 10 + (token.start[i] - '0');
+	}
+	return index < count || (allowEnd && index == count) ? index : -1;
+}
+
+// Looks up an object member by its key, trying 'hint' (where it'd be if both objects list
+// their members in the same order) first. Returns -1 if there's no such member.
+static ptrdiff_t _findMember(const JsonNode* jobject, const char* key, ptrdiff_t length, ptrdiff_t hint) {
+	ptrdiff_t count = AS_OBJECT(jobject).count;
+	for (ptrdiff_t n = 0; n < count; n++) {
+		ptrdiff_t i = (hint + n) % count;
+		const JsonNode* child = AS_OBJECT(jobject).nodes[i];
+		if (child->identifierLength == length && (length == 0 || memcmp(child->identifier, key, length) == 0)) return i;
+	}
+	return -1;
+}
+
+static bool _tokenEquals(Token token, const char* key, ptrdiff_t length) {
+	ptrdiff_t k = 0;
+	for (ptrdiff_t i = 0; i < token.length; i++, k++) {
+		char c = token.start[i];
+		if (c == '~') {
+			c = token.start[++i] == '1' ? '/' : '~';
+		}
+		if (k >= length || key[k] != c) return false;
+	}
+	return k == length;
+}
+
+// Names 'jnode' after an (escaped) token
+static bool _nameAfter(JsonContext* ctx, JsonNode* jnode, Token token) {
+	ptrdiff_t length = token.length;
+	for (ptrdiff_t i = 0; i < token.length; i++) {
+		length -= token.start[i] == '~';
+	}
+	char* identifier = json_node_allocIdentifierCtx(ctx, jnode, length);
+	if (!identifier) return false;
+	for (ptrdiff_t i = 0; i < token.length; i++) {
+		char c = token.start[i];
+		if (c == '~') {
+			c = token.start[++i] == '1' ? '/' : '~';
+		}
+		*identifier++ = c;
+	}
+	return true;
+}
+
+static const JsonNode* _member(const JsonNode* jobject, const char* key) {
+	if (!IS_OBJECT(jobject)) return NULL;
+	ptrdiff_t index = _findMember(jobject, key, strlen(key), 0);
+	return index >= 0 ? AS_OBJECT(jobject).nodes[index] : NULL;
+}
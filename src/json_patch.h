@@ -0,0 +1,49 @@
+/*
+	JSON Patch (RFC 6902) and JSON Merge Patch (RFC 7386).
+
+	json_diff describes how to turn one tree into another as a JSON Patch, an array of
+	operations like {"op":"replace","path":"/server/port","value":8080}, which
+	json_patch_apply then applies to a tree:
+
+		JsonNode* patch = json_diff(v1, v2);
+		json_patch_apply(&v1, patch); // v1 now equals v2
+
+	Subtrees are compared by their json_node_hash first, so the unchanged parts of two
+	large trees cost a single comparison each (and the hashes stay cached for the next
+	diff), a match being confirmed by json_node_valueEquals. A value changed directly has
+	to be followed by json_node_invalidate for its change to be seen. Only members and
+	elements that changed are touched, and arrays are matched by their common start and
+	end, so inserting or removing an element in the middle of an array is one operation
+	rather than a replace of everything after it.
+
+	json_diffMerge and json_patch_applyMerge do the same with a merge patch, an object
+	mirroring the target's shape where null removes a member. It's simpler to read, but
+	can't set a member to null or change only part of an array.
+
+	NOTE: Documents are patched in place, and the root itself may be replaced (a patch
+	can replace or merge over the whole document), hence the JsonNode**. When a patch
+	fails partway through (an operation doesn't apply, or a "test" doesn't match), false
+	is returned and the operations before it stay applied, so clone the document first
+	if the original has to survive a bad patch. Frozen trees can't be patched.
+*/
+
+#ifndef JSON4C_PATCH
+#define JSON4C_PATCH
+
+#include <stdbool.h>
+
+#include "json_types.h"
+#include "json_context.h"
+
+// Return a new patch (the values in it are copies), or NULL on allocation failure
+JsonNode* json_diff(const JsonNode* from, const JsonNode* to);
+JsonNode* json_diffMerge(const JsonNode* from, const JsonNode* to);
+bool json_patch_apply(JsonNode** document, const JsonNode* patch);
+bool json_patch_applyMerge(JsonNode** document, const JsonNode* mergePatch);
+
+JsonNode* json_diffCtx(JsonContext*, const JsonNode* from, const JsonNode* to);
+JsonNode* json_diffMergeCtx(JsonContext*, const JsonNode* from, const JsonNode* to);
+bool json_patch_applyCtx(JsonContext*, JsonNode** document, const JsonNode* patch);
+bool json_patch_applyMergeCtx(JsonContext*, JsonNode** document, const JsonNode* mergePatch);
+
+#endif // JSON4C_PATCH
@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_pool.h"
+
+// Sizes up to POOL_SMALL_MAX are rounded up to a multiple of POOL_SMALL_STEP,
+// bigger ones up to a power of two (until JSON_POOL_MAX_SIZE).
+#define POOL_SMALL_STEP 16
+#define POOL_SMALL_MAX 256
+
+struct JsonPoolSlab {
+	struct JsonPoolSlab* next;
+	ptrdiff_t size;
+};
+// Keeps the blocks carved after the header aligned
+#define SLAB_HEADER_SIZE ((ptrdiff_t)((sizeof(struct JsonPoolSlab) + 15) & ~(size_t)15))
+
+// Large blocks are linked together so the pool can release them, the header sits right before the block
+struct JsonPoolLarge {
+	struct JsonPoolLarge* next;
+	struct JsonPoolLarge* prev;
+};
+#define LARGE_HEADER_SIZE ((ptrdiff_t)((sizeof(struct JsonPoolLarge) + 15) & ~(size_t)15))
+
+static ptrdiff_t _sizeClass(ptrdiff_t size, ptrdiff_t* classSize);
+static void* _carve(JsonPool*, ptrdiff_t);
+static void _freeSlabs(struct JsonPoolSlab*);
+static void* _allocLarge(JsonPool*, ptrdiff_t);
+static void _freeLarge(JsonPool*, void*);
+static void* _reallocLarge(JsonPool*, void*, ptrdiff_t);
+static void _link(JsonPool*, struct JsonPoolLarge*);
+static void _unlink(JsonPool*, struct JsonPoolLarge*);
+
+
+JsonPool* json_pool_create(void) {
+	JsonPool* pool = malloc(sizeof(JsonPool));
+	if (!pool) return NULL;
+	memset(pool, 0, sizeof(JsonPool));
+	return pool;
+}
+
+void json_pool_destroy(JsonPool* pool) {
+	if (!pool) return;
+	json_pool_reset(pool);
+	_freeSlabs(pool->spareSlabs);
+	free(pool);
+}
+
+void json_pool_reset(JsonPool* pool) {
+	if (!pool) return;
+	while (pool->large) {
+		_freeLarge(pool, (char*)pool->large + LARGE_HEADER_SIZE);
+	}
+	// Every slab becomes a spare, and the newest of them is carved first
+	struct JsonPoolSlab* slab = pool->slabs;
+	while (slab) {
+		struct JsonPoolSlab* next = slab->next;
+		slab->next = pool->spareSlabs;
+		pool->spareSlabs = slab;
+		slab = next;
+	}
+	pool->slabs = NULL;
+	memset(pool->freeLists, 0, sizeof(pool->freeLists));
+	pool->cursor = NULL;
+	pool->end = NULL;
+}
+
+ptrdiff_t json_pool_reservedBytes(const JsonPool* pool) {
+	return pool->reservedBytes;
+}
+
+
+void* json_pool_alloc(ptrdiff_t size, void* instance) {
+	JsonPool* pool = instance;
+	ptrdiff_t classSize;
+	ptrdiff_t sizeClass = _sizeClass(size, &classSize);
+	if (sizeClass < 0) {
+		return _allocLarge(pool, size);
+	}
+	void* block = pool->freeLists[sizeClass];
+	if (block) {
+		pool->freeLists[sizeClass] = *(void**)block;
+		return block;
+	}
+	return _carve(pool, classSize);
+}
+
+void json_pool_free(void* ptr, ptrdiff_t size, void* instance) {
+	if (!ptr) return;
+	JsonPool* pool = instance;
+	ptrdiff_t classSize;
+	ptrdiff_t sizeClass = _sizeClass(size, &classSize);
+	if (sizeClass < 0) {
+		_freeLarge(pool, ptr);
+		return;
+	}
+	*(void**)ptr = pool->freeLists[sizeClass];
+	pool->freeLists[sizeClass] = ptr;
+}
+
+void* json_pool_realloc(void* ptr, ptrdiff_t newSize, ptrdiff_t oldSize, void* instance) {
+	if (!ptr) return json_pool_alloc(newSize, instance);
+	ptrdiff_t oldClassSize, newClassSize;
+	ptrdiff_t oldClass = _sizeClass(oldSize, &oldClassSize);
+	ptrdiff_t newClass = _sizeClass(newSize, &newClassSize);
+	if (oldClass >= 0 && oldClass == newClass) {
+		return ptr;
+	}
+	if (oldClass < 0 && newClass < 0) {
+		return _reallocLarge(instance, ptr, newSize);
+	}
+	void* newptr = json_pool_alloc(newSize, instance);
+	if (!newptr) return NULL;
+	memcpy(newptr, ptr, oldSize < newSize ? oldSize : newSize);
+	json_pool_free(ptr, oldSize, instance);
+	return newptr;
+}
+
+
+// Returns -1 for sizes that aren't pooled
+static ptrdiff_t _sizeClass(ptrdiff_t size, ptrdiff_t* classSize) {
+	if (size <= 0) size = 1;
+	if (size <= POOL_SMALL_MAX) {
+		ptrdiff_t sizeClass = (size + POOL_SMALL_STEP - 1) / POOL_SMALL_STEP - 1;
+		*classSize = (sizeClass + 1) * POOL_SMALL_STEP;
+		return sizeClass;
+	}
+	if (size > JSON_POOL_MAX_SIZE) return -1;
+	ptrdiff_t sizeClass = POOL_SMALL_MAX / POOL_SMALL_STEP;
+	ptrdiff_t current = POOL_SMALL_MAX * 2;
+	while (current < size) {
+		current *= 2;
+		sizeClass++;
+	}
+	if (sizeClass >= JSON_POOL_CLASS_COUNT) return -1;
+	*classSize = current;
+	return sizeClass;
+}
+
+static void* _carve(JsonPool* pool, ptrdiff_t size) {
+	if (pool->end - pool->cursor < size) {
+		// NOTE: the rest of the current slab is abandoned, at most one block's worth
+		struct JsonPoolSlab* slab = pool->spareSlabs;
+		if (slab && slab->size >= size + SLAB_HEADER_SIZE) {
+			pool->spareSlabs = slab->next;
+		} else {
+			ptrdiff_t slabSize = JSON_POOL_SLAB_SIZE;
+			if (slabSize < size + SLAB_HEADER_SIZE) {
+				slabSize = size + SLAB_HEADER_SIZE;
+			}
+			slab = malloc((size_t)slabSize);
+			if (!slab) return NULL;
+			slab->size = slabSize;
+			pool->reservedBytes += slabSize;
+		}
+		slab->next = pool->slabs;
+		pool->slabs = slab;
+		pool->cursor = (char*)slab + SLAB_HEADER_SIZE;
+		pool->end = (char*)slab + slab->size;
+	}
+	void* block = pool->cursor;
+	pool->cursor += size;
+	return block;
+}
+
+static void _freeSlabs(struct JsonPoolSlab* slab) {
+	while (slab) {
+		struct JsonPoolSlab* next = slab->next;
+		free(slab);
+		slab = next;
+	}
+}
+
+static void* _allocLarge(JsonPool* pool, ptrdiff_t size) {
+	struct JsonPoolLarge* block = malloc((size_t)(size + LARGE_HEADER_SIZE));
+	if (!block) return NULL;
+	_link(pool, block);
+	return (char*)block + LARGE_HEADER_SIZE;
+}
+
+static void _freeLarge(JsonPool* pool, void* ptr) {
+	struct JsonPoolLarge* block = (struct JsonPoolLarge*)((char*)ptr - LARGE_HEADER_SIZE);
+	_unlink(pool, block);
+	free(block);
+}
+
+static void* _reallocLarge(JsonPool* pool, void* ptr, ptrdiff_t newSize) {
+	struct JsonPoolLarge* block = (struct JsonPoolLarge*)((char*)ptr - LARGE_HEADER_SIZE);
+	_unlink(pool, block);
+	struct JsonPoolLarge* newBlock = realloc(block, (size_t)(newSize + LARGE_HEADER_SIZE));
+	if (!newBlock) {
+		_link(pool, block); // Left as it was
+		return NULL;
+	}
+	_link(pool, newBlock);
+	return (char*)newBlock + LARGE_HEADER_SIZE;
+}
+
+static void _link(JsonPool* pool, struct JsonPoolLarge* block) {
+	block->prev = NULL;
+	block->next = pool->large;
+	if (pool->large) {
+		pool->large->prev = block;
+	}
+	pool->large = block;
+}
+
+static void _unlink(JsonPool* pool, struct JsonPoolLarge* block) {
+	if (block->prev) {
+		block->prev->next = block->next;
+	} else {
+		pool->large = block->next;
+	}
+	if (block->next) {
+		block->next->prev = block->prev;
+	}
+}
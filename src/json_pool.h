@@ -0,0 +1,51 @@
+/*
+	A pooled allocator with per-size-class free lists. Memory is carved out of large slabs,
+	and freed blocks go onto the free list of their size class, to be handed out again by
+	the next allocation of that size. Nearly everything the library allocates (nodes, child
+	arrays and most strings) fits in a size class, so steady-state parsing, editing and freeing
+	stops going to malloc. Install it with:
+
+		JsonPool* pool = json_pool_create();
+		json_allocator_set(json_pool_alloc, json_pool_free, json_pool_realloc, pool);
+		// or json_context_setAllocator(ctx, json_pool_alloc, json_pool_free, json_pool_realloc, pool);
+
+	json_pool_reset releases every block at once while keeping the slabs for reuse, so a pool
+	can be used as an arena: allocate a document's nodes, drop them all without walking the
+	tree, and the next document is carved from the same (already touched) memory. Installed with a NULL
+	free, json_node_free doesn't even walk the tree.
+
+	NOTE: A pool isn't synchronized, so use one per context/thread. Allocations larger
+	than JSON_POOL_MAX_SIZE go straight to malloc/free, but are still released by
+	json_pool_reset and json_pool_destroy.
+*/
+
+#ifndef JSON4C_POOL
+#define JSON4C_POOL
+
+#include <stddef.h>
+
+#include "json_config.h"
+
+#define JSON_POOL_CLASS_COUNT 32
+
+typedef struct JsonPool {
+	void* freeLists[JSON_POOL_CLASS_COUNT];
+	struct JsonPoolSlab* slabs;
+	struct JsonPoolSlab* spareSlabs; // emptied by json_pool_reset, carved again before new ones are allocated
+	struct JsonPoolLarge* large; // the blocks too large for a size class
+	char* cursor; // the unused part of the newest slab
+	char* end;
+	ptrdiff_t reservedBytes;
+} JsonPool;
+
+JsonPool* json_pool_create(void);
+void json_pool_destroy(JsonPool*); // releases every slab, along with every block handed out from them
+void json_pool_reset(JsonPool*); // releases every block handed out, but keeps the slabs
+ptrdiff_t json_pool_reservedBytes(const JsonPool*); // bytes held in slabs
+
+// These match the signatures of struct Allocator, 'pool' being the JsonPool*
+void* json_pool_alloc(ptrdiff_t size, void* pool);
+void json_pool_free(void* ptr, ptrdiff_t size, void* pool);
+void* json_pool_realloc(void* ptr, ptrdiff_t newSize, ptrdiff_t oldSize, void* pool);
+
+#endif // JSON4C_POOL
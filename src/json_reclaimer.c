@@ -0,0 +1,114 @@
+#include "json_reclaimer.h"
+#include "json_types.h"
+
+#ifndef JSON_NO_THREADS
+static void _reclaim(void*);
+#endif
+
+
+JsonReclaimer* json_reclaimer_create(void) {
+	return json_reclaimer_createCtx(json_context_default());
+}
+
+JsonReclaimer* json_reclaimer_createCtx(JsonContext* ctx) {
+	JsonReclaimer* reclaimer = json_context_alloc(ctx, sizeof(JsonReclaimer));
+	if (!reclaimer) return NULL;
+	json_context_init(&reclaimer->context);
+	reclaimer->context.allocator = ctx->allocator;
+	reclaimer->owner = ctx;
+	reclaimer->queue = NULL;
+	reclaimer->pending = 0;
+	reclaimer->stopping = false;
+#ifndef JSON_NO_THREADS
+	json_mutex_init(&reclaimer->mutex);
+	json_cond_init(&reclaimer->changed);
+	reclaimer->threaded = json_thread_start(&reclaimer->thread, _reclaim, reclaimer);
+#endif
+	return reclaimer;
+}
+
+void json_node_freeDeferred(JsonReclaimer* reclaimer, JsonNode* jnode) {
+	if (!jnode || jnode->value.type == JSON_ERROR) return;
+	if (!reclaimer) { // Like a reclaimer without a thread, but through the default context
+		json_node_free(jnode);
+		return;
+	}
+#ifndef JSON_NO_THREADS
+	if (reclaimer->threaded) {
+		// A shared root's parent pointer may still be read through its other references, so only the last one is queued
+		if (IS_FROZEN(jnode)) {
+			if (json_atomic_add(&jnode->refs, -1) > 0) return;
+		}
+		json_mutex_lock(&reclaimer->mutex);
+		jnode->parent = reclaimer->queue;
+		reclaimer->queue = jnode;
+		reclaimer->pending++;
+		json_cond_broadcast(&reclaimer->changed);
+		json_mutex_unlock(&reclaimer->mutex);
+		return;
+	}
+#endif
+	json_node_freeCtx(&reclaimer->context, jnode);
+}
+
+void json_reclaimer_drain(JsonReclaimer* reclaimer) {
+#ifndef JSON_NO_THREADS
+	if (!reclaimer || !reclaimer->threaded) return;
+	json_mutex_lock(&reclaimer->mutex);
+	while (reclaimer->pending > 0) {
+		json_cond_wait(&reclaimer->changed, &reclaimer->mutex);
+	}
+	json_mutex_unlock(&reclaimer->mutex);
+#else
+	(void)reclaimer;
+#endif
+}
+
+void json_reclaimer_destroy(JsonReclaimer* reclaimer) {
+	if (!reclaimer) return;
+#ifndef JSON_NO_THREADS
+	if (reclaimer->threaded) { // The thread frees what's queued before it stops
+		json_mutex_lock(&reclaimer->mutex);
+		reclaimer->stopping = true;
+		json_cond_broadcast(&reclaimer->changed);
+		json_mutex_unlock(&reclaimer->mutex);
+		json_thread_join(&reclaimer->thread);
+	}
+	json_cond_destroy(&reclaimer->changed);
+	json_mutex_destroy(&reclaimer->mutex);
+#endif
+	json_context_free(reclaimer->owner, reclaimer, sizeof(JsonReclaimer));
+}
+
+
+#ifndef JSON_NO_THREADS
+// The reclaimer's thread, it takes the whole queue at once and frees it unlocked.
+static void _reclaim(void* argument) {
+	JsonReclaimer* reclaimer = argument;
+	json_mutex_lock(&reclaimer->mutex);
+	while (true) {
+		if (!reclaimer->queue) {
+			if (reclaimer->stopping) break;
+			json_cond_wait(&reclaimer->changed, &reclaimer->mutex);
+			continue;
+		}
+		JsonNode* queue = reclaimer->queue;
+		reclaimer->queue = NULL;
+		json_mutex_unlock(&reclaimer->mutex);
+		ptrdiff_t freed = 0;
+		while (queue) {
+			JsonNode* next = queue->parent;
+			if (IS_FROZEN(queue)) { // The link took the place of its count, nobody else has it, json_node_free drops this one
+				queue->refs = 1;
+			}
+			json_node_freeCtx(&reclaimer->context, queue);
+			queue = next;
+			freed++;
+		}
+		json_mutex_lock(&reclaimer->mutex);
+		reclaimer->pending -= freed;
+		json_cond_broadcast(&reclaimer->changed);
+	}
+	json_mutex_unlock(&reclaimer->mutex);
+}
+#endif
@@ -0,0 +1,47 @@
+/*
+	A reclaimer frees trees on a thread of its own, so a request thread done with a large tree
+	doesn't have to wait while millions of nodes are walked and freed. Handing a tree over
+	doesn't allocate, the queued roots are linked through their parent pointers.
+
+		JsonReclaimer* reclaimer = json_reclaimer_create();
+		...
+		json_node_freeDeferred(reclaimer, response); // Returns at once
+		...
+		json_reclaimer_destroy(reclaimer); // Frees whatever is still queued first
+
+	json_reclaimer_drain waits until everything handed over so far has been freed.
+
+	NOTE: The trees are freed through the context's allocator on the reclaimer's thread, while other threads
+	may be allocating through it, so it has to be thread-safe (the default one is, a JsonPool isn't). A tree
+	handed over must not be used again, and must have been detached from any container.
+	With JSON_NO_THREADS defined, json_node_freeDeferred frees the tree right away.
+*/
+
+#ifndef JSON4C_RECLAIMER
+#define JSON4C_RECLAIMER
+
+#include "json_types.h"
+#include "json_context.h"
+#include "json_thread.h"
+
+typedef struct JsonReclaimer {
+	JsonContext context; // Has the allocator of the context it was created with, but counts its own statistics
+	JsonContext* owner; // allocated the reclaimer
+	JsonNode* queue; // Linked through the roots' parent pointers
+	ptrdiff_t pending; // Queued or being freed
+	bool stopping;
+#ifndef JSON_NO_THREADS
+	bool threaded; // If the thread couldn't be started, trees are freed right away
+	JsonThread thread;
+	JsonMutex mutex;
+	JsonCond changed;
+#endif
+} JsonReclaimer;
+
+JsonReclaimer* json_reclaimer_create(void);
+JsonReclaimer* json_reclaimer_createCtx(JsonContext*);
+void json_node_freeDeferred(JsonReclaimer*, JsonNode*); // A NULL reclaimer frees the tree right away, with json_node_free
+void json_reclaimer_drain(JsonReclaimer*);
+void json_reclaimer_destroy(JsonReclaimer*);
+
+#endif // JSON4C_RECLAIMER
@@ -8,86 +8,234 @@
 #include "json_error.h"
 #include "json_config.h"
 #include "json_serializer.h"
-#include "json_allocator.h"
+#include "json_context.h"
 #include "json_utils.h"
+#include "json_thread.h"
 
-static void _serializeCondensed(JsonNode*, char**, ptrdiff_t*, ptrdiff_t*);
-static void _serializePretty(JsonNode*, char**, ptrdiff_t*, ptrdiff_t*, char*, char*);
+// Set with JSON_WRITE_CACHED for the workers of a parallel write, which mark the containers they write but don't cache them
+#define JSON_WRITE_MARK_ONLY (1 << 15)
+
+// One of the json_utils_dynAppend...EscapedCtx functions
+typedef bool (*JsonAppendEscaped)(JsonContext*, char**, ptrdiff_t*, ptrdiff_t*, const char*, ptrdiff_t);
+
+static void _serializeCondensed(JsonContext*, JsonNode*, char**, ptrdiff_t*, ptrdiff_t*, int);
+static void _serializePretty(JsonContext*, JsonNode*, char**, ptrdiff_t*, ptrdiff_t*, char*, char*, int);
+static void _serializeChildren(JsonContext*, JsonNode*, ptrdiff_t, ptrdiff_t, char**, ptrdiff_t*, ptrdiff_t*, bool, char*, int);
+static void _serializeContents(JsonContext*, JsonNode*, char**, ptrdiff_t*, ptrdiff_t*, bool, char*, int);
+static bool _appendCached(JsonContext*, JsonNode*, enum JsonWriteOption, int32_t, char**, ptrdiff_t*, ptrdiff_t*);
+static void _storeCached(JsonContext*, JsonNode*, enum JsonWriteOption, int32_t, const char*, ptrdiff_t);
+static void _markCached(JsonNode*);
+static bool _writeStream(void*, const char*, ptrdiff_t);
+static bool _appendRaw(JsonContext*, JsonNode*, char**, ptrdiff_t*, ptrdiff_t*, int);
+static bool _appendDecoded(JsonContext*, const JsonNode*, char**, ptrdiff_t*, ptrdiff_t*, JsonAppendEscaped);
+
+// An object member waiting to be written in canonical order, 'index' keeps members with the same key in order
+typedef struct CanonicalMember {
+	JsonNode* node;
+	ptrdiff_t index;
+} CanonicalMember;
+
+// The members of every object on the path being written, each object sorts its own on top of its parents'
+typedef struct CanonicalStack {
+	CanonicalMember* members;
+	ptrdiff_t max;
+	ptrdiff_t count;
+} CanonicalStack;
+
+static void _serializeCanonical(JsonContext*, JsonNode*, char**, ptrdiff_t*, ptrdiff_t*, int, CanonicalStack*);
+static bool _reserveMembers(JsonContext*, CanonicalStack*, ptrdiff_t);
+static int _compareMembers(const void*, const void*);
+
+#ifndef JSON_NO_THREADS
+// A part of a container's children, written by a worker into its own buffer
+typedef struct ParallelChunk {
+	char* buffer;
+	ptrdiff_t length;
+	ptrdiff_t offset;
+	JsonContext* ctx; // The worker's, which allocated the buffer
+} ParallelChunk;
+
+// A container whose children are being written in parallel, the workers take its chunks in turn
+typedef struct ParallelWrite {
+	JsonNode* node;
+	bool pretty;
+	char* newIndent;
+	int flags;
+	ParallelChunk* chunks;
+	ptrdiff_t chunkCount;
+	ptrdiff_t chunkSize;
+	int32_t next; // The next chunk to take
+} ParallelWrite;
+
+// NOTE: The caller's allocator isn't necessarily thread-safe, so each worker allocates through its own
+// context, which uses malloc.
+typedef struct ParallelWorker {
+	ParallelWrite* write;
+	JsonContext ctx;
+	JsonThread thread;
+} ParallelWorker;
+
+static void _serializeParallel(JsonContext*, JsonNode*, char**, ptrdiff_t*, ptrdiff_t*, bool, char*, int);
+static void _runWorker(void*);
+#endif
 
 
 bool json_write(JsonNode* node, char* buffer, ptrdiff_t length, enum JsonWriteOption option) {
+	return json_writeCtx(json_context_default(), node, buffer, length, option);
+}
+
+void json_writeFile(JsonNode* node, char* path, enum JsonWriteOption option) {
+	json_writeFileCtx(json_context_default(), node, path, option);
+}
+
+char* json_toBuffer(JsonNode* node, ptrdiff_t* length, ptrdiff_t* offset, enum JsonWriteOption option) {
+	return json_toBufferCtx(json_context_default(), node, length, offset, option);
+}
+
+char* json_toString(JsonNode* node, enum JsonWriteOption option) {
+	return json_toStringCtx(json_context_default(), node, option);
+}
+
+
+bool json_writeCtx(JsonContext* ctx, JsonNode* node, char* buffer, ptrdiff_t length, enum JsonWriteOption option) {
 	ptrdiff_t jsonLength = length;
 	ptrdiff_t jsonOffset = 0;
-	char* jsonBuffer = json_toBuffer(node, &jsonLength, &jsonOffset, option);
-	if (jsonOffset + 1 > length) {
-		json_allocator.free(jsonBuffer, jsonLength, json_allocator.context);
-		return false;
+	char* jsonBuffer = json_toBufferCtx(ctx, node, &jsonLength, &jsonOffset, option);
+	if (!jsonBuffer) return false;
+	bool fits = jsonOffset + 1 <= length;
+	if (fits) {
+		memcpy(buffer, jsonBuffer, jsonOffset + 1);
 	}
-	memcpy(buffer, jsonBuffer, jsonOffset + 1);
-	return true;
+	json_context_free(ctx, jsonBuffer, jsonLength);
+	return fits;
 }
 
-void json_writeFile(JsonNode* node, char* path, enum JsonWriteOption option) {
+void json_writeFileCtx(JsonContext* ctx, JsonNode* node, char* path, enum JsonWriteOption option) {
 	FILE* stream = fopen(path, "w");
-	char* jsonText = json_toString(node, option);
-	fputs(jsonText, stream);
+	if (!stream) {
+		json_error_reportCtx(ctx, "JSON_ERROR: fopen returned NULL, in json_writeFile");
+		return;
+	}
+	ptrdiff_t length = JSON_BUFFER_CAPACITY;
+	ptrdiff_t offset = 0;
+	char* jsonText = json_toBufferCtx(ctx, node, &length, &offset, option);
+	if (jsonText) {
+		fwrite(jsonText, 1, offset, stream);
+		json_context_free(ctx, jsonText, length);
+	}
 	fclose(stream);
 }
 
 
-char* json_toBuffer(JsonNode* node, ptrdiff_t* length, ptrdiff_t* offset, enum JsonWriteOption option) {
-	char* buffer = json_allocator.alloc(*length, json_allocator.context);
+char* json_toBufferCtx(JsonContext* ctx, JsonNode* node, ptrdiff_t* length, ptrdiff_t* offset, enum JsonWriteOption option) {
+	int flags = option & (JSON_WRITE_CACHED | JSON_WRITE_ASCII | JSON_WRITE_PARALLEL);
+	option = (enum JsonWriteOption)(option & ~flags);
+	if (option != JSON_WRITE_PRETTY && option != JSON_WRITE_CONDENSED && option != JSON_WRITE_CANONICAL) return NULL;
+	JSON_STATS_START(timer);
+	ptrdiff_t startOffset = *offset;
+	(void)startOffset; // Only read with JSON_STATS
+	char* buffer = json_context_alloc(ctx, *length);
+	if (!buffer) {
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_toBuffer failed, alloc returned NULL");
+		return NULL;
+	}
 	if (option == JSON_WRITE_PRETTY) {
-		_serializePretty(node, &buffer, length, offset, "", "");
-	} else if (option == JSON_WRITE_CONDENSED) {
-		_serializeCondensed(node, &buffer, length, offset);
+		_serializePretty(ctx, node, &buffer, length, offset, "", "", flags);
+	} else if (option == JSON_WRITE_CANONICAL) {
+		CanonicalStack stack = { NULL, 0, 0 };
+		_serializeCanonical(ctx, node, &buffer, length, offset, flags & JSON_WRITE_CACHED, &stack);
+		json_context_free(ctx, stack.members, stack.max * sizeof(CanonicalMember));
 	} else {
-		return NULL;
+		_serializeCondensed(ctx, node, &buffer, length, offset, flags);
 	}
+	JSON_STATS_ADD(ctx, bytesWritten, *offset - startOffset);
+	JSON_STATS_STOP(ctx, serializeTime, timer);
 	return buffer;
 }
 
-char* json_toString(JsonNode* node, enum JsonWriteOption option) {
+char* json_toStringCtx(JsonContext* ctx, JsonNode* node, enum JsonWriteOption option) {
 	ptrdiff_t length = JSON_BUFFER_CAPACITY;
 	ptrdiff_t offset = 0;
-	char* buffer = json_toBuffer(node, &length, &offset, option);
-	json_utils_ensureCapacity(&buffer, &length, offset);
-	buffer[offset++] = '\0';
-	return buffer;
+	char* buffer = json_toBufferCtx(ctx, node, &length, &offset, option);
+	if (!buffer) return NULL;
+	// Shrink to fit, so the string can be freed with strlen + 1 as its size
+	char* string = json_context_realloc(ctx, buffer, offset + 1, length);
+	if (!string) {
+		json_context_free(ctx, buffer, length);
+		return NULL;
+	}
+	string[offset] = '\0';
+	return string;
+}
+
+JsonSink json_sink_file(FILE* stream) {
+	return (JsonSink){ _writeStream, stream };
+}
+
+static bool _writeStream(void* stream, const char* bytes, ptrdiff_t length) {
+	return fwrite(bytes, 1, length, stream) == (size_t)length;
 }
 
 
 // TODO: functions needs some spring cleaning, and thourough testing.
 // TODO: add support for pretty printing ( ' ', '\t', and '\n')
-#define appendStr(buffer, length, offset, ...) json_utils_dynAppendStr(buffer, length, offset, __VA_ARGS__)
-static void _serializeCondensed(JsonNode* node, char** buffer, ptrdiff_t* length, ptrdiff_t* offset) {
+#define appendStr(buffer, length, offset, ...) json_utils_dynAppendStrCtx(ctx, buffer, length, offset, __VA_ARGS__)
+#define appendEscaped(buffer, length, offset, string, stringLength)											\
+	((flags & JSON_WRITE_ASCII)																					\
+		? json_utils_dynAppendAsciiEscapedCtx(ctx, buffer, length, offset, string, stringLength)				\
+		: json_utils_dynAppendEscapedCtx(ctx, buffer, length, offset, string, stringLength))
+
+// Copies an undecoded real or string (see json_parseLazy) as the text it was parsed from, so numbers keep exactly
+// the digits they were written with. Strings to be written as ASCII may have UTF-8 to escape, so they're read
+// instead, without decoding the node. False for anything else.
+static bool _appendRaw(JsonContext* ctx, JsonNode* node, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, int flags) {
+	if (!IS_UNDECODED(node)) return false;
+	bool isString = node->value.type == JSON_STRING;
+	if (isString) {
+		appendStr(buffer, length, offset, "\"");
+	}
+	if (isString && (flags & JSON_WRITE_ASCII)) {
+		_appendDecoded(ctx, node, buffer, length, offset, json_utils_dynAppendAsciiEscapedCtx);
+	} else {
+		json_utils_dynAppendNCtx(ctx, buffer, length, offset, node->value.string, node->value.stringLength);
+	}
+	if (isString) {
+		appendStr(buffer, length, offset, "\"");
+	}
+	return true;
+}
+
+// Escapes the string's value with 'append'. A string with escapes still in its text is unescaped a chunk at a time
+// (see json_node_readString), rather than decoded, which would write to the tree.
+static bool _appendDecoded
+	(JsonContext* ctx, const JsonNode* node, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, JsonAppendEscaped append) {
+	if (!(node->flags & JSON_FLAG_ESCAPED))
+		return append(ctx, buffer, length, offset, node->value.string, node->value.stringLength);
+	char chunk[JSON_DECODE_CHUNK_SIZE];
+	ptrdiff_t textOffset = 0;
+	ptrdiff_t read;
+	while ((read = json_node_readString(node, &textOffset, chunk, sizeof(chunk))) > 0) {
+		if (!append(ctx, buffer, length, offset, chunk, read)) return false;
+	}
+	return true;
+}
+
+// 'flags' are the JSON_WRITE_CACHED, JSON_WRITE_ASCII and JSON_WRITE_PARALLEL bits of the option.
+static void _serializeCondensed(JsonContext* ctx, JsonNode* node, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, int flags) {
+	bool cached = (flags & JSON_WRITE_CACHED) && json_type_isComplex(node->value.type);
+	// The ASCII bit is part of the layout, text cached without it can't be reused with it
+	enum JsonWriteOption layout = (enum JsonWriteOption)(JSON_WRITE_CONDENSED | (flags & JSON_WRITE_ASCII));
+	if (cached && _appendCached(ctx, node, layout, 0, buffer, length, offset)) return;
+	ptrdiff_t start = *offset;
 	switch (node->value.type) {
 		case JSON_OBJECT:
 			appendStr(buffer, length, offset, "{");
-			for (ptrdiff_t i = 0; i < node->value.jcomplex.count; i++) {
-				appendStr(
-					buffer, 
-					length, 
-					offset,
-					"\"",
-					node->value.jcomplex.nodes[i]->identifier,
-					"\":"
-				);
-				_serializeCondensed(node->value.jcomplex.nodes[i], buffer, length, offset);
-				if (i + 1 < node->value.jcomplex.count) {
-					appendStr(buffer, length, offset, ",");
-				}
-			}
+			_serializeContents(ctx, node, buffer, length, offset, false, "", flags);
 			appendStr(buffer, length, offset, "}");
 			break;
 		case JSON_ARRAY:
 			appendStr(buffer, length, offset, "[");
-			for (ptrdiff_t i = 0; i < node->value.jcomplex.count; i++) {
-				_serializeCondensed(node->value.jcomplex.nodes[i], buffer, length, offset);
-				if (i + 1 < node->value.jcomplex.count) {
-					appendStr(buffer, length, offset, ",");
-				}
-			}
+			_serializeContents(ctx, node, buffer, length, offset, false, "", flags);
 			appendStr(buffer, length, offset, "]");
 			break;
 		case JSON_INT: {
@@ -97,17 +245,18 @@ static void _serializeCondensed(JsonNode* node, char** buffer, ptrdiff_t* length
 			break;
 		}
 		case JSON_REAL: {
+			if (_appendRaw(ctx, node, buffer, length, offset, flags)) break;
 			char tempBuffer[25]; // 24 characters is enough to hold a %g formatted double
 			sprintf(tempBuffer, "%g", node->value.real);
 			appendStr(buffer, length, offset, tempBuffer);
 			break;
 		}
-		case JSON_STRING: {
-			char* escapedString = json_utils_toEscaped(node->value.string);
-			appendStr(buffer, length, offset, "\"", escapedString, "\"");
-			json_allocator.free(escapedString, strlen(escapedString), json_allocator.context);
+		case JSON_STRING:
+			if (_appendRaw(ctx, node, buffer, length, offset, flags)) break;
+			appendStr(buffer, length, offset, "\"");
+			appendEscaped(buffer, length, offset, node->value.string, node->value.stringLength);
+			appendStr(buffer, length, offset, "\"");
 			break;
-		}
 		case JSON_BOOL:
 			appendStr(buffer, length, offset, node->value.boolean ? "true" : "false");
 			break;
@@ -122,57 +271,50 @@ static void _serializeCondensed(JsonNode* node, char** buffer, ptrdiff_t* length
 		default: // for numbers casted to JsonType
 			break;
 	}
+	if (cached && (flags & JSON_WRITE_MARK_ONLY)) {
+		_markCached(node);
+	} else if (cached) {
+		_storeCached(ctx, node, layout, 0, *buffer + start, *offset - start);
+	}
 }
 	
 static void _serializePretty
-	(JsonNode* node, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, char* indent, char* extra) {
+	(JsonContext* ctx, JsonNode* node, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, char* indent, char* extra, int flags) {
+	bool cached = (flags & JSON_WRITE_CACHED) && json_type_isComplex(node->value.type);
+	enum JsonWriteOption layout = (enum JsonWriteOption)(JSON_WRITE_PRETTY | (flags & JSON_WRITE_ASCII));
+	int32_t depth = (int32_t)strlen(indent);
+	if (cached) { // The cached text starts after 'extra', which depends on where the container is
+		appendStr(buffer, length, offset, extra);
+		extra = "";
+		if (_appendCached(ctx, node, layout, depth, buffer, length, offset)) return;
+	}
+	ptrdiff_t start = *offset;
 	switch (node->value.type) {
 		case JSON_OBJECT: {
 			appendStr(buffer, length, offset, extra, "{", node->value.jcomplex.count > 0 ? "\n" : "");
 			// TODO: replace slow solution
-			char* newIndent = json_allocator.alloc(strlen(indent) + 2, json_allocator.context);
-			sprintf(newIndent, "\t%s", indent);
-			for (ptrdiff_t i = 0; i < node->value.jcomplex.count; i++) {
-				appendStr(
-					buffer, 
-					length, 
-					offset,
-					newIndent,
-					"\"",
-					node->value.jcomplex.nodes[i]->identifier,
-					"\": "
-				);
-				_serializePretty(
-					node->value.jcomplex.nodes[i], 
-					buffer, 
-					length, 
-					offset, 
-					newIndent,
-					""
-				);
-				if (i + 1 < node->value.jcomplex.count) {
-					appendStr(buffer, length, offset, ",");
-				}
-				appendStr(buffer, length, offset, "\n");
+			char* newIndent = json_context_alloc(ctx, strlen(indent) + 2);
+			if (!newIndent) {
+				json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_toBuffer failed, alloc returned NULL");
+				break;
 			}
-			json_allocator.free(newIndent, strlen(newIndent) + 1, json_allocator.context);
+			sprintf(newIndent, "\t%s", indent);
+			_serializeContents(ctx, node, buffer, length, offset, true, newIndent, flags);
+			json_context_free(ctx, newIndent, strlen(newIndent) + 1);
 			appendStr(buffer, length, offset, indent, "}");
 			break;
 		}
 		case JSON_ARRAY: {
 			appendStr(buffer, length, offset, extra, "[", node->value.jcomplex.count > 0 ? "\n" : "");
 			// TODO: replace slow solution
-			char* newIndent = json_allocator.alloc(strlen(indent) + 2, json_allocator.context);
-			sprintf(newIndent, "\t%s", indent);
-			for (ptrdiff_t i = 0; i < node->value.jcomplex.count; i++) {
-				appendStr(buffer, length, offset, newIndent);
-				_serializePretty(node->value.jcomplex.nodes[i], buffer, length, offset, newIndent, newIndent);
-				if (i + 1 < node->value.jcomplex.count) {
-					appendStr(buffer, length, offset, ",");
-				}
-				appendStr(buffer, length, offset, "\n");
+			char* newIndent = json_context_alloc(ctx, strlen(indent) + 2);
+			if (!newIndent) {
+				json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_toBuffer failed, alloc returned NULL");
+				break;
 			}
-			json_allocator.free(newIndent, strlen(newIndent) + 1, json_allocator.context);
+			sprintf(newIndent, "\t%s", indent);
+			_serializeContents(ctx, node, buffer, length, offset, true, newIndent, flags);
+			json_context_free(ctx, newIndent, strlen(newIndent) + 1);
 			appendStr(buffer, length, offset, indent, "]");
 			break;
 		}
@@ -183,17 +325,223 @@ static void _serializePretty
 			break;
 		}
 		case JSON_REAL: {
+			if (_appendRaw(ctx, node, buffer, length, offset, flags)) break;
 			char tempBuffer[25];
 			sprintf(tempBuffer, "%g", node->value.real);
 			appendStr(buffer, length, offset, tempBuffer);
 			break;
 		}
-		case JSON_STRING: {
-			char* escapedString = json_utils_toEscaped(node->value.string);
-			appendStr(buffer, length, offset, "\"", escapedString, "\"");
-			json_allocator.free(escapedString, strlen(escapedString), json_allocator.context);
+		case JSON_STRING:
+			if (_appendRaw(ctx, node, buffer, length, offset, flags)) break;
+			appendStr(buffer, length, offset, "\"");
+			appendEscaped(buffer, length, offset, node->value.string, node->value.stringLength);
+			appendStr(buffer, length, offset, "\"");
+			break;
+		case JSON_BOOL:
+			appendStr(buffer, length, offset, node->value.boolean ? "true" : "false");
+			break;
+		case JSON_NULL:
+			appendStr(buffer, length, offset, "null");
+			break;
+		case JSON_ERROR: 
+			appendStr(buffer, length, offset, node->identifier, node->value.string);
+			break;
+		default:
+			break;
+	}
+	if (cached && (flags & JSON_WRITE_MARK_ONLY)) {
+		_markCached(node);
+	} else if (cached) {
+		_storeCached(ctx, node, layout, depth, *buffer + start, *offset - start);
+	}
+}
+
+// Writes everything between the container's brackets, in parallel if it's asked for and the container is large.
+// 'newIndent' is the indentation of the children, when 'pretty'.
+static void _serializeContents(JsonContext* ctx, JsonNode* node, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, bool pretty, char* newIndent, int flags) {
+#ifndef JSON_NO_THREADS
+	if ((flags & JSON_WRITE_PARALLEL) && node->value.jcomplex.count >= JSON_PARALLEL_MIN_CHILDREN) {
+		_serializeParallel(ctx, node, buffer, length, offset, pretty, newIndent, flags);
+		return;
+	}
+#endif
+	_serializeChildren(ctx, node, 0, node->value.jcomplex.count, buffer, length, offset, pretty, newIndent, flags);
+}
+
+// Writes the children from 'first' up to 'last', each followed by its ',' (but the container's last child)
+// and, for JSON_WRITE_PRETTY, its newline. So the container's children written in parts and concatenated
+// are the same bytes as written at once.
+static void _serializeChildren
+	(JsonContext* ctx, JsonNode* node, ptrdiff_t first, ptrdiff_t last, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, bool pretty, char* newIndent, int flags) {
+	bool isObject = node->value.type == JSON_OBJECT;
+	JsonNode scratch;
+	for (ptrdiff_t i = first; i < last; i++) {
+		JsonNode* child = json_node_childAt(node, i, &scratch);
+		if (pretty) {
+			appendStr(buffer, length, offset, newIndent);
+		}
+		if (isObject) {
+			appendStr(buffer, length, offset, "\"");
+			appendEscaped(buffer, length, offset, child->identifier, child->identifierLength);
+			appendStr(buffer, length, offset, pretty ? "\": " : "\":");
+		}
+		if (pretty) {
+			_serializePretty(ctx, child, buffer, length, offset, newIndent, isObject ? "" : newIndent, flags);
+		} else {
+			_serializeCondensed(ctx, child, buffer, length, offset, flags);
+		}
+		if (i + 1 < node->value.jcomplex.count) {
+			appendStr(buffer, length, offset, ",");
+		}
+		if (pretty) {
+			appendStr(buffer, length, offset, "\n");
+		}
+	}
+}
+
+#ifndef JSON_NO_THREADS
+// Splits the children into chunks, which the calling thread and the workers write into buffers of their own,
+// and then appends the buffers in order. Only this container is split, its children are written serially.
+static void _serializeParallel(JsonContext* ctx, JsonNode* node, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, bool pretty, char* newIndent, int flags) {
+	ptrdiff_t count = node->value.jcomplex.count;
+	ptrdiff_t workerCount = JSON_WRITE_THREADS > 0 ? JSON_WRITE_THREADS : json_thread_processorCount();
+	// The workers don't fill the output cache, the cache would be allocated through their contexts. They still
+	// mark what they write, json_node_invalidate stops at the first container that isn't marked.
+	int workerFlags = flags & ~JSON_WRITE_PARALLEL;
+	if (workerFlags & JSON_WRITE_CACHED) {
+		workerFlags |= JSON_WRITE_MARK_ONLY;
+	}
+	ParallelWrite write = { node, pretty, newIndent, workerFlags, NULL, 0, 0, 0 };
+	write.chunkCount = workerCount * 4; // More chunks than workers, so a slow chunk doesn't hold the rest up
+	write.chunkSize = (count + write.chunkCount - 1) / write.chunkCount;
+	write.chunkCount = (count + write.chunkSize - 1) / write.chunkSize;
+	ParallelWorker* workers = NULL;
+	if (workerCount > 1) {
+		write.chunks = json_context_alloc(ctx, write.chunkCount * sizeof(ParallelChunk));
+		workers = json_context_alloc(ctx, workerCount * sizeof(ParallelWorker));
+	}
+	if (!write.chunks || !workers) {
+		json_context_free(ctx, write.chunks, write.chunkCount * sizeof(ParallelChunk));
+		json_context_free(ctx, workers, workerCount * sizeof(ParallelWorker));
+		_serializeChildren(ctx, node, 0, count, buffer, length, offset, pretty, newIndent, flags & ~JSON_WRITE_PARALLEL);
+		return;
+	}
+	memset(write.chunks, 0, write.chunkCount * sizeof(ParallelChunk));
+	for (ptrdiff_t i = 0; i < workerCount; i++) {
+		workers[i].write = &write;
+		json_context_init(&workers[i].ctx);
+	}
+	// The calling thread is worker 0, a worker that couldn't be started leaves its chunks to the others
+	ptrdiff_t running = 1;
+	while (running < workerCount && json_thread_start(&workers[running].thread, _runWorker, &workers[running])) {
+		running++;
+	}
+	_runWorker(&workers[0]);
+	for (ptrdiff_t i = 1; i < running; i++) {
+		json_thread_join(&workers[i].thread);
+	}
+	for (ptrdiff_t i = 0; i < write.chunkCount; i++) {
+		ParallelChunk* chunk = &write.chunks[i];
+		if (!chunk->buffer) {
+			json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_toBuffer failed, alloc returned NULL");
+			continue;
+		}
+		json_utils_dynAppendNCtx(ctx, buffer, length, offset, chunk->buffer, chunk->offset);
+		json_context_free(chunk->ctx, chunk->buffer, chunk->length);
+	}
+	json_context_free(ctx, write.chunks, write.chunkCount * sizeof(ParallelChunk));
+	json_context_free(ctx, workers, workerCount * sizeof(ParallelWorker));
+}
+
+static void _runWorker(void* argument) {
+	ParallelWorker* worker = argument;
+	ParallelWrite* write = worker->write;
+	JsonContext* ctx = &worker->ctx;
+	while (true) {
+		ptrdiff_t i = json_atomic_add(&write->next, 1) - 1;
+		if (i >= write->chunkCount) break;
+		ParallelChunk* chunk = &write->chunks[i];
+		ptrdiff_t first = i * write->chunkSize;
+		ptrdiff_t last = first + write->chunkSize < write->node->value.jcomplex.count
+			? first + write->chunkSize
+			: write->node->value.jcomplex.count;
+		chunk->ctx = ctx;
+		chunk->length = JSON_BUFFER_CAPACITY;
+		chunk->buffer = json_context_alloc(ctx, chunk->length);
+		if (!chunk->buffer) continue; // Reported once the chunks are put together
+		_serializeChildren(ctx, write->node, first, last, &chunk->buffer, &chunk->length, &chunk->offset, write->pretty, write->newIndent, write->flags);
+	}
+}
+#endif
+
+// NOTE: Sorting works on a copy of each object's member pointers, the tree itself isn't touched.
+static void _serializeCanonical
+	(JsonContext* ctx, JsonNode* node, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, int flags, CanonicalStack* stack) {
+	bool cached = (flags & JSON_WRITE_CACHED) && json_type_isComplex(node->value.type);
+	if (cached && _appendCached(ctx, node, JSON_WRITE_CANONICAL, 0, buffer, length, offset)) return;
+	ptrdiff_t start = *offset;
+	switch (node->value.type) {
+		case JSON_OBJECT: {
+			ptrdiff_t count = node->value.jcomplex.count;
+			ptrdiff_t base = stack->count;
+			if (!_reserveMembers(ctx, stack, base + count)) {
+				json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_toBuffer failed, alloc returned NULL");
+				return;
+			}
+			for (ptrdiff_t i = 0; i < count; i++) {
+				stack->members[base + i] = (CanonicalMember){ node->value.jcomplex.nodes[i], i };
+			}
+			stack->count += count;
+			qsort(stack->members + base, count, sizeof(CanonicalMember), _compareMembers);
+			appendStr(buffer, length, offset, "{");
+			for (ptrdiff_t i = 0; i < count; i++) {
+				JsonNode* child = stack->members[base + i].node; // Members may have moved, if a child grew the stack
+				if (i > 0) {
+					appendStr(buffer, length, offset, ",");
+				}
+				appendStr(buffer, length, offset, "\"");
+				json_utils_dynAppendMinimalEscapedCtx(ctx, buffer, length, offset, child->identifier, child->identifierLength);
+				appendStr(buffer, length, offset, "\":");
+				_serializeCanonical(ctx, child, buffer, length, offset, flags, stack);
+			}
+			appendStr(buffer, length, offset, "}");
+			stack->count = base;
+			break;
+		}
+		case JSON_ARRAY: {
+			appendStr(buffer, length, offset, "[");
+			JsonNode scratch;
+			for (ptrdiff_t i = 0; i < node->value.jcomplex.count; i++) {
+				if (i > 0) {
+					appendStr(buffer, length, offset, ",");
+				}
+				_serializeCanonical(ctx, json_node_childAt(node, i, &scratch), buffer, length, offset, flags, stack);
+			}
+			appendStr(buffer, length, offset, "]");
+			break;
+		}
+		case JSON_INT: {
+			char tempBuffer[JSON_UTILS_REAL_SIZE];
+			int64_t integer = node->value.integer;
+			if (integer >= -(INT64_C(1) << 53) && integer <= (INT64_C(1) << 53)) { // Exactly representable as a double
+				sprintf(tempBuffer, "%" PRId64, integer);
+			} else {
+				json_utils_formatReal((double)integer, tempBuffer);
+			}
+			appendStr(buffer, length, offset, tempBuffer);
+			break;
+		}
+		case JSON_REAL: {
+			char tempBuffer[JSON_UTILS_REAL_SIZE];
+			json_utils_formatReal(json_node_readReal(node), tempBuffer); // Canonical digits needn't be the parsed text's
+			appendStr(buffer, length, offset, tempBuffer);
 			break;
 		}
+		case JSON_STRING:
+			appendStr(buffer, length, offset, "\"");
+			_appendDecoded(ctx, node, buffer, length, offset, json_utils_dynAppendMinimalEscapedCtx);
+			appendStr(buffer, length, offset, "\"");
+			break;
 		case JSON_BOOL:
 			appendStr(buffer, length, offset, node->value.boolean ? "true" : "false");
 			break;
@@ -206,5 +554,87 @@ static void _serializePretty
 		default:
 			break;
 	}
+	if (cached) {
+		_storeCached(ctx, node, JSON_WRITE_CANONICAL, 0, *buffer + start, *offset - start);
+	}
 }
 #undef appendStr
+#undef appendEscaped
+
+static bool _reserveMembers(JsonContext* ctx, CanonicalStack* stack, ptrdiff_t needed) {
+	if (needed <= stack->max) return true;
+	ptrdiff_t max = stack->max > 0 ? stack->max : JSON_DYNAMIC_ARRAY_CAPACITY;
+	while (max < needed) {
+		max *= JSON_DYNAMIC_ARRAY_GROW_BY;
+	}
+	CanonicalMember* members = stack->members
+		? json_context_realloc(ctx, stack->members, max * sizeof(CanonicalMember), stack->max * sizeof(CanonicalMember))
+		: json_context_alloc(ctx, max * sizeof(CanonicalMember));
+	if (!members) return false;
+	stack->members = members;
+	stack->max = max;
+	return true;
+}
+
+// Orders keys by their UTF-16 code units, as RFC 8785 asks. That's UTF-8 byte order, except that U+E000 to U+FFFF
+// (lead bytes 0xEE and 0xEF) come after everything above U+FFFF (lead bytes 0xF0 up, surrogate pairs in UTF-16).
+// Before the first difference both keys are the same, so the differing bytes always start a character in both.
+static int _compareMembers(const void* a, const void* b) {
+	const CanonicalMember* left = a;
+	const CanonicalMember* right = b;
+	const unsigned char* leftKey = (const unsigned char*)left->node->identifier;
+	const unsigned char* rightKey = (const unsigned char*)right->node->identifier;
+	ptrdiff_t leftLength = left->node->identifierLength;
+	ptrdiff_t rightLength = right->node->identifierLength;
+	ptrdiff_t shared = leftLength < rightLength ? leftLength : rightLength;
+	for (ptrdiff_t i = 0; i < shared; i++) {
+		if (leftKey[i] == rightKey[i]) continue;
+		int leftRank = leftKey[i] == 0xEE || leftKey[i] == 0xEF ? leftKey[i] + 0x10 : leftKey[i];
+		int rightRank = rightKey[i] == 0xEE || rightKey[i] == 0xEF ? rightKey[i] + 0x10 : rightKey[i];
+		return leftRank - rightRank;
+	}
+	if (leftLength != rightLength) return leftLength < rightLength ? -1 : 1;
+	return (left->index > right->index) - (left->index < right->index);
+}
+
+// Copies the container's cached text, if it's still valid and was written the same way.
+static bool _appendCached(JsonContext* ctx, JsonNode* node, enum JsonWriteOption option, int32_t depth, char** buffer, ptrdiff_t* length, ptrdiff_t* offset) {
+	JsonOutputCache* output = AS_CONTAINER(node)->output;
+	if (!(node->flags & JSON_FLAG_SERIALIZED) || !output || output->option != option || output->depth != depth) return false;
+	return json_utils_dynAppendNCtx(ctx, buffer, length, offset, output->bytes, output->length);
+}
+
+// Marks the container as written, so changing anything in it marks its containers stale, and keeps its text
+// if it's long enough to be worth it. Every container below has been marked by the time this is called.
+// Marks a container a worker wrote, without caching its text. Text cached before can't be freed by a worker
+// either, it's kept for the next write to reuse the memory, but no longer matches any depth.
+static void _markCached(JsonNode* node) {
+	if (IS_FROZEN(node)) return;
+	node->flags |= JSON_FLAG_SERIALIZED;
+	JsonOutputCache* output = AS_CONTAINER(node)->output;
+	if (output) {
+		output->depth = -1;
+	}
+}
+
+static void _storeCached(JsonContext* ctx, JsonNode* node, enum JsonWriteOption option, int32_t depth, const char* text, ptrdiff_t textLength) {
+	if (IS_FROZEN(node)) return;
+	node->flags |= JSON_FLAG_SERIALIZED;
+	JsonOutputCache* output = AS_CONTAINER(node)->output;
+	if (output && (textLength < JSON_OUTPUT_CACHE_MIN_SIZE || output->capacity < textLength)) {
+		json_context_free(ctx, output, sizeof(JsonOutputCache) + output->capacity);
+		output = NULL;
+	}
+	if (!output && textLength >= JSON_OUTPUT_CACHE_MIN_SIZE) {
+		output = json_context_alloc(ctx, sizeof(JsonOutputCache) + textLength);
+		if (output) {
+			output->capacity = textLength;
+		}
+	}
+	AS_CONTAINER(node)->output = output;
+	if (!output) return; // Nothing's lost, it's written again next time
+	memcpy(output->bytes, text, textLength);
+	output->length = textLength;
+	output->option = (uint16_t)option;
+	output->depth = depth;
+}
@@ -4,12 +4,43 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
 
 #include "json_types.h"
 
+// Where streamed output goes, in pieces. write returns false if it couldn't take them, which stops the writing.
+typedef struct JsonSink {
+	bool (*write)(void* user, const char* bytes, ptrdiff_t length);
+	void* user;
+} JsonSink;
+
 enum JsonWriteOption {
 	JSON_WRITE_PRETTY,
-	JSON_WRITE_CONDENSED
+	JSON_WRITE_CONDENSED,
+	// RFC 8785 (JSON Canonicalization Scheme), for hashing and signing: condensed, members sorted by their keys'
+	// UTF-16 code units, numbers written like JavaScript writes them (integers beyond 2^53 as the nearest double,
+	// NaN and infinities as null) and only what JSON requires escaped. Logically equal trees are written the same.
+	// NOTE: Canonical output is always UTF-8, JSON_WRITE_ASCII doesn't apply to it.
+	JSON_WRITE_CANONICAL,
+	// Combined with either of the above, e.g. JSON_WRITE_CONDENSED | JSON_WRITE_CACHED. Every container
+	// keeps the text it was written as, and it's copied as is the next time, as long as the container
+	// hasn't changed. So writing a large document again after a small change only writes the containers
+	// along the changed path. Changes made through the library mark the cache stale on their own, after
+	// changing a value directly call json_node_invalidate. The cache costs memory (containers shorter than
+	// JSON_OUTPUT_CACHE_MIN_SIZE aren't cached), and only holds one layout, pretty or condensed, at a time.
+	// NOTE: Frozen trees may be written from many threads at once, so their cache isn't updated.
+	JSON_WRITE_CACHED = 1 << 8,
+	// Also combined with either layout. Strings are written as ASCII, with everything above U+007F escaped
+	// as \uXXXX (and a surrogate pair above U+FFFF), for consumers that can't take UTF-8. Without it,
+	// UTF-8 is written as is, which is shorter and faster.
+	JSON_WRITE_ASCII = 1 << 9,
+	// Also combined with JSON_WRITE_PRETTY or JSON_WRITE_CONDENSED. The children of containers with at least
+	// JSON_PARALLEL_MIN_CHILDREN of them are split into chunks written on JSON_WRITE_THREADS threads (one per
+	// processor by default) and put together in order, so the output is the same as without it. It's meant for
+	// large documents, e.g. a root array of many records. Only the first such container on each path is split,
+	// and containers under it aren't added to the output cache.
+	// NOTE: The workers allocate through contexts of their own, with malloc, not through the caller's allocator.
+	JSON_WRITE_PARALLEL = 1 << 10
 };
 
 bool json_write(JsonNode* jnode, char* buffer, ptrdiff_t length, enum JsonWriteOption);
@@ -25,4 +56,12 @@ void json_writeFile(JsonNode* jnode, char* path, enum JsonWriteOption);
 char* json_toBuffer(JsonNode* node, ptrdiff_t* length, ptrdiff_t* offset, enum JsonWriteOption);
 char* json_toString(JsonNode* node, enum JsonWriteOption);
 
+bool json_writeCtx(JsonContext*, JsonNode* jnode, char* buffer, ptrdiff_t length, enum JsonWriteOption);
+void json_writeFileCtx(JsonContext*, JsonNode* jnode, char* path, enum JsonWriteOption);
+char* json_toBufferCtx(JsonContext*, JsonNode* node, ptrdiff_t* length, ptrdiff_t* offset, enum JsonWriteOption);
+char* json_toStringCtx(JsonContext*, JsonNode* node, enum JsonWriteOption);
+
+// A sink that fwrites to the stream
+JsonSink json_sink_file(FILE* stream);
+
 #endif // JSON4C_SERIALIZER
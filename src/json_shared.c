@@ -0,0 +1,199 @@
+#include <stdarg.h>
+#include <string.h>
+
+#include "json_shared.h"
+#include "json_types.h"
+#include "json_error.h"
+#include "json_thread.h"
+
+#define TERMINATOR -1
+
+static JsonNode* _update(JsonContext*, JsonNode*, JsonNode*, va_list*);
+static JsonNode* _adopt(JsonContext*, JsonNode*, const char*, ptrdiff_t);
+static JsonNode* _copy(JsonContext*, JsonNode*, const char*, ptrdiff_t, ptrdiff_t, JsonNode*);
+static ptrdiff_t _find(JsonNode*, const char*, ptrdiff_t);
+
+
+JsonNode* json_shared_freeze(JsonNode* jnode) {
+	if (!jnode || jnode->value.type == JSON_ERROR || IS_FROZEN(jnode)) return jnode;
+	// A packed array would have to be unpacked by json_index, which readers on other threads can't do.
+	// If it can't be unpacked now, it stays packed and its elements can only be written or read as numbers.
+	json_node_unpack(jnode);
+	json_node_decode(jnode); // Decoding writes to the node, which readers on many threads can't do either
+	if (json_type_isComplex(jnode->value.type) && !IS_PACKED(jnode)) {
+		for (ptrdiff_t i = 0; i < AS_COMPLEX(jnode).count; i++) {
+			json_shared_freeze(AS_COMPLEX(jnode).nodes[i]);
+		}
+	}
+	// NOTE: The tree isn't shared yet, so plain writes are fine here
+	jnode->refs = 1;
+	jnode->flags |= JSON_FLAG_FROZEN;
+	return jnode;
+}
+
+JsonNode* json_shared_retain(JsonNode* jnode) {
+	if (jnode && IS_FROZEN(jnode)) {
+		json_atomic_add(&jnode->refs, 1);
+	}
+	return jnode;
+}
+
+void json_shared_release(JsonNode* jnode) {
+	json_shared_releaseCtx(json_context_default(), jnode);
+}
+
+void json_shared_releaseCtx(JsonContext* ctx, JsonNode* jnode) {
+	json_node_freeCtx(ctx, jnode); // Which only frees a frozen node once its last reference is gone
+}
+
+JsonNode* json_shared_set_impl(JsonContext* ctx, JsonNode* root, JsonNode* value, ...) {
+	if (!root || !value || !IS_FROZEN(root)) {
+		json_node_freeCtx(ctx, value);
+		return NULL;
+	}
+	va_list args;
+	va_start(args, value);
+	JsonNode* result = _update(ctx, root, value, &args);
+	va_end(args);
+	return result;
+}
+
+JsonNode* json_shared_remove_impl(JsonContext* ctx, JsonNode* root, ...) {
+	if (!root || !IS_FROZEN(root)) return NULL;
+	va_list args;
+	va_start(args, root);
+	JsonNode* result = _update(ctx, root, NULL, &args);
+	va_end(args);
+	return result;
+}
+
+
+// Returns a new version of 'jnode' with 'value' set at the rest of the path, or the path's last step removed
+// when 'value' is NULL. The value is always consumed.
+static JsonNode* _update(JsonContext* ctx, JsonNode* jnode, JsonNode* value, va_list* args) {
+	if (IS_PACKED(jnode)) { // Only left packed if freezing couldn't unpack it
+		json_node_freeCtx(ctx, value);
+		return NULL;
+	}
+	ptrdiff_t count = json_type_isComplex(jnode->value.type) ? AS_COMPLEX(jnode).count : 0;
+	ptrdiff_t index = -1;
+	char* key = NULL;
+	ptrdiff_t keyLength = 0;
+	if (jnode->value.type == JSON_OBJECT) {
+		key = va_arg(*args, char*);
+		if (key != (char*)TERMINATOR) {
+			keyLength = strlen(key);
+			index = _find(jnode, key, keyLength);
+		}
+	} else if (jnode->value.type == JSON_ARRAY) {
+		intptr_t i = va_arg(*args, intptr_t);
+		index = i >= 0 && i <= count ? i : -1;
+	}
+	if (index < 0) {
+		json_node_freeCtx(ctx, value);
+		return NULL;
+	}
+
+	va_list next;
+	va_copy(next, *args);
+	bool isLast = va_arg(next, intptr_t) == TERMINATOR;
+	va_end(next);
+
+	JsonNode* child = NULL;
+	if (isLast && value) {
+		child = _adopt(ctx, value, key, keyLength);
+		if (!child) return NULL;
+	} else if (index == count) { // Only setting the last step may add to the container
+		json_node_freeCtx(ctx, value);
+		return NULL;
+	} else if (!isLast) {
+		child = _update(ctx, AS_COMPLEX(jnode).nodes[index], value, args);
+		if (!child) return NULL;
+	}
+	return _copy(ctx, jnode, jnode->identifier, jnode->identifierLength, index, child);
+}
+
+// Freezes the value and names it 'key' (or nothing, for array elements),
+// copying it if it's already frozen under another name.
+static JsonNode* _adopt(JsonContext* ctx, JsonNode* value, const char* key, ptrdiff_t keyLength) {
+	if (!IS_FROZEN(value) && key) {
+		char* identifier = json_node_allocIdentifierCtx(ctx, value, keyLength);
+		if (!identifier) {
+			json_node_freeCtx(ctx, value);
+			return NULL;
+		}
+		memcpy(identifier, key, keyLength);
+	}
+	json_shared_freeze(value);
+	bool isNamed = key
+		? value->identifier && value->identifierLength == keyLength && memcmp(value->identifier, key, keyLength) == 0
+		: !value->identifier;
+	if (isNamed) return value;
+	JsonNode* copy = _copy(ctx, value, key, keyLength, -1, NULL);
+	json_node_freeCtx(ctx, value);
+	return copy;
+}
+
+// Makes a frozen copy of 'jnode' named 'key', sharing its children rather than copying them. The child at 'index'
+// is replaced by 'child', or removed if 'child' is NULL, and 'index' == count appends 'child'. An 'index' of -1
+// copies every child. 'child' is consumed either way.
+static JsonNode* _copy(JsonContext* ctx, JsonNode* jnode, const char* key, ptrdiff_t keyLength, ptrdiff_t index, JsonNode* child) {
+	JsonValue value = jnode->value;
+	if (value.type == JSON_STRING) {
+		value = (JsonValue){JSON_STRING, .string = NULL};
+	} else if (json_type_isComplex(value.type)) {
+		value = (JsonValue){value.type, {0}};
+	}
+	JsonNode* copy = json_node_createCtx(ctx, NULL, value);
+	bool failed = !copy;
+	if (!failed && key) {
+		char* identifier = json_node_allocIdentifierCtx(ctx, copy, keyLength);
+		failed = !identifier;
+		if (identifier) {
+			memcpy(identifier, key, keyLength);
+		}
+	}
+	if (!failed && value.type == JSON_STRING) {
+		char* string = json_node_allocStringCtx(ctx, copy, jnode->value.stringLength);
+		failed = !string;
+		if (string) {
+			memcpy(string, jnode->value.string, jnode->value.stringLength);
+		}
+	}
+	ptrdiff_t count = json_type_isComplex(value.type) ? AS_COMPLEX(jnode).count : 0;
+	if (!failed && json_type_isComplex(value.type)) {
+		failed = !json_node_reserveCtx(ctx, copy, count + (index == count));
+	}
+	if (failed) {
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_shared update failed, alloc returned NULL");
+		json_node_freeCtx(ctx, copy);
+		json_node_freeCtx(ctx, child);
+		return NULL;
+	}
+
+	// Nothing past this point can fail
+	for (ptrdiff_t i = 0; i < count; i++) {
+		if (i == index) {
+			if (child) {
+				AS_COMPLEX(copy).nodes[AS_COMPLEX(copy).count++] = child;
+			}
+			continue;
+		}
+		AS_COMPLEX(copy).nodes[AS_COMPLEX(copy).count++] = json_shared_retain(AS_COMPLEX(jnode).nodes[i]);
+	}
+	if (index == count && child) {
+		AS_COMPLEX(copy).nodes[AS_COMPLEX(copy).count++] = child;
+	}
+	return json_shared_freeze(copy);
+}
+
+static ptrdiff_t _find(JsonNode* jobject, const char* key, ptrdiff_t keyLength) {
+	ptrdiff_t i;
+	for (i = 0; i < AS_OBJECT(jobject).count; i++) {
+		JsonNode* child = AS_OBJECT(jobject).nodes[i];
+		if (child->identifierLength == keyLength && memcmp(child->identifier, key, keyLength) == 0) break;
+	}
+	return i; // The object's count if it wasn't found
+}
+
+#undef TERMINATOR
@@ -0,0 +1,48 @@
+/*
+	Frozen trees, for handing one tree to many threads and consumers. json_shared_freeze
+	turns a tree into an immutable one that any number of threads may read at once. Every
+	node in it is reference counted, so instead of copying a tree (or any subtree of it)
+	another reference is taken with json_shared_retain, and json_shared_release or
+	json_node_free drop one.
+
+	json_shared_set and json_shared_remove make a modified version of a frozen tree, copying
+	only the containers along the path, every other subtree is shared with the original
+	(which is left as it was and still has to be released). The path works like json_get's:
+
+		JsonNode* v2 = json_shared_set(v1, json_int(8080), "server", "ports", 0);
+		JsonNode* v3 = json_shared_remove(v2, "server", "debug");
+
+	Setting an object key that doesn't exist adds it, and an array index equal to the
+	array's length appends. The value handed to json_shared_set is always consumed, it's
+	frozen and owned by the new version (or freed if the update fails).
+
+	NOTE: The last release may happen on any thread, so a frozen tree needs to have been
+	allocated through a thread-safe allocator (the default one is, a JsonPool isn't).
+*/
+
+#ifndef JSON4C_SHARED
+#define JSON4C_SHARED
+
+#include <stdint.h>
+
+#include "json_types.h"
+#include "json_context.h"
+
+JsonNode* json_shared_freeze(JsonNode*); // Returns the node, now frozen, with a single reference
+JsonNode* json_shared_retain(JsonNode*); // Returns the node, for convenience
+void json_shared_release(JsonNode*);
+void json_shared_releaseCtx(JsonContext*, JsonNode*);
+
+// Return a new frozen root, or NULL if the path doesn't exist (or on allocation failure).
+#define json_shared_set(root, value, ...) \
+	json_shared_set_impl(json_context_default(), root, value, __VA_ARGS__, (intptr_t)-1)
+#define json_shared_setCtx(ctx, root, value, ...) \
+	json_shared_set_impl(ctx, root, value, __VA_ARGS__, (intptr_t)-1)
+#define json_shared_remove(root, ...) \
+	json_shared_remove_impl(json_context_default(), root, __VA_ARGS__, (intptr_t)-1)
+#define json_shared_removeCtx(ctx, root, ...) \
+	json_shared_remove_impl(ctx, root, __VA_ARGS__, (intptr_t)-1)
+JsonNode* json_shared_set_impl(JsonContext*, JsonNode* root, JsonNode* value, ...); // NOTE: call the macro wrapper instead
+JsonNode* json_shared_remove_impl(JsonContext*, JsonNode* root, ...); // NOTE: call the macro wrapper instead
+
+#endif // JSON4C_SHARED
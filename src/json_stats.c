@@ -0,0 +1,58 @@
+// clock_gettime is POSIX, not C99. The unity build defines this in json.c, before any header is included.
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <string.h>
+#include <time.h>
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "json_stats.h"
+#include "json_context.h"
+
+
+void json_stats_get(JsonStats* stats) {
+	json_stats_getCtx(json_context_default(), stats);
+}
+
+void json_stats_reset(void) {
+	json_stats_resetCtx(json_context_default());
+}
+
+void json_stats_getCtx(JsonContext* ctx, JsonStats* stats) {
+#ifdef JSON_STATS
+	*stats = ctx->stats;
+#else
+	(void)ctx;
+	memset(stats, 0, sizeof(JsonStats));
+#endif
+}
+
+// NOTE: bytesInUse is kept, since the memory it counts is still allocated.
+void json_stats_resetCtx(JsonContext* ctx) {
+#ifdef JSON_STATS
+	ptrdiff_t bytesInUse = ctx->stats.bytesInUse;
+	memset(&ctx->stats, 0, sizeof(JsonStats));
+	ctx->stats.bytesInUse = bytesInUse;
+	ctx->stats.peakBytesInUse = bytesInUse;
+#else
+	(void)ctx;
+#endif
+}
+
+// Wall time rather than clock(), which is the CPU time of the whole process: with other threads busy it runs
+// faster than the operation being timed, and it stops while the thread waits (e.g. on a streamed file).
+int64_t json_stats_now(void) {
+#if defined(_WIN32)
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (int64_t)((double)counter.QuadPart * (1e9 / (double)frequency.QuadPart));
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
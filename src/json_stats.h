@@ -0,0 +1,51 @@
+/*
+	Opt-in statistics, compile with JSON_STATS defined to enable them.
+	Without JSON_STATS nothing is counted and json_stats_get always reports zeros.
+*/
+
+#ifndef JSON4C_STATS
+#define JSON4C_STATS
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct JsonContext;
+
+typedef struct JsonStats {
+	// Allocator traffic, everything goes through json_context_alloc/free/realloc
+	ptrdiff_t allocations;
+	ptrdiff_t reallocations;
+	ptrdiff_t frees;
+	ptrdiff_t bytesAllocated; // total, including reallocations that grew a block
+	ptrdiff_t bytesInUse;
+	ptrdiff_t peakBytesInUse;
+	
+	ptrdiff_t nodesCreated[8]; // indexed by JsonType
+	ptrdiff_t bytesParsed;
+	ptrdiff_t bytesWritten;
+	
+	// Cumulative wall time in nanoseconds, measured with a monotonic clock (see json_stats_now)
+	int64_t parseTime;
+	int64_t serializeTime;
+	int64_t freeTime;
+} JsonStats;
+
+void json_stats_get(JsonStats*);
+void json_stats_reset(void);
+void json_stats_getCtx(struct JsonContext*, JsonStats*);
+void json_stats_resetCtx(struct JsonContext*);
+
+int64_t json_stats_now(void); // Nanoseconds on a monotonic clock, only differences between two readings mean anything
+
+// Used internally to record statistics, they compile to nothing without JSON_STATS
+#ifdef JSON_STATS
+#define JSON_STATS_ADD(ctx, field, amount) ((ctx)->stats.field += (amount))
+#define JSON_STATS_START(timer) int64_t timer = json_stats_now()
+#define JSON_STATS_STOP(ctx, field, timer) ((ctx)->stats.field += json_stats_now() - (timer))
+#else
+#define JSON_STATS_ADD(ctx, field, amount) ((void)0)
+#define JSON_STATS_START(timer) ((void)0)
+#define JSON_STATS_STOP(ctx, field, timer) ((void)0)
+#endif
+
+#endif // JSON4C_STATS
@@ -0,0 +1,81 @@
+#include "json_thread.h"
+
+#ifndef JSON_NO_THREADS
+#if defined(_WIN32)
+
+static DWORD WINAPI _runThread(LPVOID);
+
+
+bool json_thread_start(JsonThread* thread, void (*run)(void*), void* argument) {
+	thread->run = run;
+	thread->argument = argument;
+	thread->handle = CreateThread(NULL, 0, _runThread, thread, 0, NULL);
+	return thread->handle != NULL;
+}
+
+void json_thread_join(JsonThread* thread) {
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+}
+
+void json_mutex_init(JsonMutex* mutex) { InitializeCriticalSection(mutex); }
+void json_mutex_destroy(JsonMutex* mutex) { DeleteCriticalSection(mutex); }
+void json_mutex_lock(JsonMutex* mutex) { EnterCriticalSection(mutex); }
+void json_mutex_unlock(JsonMutex* mutex) { LeaveCriticalSection(mutex); }
+void json_cond_init(JsonCond* cond) { InitializeConditionVariable(cond); }
+void json_cond_destroy(JsonCond* cond) { (void)cond; }
+void json_cond_wait(JsonCond* cond, JsonMutex* mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+void json_cond_broadcast(JsonCond* cond) { WakeAllConditionVariable(cond); }
+
+int json_thread_processorCount(void) {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+
+static DWORD WINAPI _runThread(LPVOID argument) {
+	JsonThread* thread = argument;
+	thread->run(thread->argument);
+	return 0;
+}
+
+#else
+#include <unistd.h>
+
+static void* _runThread(void*);
+
+
+bool json_thread_start(JsonThread* thread, void (*run)(void*), void* argument) {
+	thread->run = run;
+	thread->argument = argument;
+	return pthread_create(&thread->handle, NULL, _runThread, thread) == 0;
+}
+
+void json_thread_join(JsonThread* thread) {
+	pthread_join(thread->handle, NULL);
+}
+
+void json_mutex_init(JsonMutex* mutex) { pthread_mutex_init(mutex, NULL); }
+void json_mutex_destroy(JsonMutex* mutex) { pthread_mutex_destroy(mutex); }
+void json_mutex_lock(JsonMutex* mutex) { pthread_mutex_lock(mutex); }
+void json_mutex_unlock(JsonMutex* mutex) { pthread_mutex_unlock(mutex); }
+void json_cond_init(JsonCond* cond) { pthread_cond_init(cond, NULL); }
+void json_cond_destroy(JsonCond* cond) { pthread_cond_destroy(cond); }
+void json_cond_wait(JsonCond* cond, JsonMutex* mutex) { pthread_cond_wait(cond, mutex); }
+void json_cond_broadcast(JsonCond* cond) { pthread_cond_broadcast(cond); }
+
+int json_thread_processorCount(void) {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+}
+
+
+static void* _runThread(void* argument) {
+	JsonThread* thread = argument;
+	thread->run(thread->argument);
+	return NULL;
+}
+
+#endif
+#endif // JSON_NO_THREADS
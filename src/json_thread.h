@@ -0,0 +1,66 @@
+/*
+	The few threading primitives the library needs, kept behind macros
+	so the rest of the code doesn't care which compiler it's built with.
+*/
+
+#ifndef JSON4C_THREAD
+#define JSON4C_THREAD
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Atomic operations on an int32_t (add returns the new value),
+// and relaxed loads/stores of a uint64_t
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define json_atomic_add(ptr, value) (_InterlockedExchangeAdd((volatile long*)(ptr), (value)) + (value))
+#define json_atomic_load(ptr) _InterlockedOr((volatile long*)(ptr), 0)
+#define json_atomic_store(ptr, value) ((void)_InterlockedExchange((volatile long*)(ptr), (value)))
+#define json_atomic_load64(ptr) ((uint64_t)_InterlockedOr64((volatile __int64*)(ptr), 0))
+#define json_atomic_store64(ptr, value) ((void)_InterlockedExchange64((volatile __int64*)(ptr), (__int64)(value)))
+#else
+#define json_atomic_add(ptr, value) __atomic_add_fetch((ptr), (value), __ATOMIC_ACQ_REL)
+#define json_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define json_atomic_store(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#define json_atomic_load64(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define json_atomic_store64(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELAXED)
+#endif
+
+// Threads, mutexes and condition variables, on pthreads or Win32. Define JSON_NO_THREADS for targets
+// with neither, the features built on them then do their work on the calling thread instead.
+#ifndef JSON_NO_THREADS
+#if defined(_WIN32)
+#include <windows.h>
+typedef CRITICAL_SECTION JsonMutex;
+typedef CONDITION_VARIABLE JsonCond;
+typedef struct JsonThread {
+	HANDLE handle;
+	void (*run)(void*);
+	void* argument;
+} JsonThread;
+#else
+#include <pthread.h>
+typedef pthread_mutex_t JsonMutex;
+typedef pthread_cond_t JsonCond;
+typedef struct JsonThread {
+	pthread_t handle;
+	void (*run)(void*);
+	void* argument;
+} JsonThread;
+#endif
+
+// NOTE: The JsonThread has to stay where it is until it's joined.
+bool json_thread_start(JsonThread*, void (*run)(void*), void* argument);
+void json_thread_join(JsonThread*);
+void json_mutex_init(JsonMutex*);
+void json_mutex_destroy(JsonMutex*);
+void json_mutex_lock(JsonMutex*);
+void json_mutex_unlock(JsonMutex*);
+void json_cond_init(JsonCond*);
+void json_cond_destroy(JsonCond*);
+void json_cond_wait(JsonCond*, JsonMutex*);
+void json_cond_broadcast(JsonCond*);
+int json_thread_processorCount(void); // At least 1
+#endif
+
+#endif // JSON4C_THREAD
@@ -1,12 +1,40 @@
+#include <stdlib.h>
 #include <string.h>
 
 #include "json_types.h"
 #include "json_error.h"
 #include "json_utils.h"
 #include "json_config.h"
+#include "json_thread.h"
 
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
 
-static bool _safeStringEqual(const char*, const char*);
+
+static bool _safeStringEqual(const char*, ptrdiff_t, const char*, ptrdiff_t);
+static bool _stringValueEqual(const JsonNode*, const JsonNode*);
+static void _freeNode(JsonContext*, JsonNode*);
+static bool _takeLast(JsonNode*);
+static void _freeOwn(JsonContext*, JsonNode*);
+static bool _resizeChildren(JsonContext*, JsonNode*, ptrdiff_t);
+static ptrdiff_t _nodeSize(JsonType);
+static bool _cloneContents(JsonContext*, JsonNode*, const JsonNode*);
+static uint64_t _hashContainer(const JsonNode*, enum JsonHashMode);
+static uint64_t _hashBytes(uint64_t, const char*, ptrdiff_t);
+static uint64_t _hashString(const JsonNode*);
+static uint64_t _mix(uint64_t);
+static char* _allocString(JsonContext*, JsonNode*, ptrdiff_t, uint8_t);
+static void _freeString(JsonContext*, JsonNode*, char*, ptrdiff_t, uint8_t);
+static bool _rename(JsonContext*, JsonNode*, const char*, ptrdiff_t);
+static ptrdiff_t _memberIndex(const JsonNode*, const char*, ptrdiff_t);
+static bool _insertAt(JsonContext*, JsonNode*, ptrdiff_t, JsonNode*);
+static void _replaceAt(JsonContext*, JsonNode*, ptrdiff_t, JsonNode*);
+static JsonNode* _detachAt(JsonNode*, ptrdiff_t);
+static bool _pack(JsonContext*, JsonNode*, JsonType, const void*, ptrdiff_t);
+static JsonValue _packedValue(const JsonPackedArray*, ptrdiff_t);
+static ptrdiff_t _packedSize(ptrdiff_t);
+static ptrdiff_t _unescapeInPlace(char*, ptrdiff_t);
+static bool _isEscaped(const JsonNode*);
+static ptrdiff_t _decodedLength(const JsonNode*);
 
 
 inline bool json_type_isComplex(JsonType type) {
@@ -15,48 +43,23 @@ inline bool json_type_isComplex(JsonType type) {
 
 
 JsonNode* json_node_create(char* identifier, JsonValue value) {
-	JsonNode* jnode = json_allocator.alloc(sizeof(JsonNode), json_allocator.context);
-	if (!jnode) {
-		json_error_reportCritical("JSON_ERROR: json_node_create failed, alloc returned NULL");
-		return NULL;
-	}
-	jnode->identifier = identifier;
-	jnode->value = value;
-	if (json_type_isComplex(value.type)) {
-		jnode->value.jcomplex.nodes = json_allocator.alloc(
-			sizeof(JsonNode*) * JSON_DYNAMIC_ARRAY_CAPACITY, 
-			json_allocator.context
-		);
-		if (!jnode->value.jcomplex.nodes) {
-			json_error_reportCritical("JSON_ERROR: json_node_create failed, alloc returned NULL");
-			json_node_free(jnode);
-			return NULL;
-		}
-		memset(jnode->value.jcomplex.nodes, 0, sizeof(JsonNode*) * JSON_DYNAMIC_ARRAY_CAPACITY);
-		jnode->value.jcomplex.max = JSON_DYNAMIC_ARRAY_CAPACITY;
-		jnode->value.jcomplex.count = 0;
-	}
-	return jnode;
+	return json_node_createCtx(json_context_default(), identifier, value);
 }
 
 void json_node_append(JsonNode* parent, JsonNode* child) {
-	if (!parent || !child || !json_type_isComplex(parent->value.type)) return;
-	if (parent->value.jcomplex.count >= parent->value.jcomplex.max) {
-		void* temp = json_allocator.realloc(
-			parent->value.jcomplex.nodes,
-			parent->value.jcomplex.max * sizeof(JsonNode*) * JSON_DYNAMIC_ARRAY_GROW_BY,
-			parent->value.jcomplex.max * sizeof(JsonNode*),
-			json_allocator.context
-		);
-		if (!temp) {
-			json_error_reportCritical("JSON_ERROR: json_node_append failed, realloc returned NULL");
-			return;
-		}
-		parent->value.jcomplex.nodes = temp;
-		parent->value.jcomplex.max *= JSON_DYNAMIC_ARRAY_GROW_BY;
-	}
-	parent->value.jcomplex.nodes[parent->value.jcomplex.count] = child;
-	parent->value.jcomplex.count++;
+	json_node_appendCtx(json_context_default(), parent, child);
+}
+
+bool json_node_reserve(JsonNode* jnode, ptrdiff_t capacity) {
+	return json_node_reserveCtx(json_context_default(), jnode, capacity);
+}
+
+char* json_node_allocString(JsonNode* jnode, ptrdiff_t length) {
+	return json_node_allocStringCtx(json_context_default(), jnode, length);
+}
+
+char* json_node_allocIdentifier(JsonNode* jnode, ptrdiff_t length) {
+	return json_node_allocIdentifierCtx(json_context_default(), jnode, length);
 }
 
 // NOTE: AS_COMPLEX has the same functionality as AS_OBJECT and
@@ -64,6 +67,7 @@ void json_node_append(JsonNode* parent, JsonNode* child) {
 // is going on.
 ptrdiff_t json_node_childrenCount(const JsonNode* node) {
 	if (!node || !json_type_isComplex(node->value.type)) return 0;
+	if (IS_PACKED(node)) return AS_ARRAY(node).count; // Numbers have no children
 	ptrdiff_t count = AS_COMPLEX(node).count;
 	for (ptrdiff_t i = 0; i < AS_COMPLEX(node).count; i++) {
 		count += json_node_childrenCount(AS_COMPLEX(node).nodes[i]);
@@ -72,61 +76,453 @@ ptrdiff_t json_node_childrenCount(const JsonNode* node) {
 }
 
 bool json_node_equals(const JsonNode* node1, const JsonNode* node2) {
+	if (node1 == node2) return true;
+	if (!_safeStringEqual(node1->identifier, node1->identifierLength, node2->identifier, node2->identifierLength))
+		return false;
+	return json_node_valueEquals(node1, node2);
+}
+
+bool json_node_valueEquals(const JsonNode* node1, const JsonNode* node2) {
 	// Immediate checks
 	if (node1 == node2) return true;
 	if (node1->value.type != node2->value.type) return false;
-	if (!_safeStringEqual(node1->identifier, node2->identifier)) return false;
 	
 	if (json_type_isComplex(node1->value.type)) {
 		if (AS_COMPLEX(node1).count != AS_COMPLEX(node2).count) return false;
+		// Hashes are cached, so comparing them first rejects most mismatches without walking either tree. Matching
+		// hashes are confirmed by the walk below. A change made directly has to be followed by json_node_invalidate.
+		if (json_node_hash(node1, JSON_HASH_ORDERED) != json_node_hash(node2, JSON_HASH_ORDERED)) return false;
+		JsonNode scratch1, scratch2; // Either array may be packed
 		for (ptrdiff_t i = 0; i < AS_COMPLEX(node1).count; i++) {
-			if (!json_node_equals(AS_COMPLEX(node1).nodes[i], AS_COMPLEX(node2).nodes[i]))
+			if (!json_node_equals(json_node_childAt(node1, i, &scratch1), json_node_childAt(node2, i, &scratch2)))
 				return false;
 		}
 		return true;
 	}
 	
+	// Undecoded values are read without decoding them, so comparing doesn't write to either tree
 	switch (node1->value.type) {
 		case JSON_INT:
 			return AS_INT(node1) == AS_INT(node2);
 		case JSON_REAL:
-			return AS_REAL(node1) == AS_REAL(node2);
+			return json_node_readReal(node1) == json_node_readReal(node2);
 		case JSON_BOOL:
 			return AS_BOOL(node1) == AS_BOOL(node2);
 		case JSON_STRING:
-			return _safeStringEqual(AS_STRING(node1), AS_STRING(node2));
+			return _stringValueEqual(node1, node2);
 		case JSON_NULL:
 			return true;
 		default:
-			json_error_report("JSON_ERROR: unexpected node type in 'json_node_equals'");
 			return false;
 	}
 }
 
-void json_node_free(JsonNode* jnode) {
-	if (!jnode) return;
-	if (json_type_isComplex(jnode->value.type)) {
-		ptrdiff_t i;
-		for (i = 0; i < jnode->value.jcomplex.count; i++) {
-			json_node_free(jnode->value.jcomplex.nodes[i]);
-		}
-		json_allocator.free(
-			jnode->value.jcomplex.nodes, 
-			jnode->value.jcomplex.count * sizeof(JsonNode*),
-			json_allocator.context
-		);
-	} else if (jnode->value.type == JSON_STRING) {
-		json_allocator.free(jnode->value.string, strlen(jnode->value.string), json_allocator.context);
+uint64_t json_node_hash(const JsonNode* jnode, enum JsonHashMode mode) {
+	if (!jnode || (unsigned)mode >= JSON_HASH_MODE_COUNT) return 0;
+	uint64_t hash = _mix(jnode->value.type + 1);
+	switch (jnode->value.type) {
+		case JSON_OBJECT:
+		case JSON_ARRAY:
+			return _hashContainer(jnode, mode);
+		case JSON_INT:
+			return _mix(hash ^ (uint64_t)AS_INT(jnode));
+		case JSON_REAL: {
+			double real = json_node_readReal(jnode);
+			real = real == 0.0 ? 0.0 : real; // -0.0 equals 0.0, so it must hash the same
+			uint64_t bits;
+			memcpy(&bits, &real, sizeof(bits));
+			return _mix(hash ^ bits);
+		}
+		case JSON_STRING:
+			return _mix(hash ^ _hashString(jnode));
+		case JSON_BOOL:
+			return _mix(hash ^ AS_BOOL(jnode));
+		default:
+			return hash;
 	}
-	if (jnode->identifier) {
-		json_allocator.free(jnode->identifier, strlen(jnode->identifier), json_allocator.context);		
+}
+
+// Drops the cached hashes of the node and every container above it, and marks their cached output stale
+// (it's freed when it's next written, or with the node).
+void json_node_invalidate(JsonNode* jnode) {
+	while (jnode && !IS_FROZEN(jnode)) {
+		if (json_type_isComplex(jnode->value.type)) {
+			JsonContainer* container = AS_CONTAINER(jnode);
+			// Hashing or writing a container caches (or marks) every container below it, so if this one
+			// has nothing cached, the ones above it can't either
+			bool isCached = container->hashes[JSON_HASH_ORDERED] || container->hashes[JSON_HASH_UNORDERED]
+				|| (jnode->flags & JSON_FLAG_SERIALIZED);
+			if (!isCached) break;
+			memset(container->hashes, 0, sizeof(container->hashes));
+			jnode->flags &= ~JSON_FLAG_SERIALIZED;
+		}
+		jnode = jnode->parent;
+	}
+}
+
+bool json_node_setIdentifier(JsonNode* jnode, const char* identifier, ptrdiff_t length) {
+	return json_node_setIdentifierCtx(json_context_default(), jnode, identifier, length);
+}
+
+// Removes the node from the container holding it, leaving it to the caller.
+JsonNode* json_node_detach(JsonNode* jnode) {
+	if (!jnode || IS_FROZEN(jnode) || !jnode->parent || IS_FROZEN(jnode->parent)) return NULL;
+	JsonNode* parent = jnode->parent;
+	// Searching from the back, since the node last added is the one most likely to be taken out again
+	ptrdiff_t i = AS_COMPLEX(parent).count - 1;
+	while (i >= 0 && AS_COMPLEX(parent).nodes[i] != jnode) {
+		i--;
+	}
+	return i >= 0 ? _detachAt(parent, i) : NULL;
+}
+
+JsonNode* json_packedArray(JsonType type, const void* values, ptrdiff_t count) {
+	return json_packedArrayCtx(json_context_default(), type, values, count);
+}
+
+const int64_t* json_array_asInt64s(const JsonNode* jarray) {
+	if (!IS_ARRAY(jarray) || !IS_PACKED(jarray) || AS_PACKED(jarray)->type != JSON_INT) return NULL;
+	return (const int64_t*)AS_PACKED(jarray)->values;
+}
+
+const double* json_array_asDoubles(const JsonNode* jarray) {
+	if (!IS_ARRAY(jarray) || !IS_PACKED(jarray) || AS_PACKED(jarray)->type != JSON_REAL) return NULL;
+	return (const double*)AS_PACKED(jarray)->values;
+}
+
+// Creates a node for every element, allocated through the context the array was, and drops the packed values.
+bool json_node_unpack(JsonNode* jarray) {
+	if (!jarray || !IS_PACKED(jarray)) return true;
+	if (IS_FROZEN(jarray)) return false; // Other threads may be reading it
+	JsonPackedArray* packed = AS_PACKED(jarray);
+	JsonContext* ctx = packed->ctx;
+	ptrdiff_t count = AS_ARRAY(jarray).count;
+	JsonNode** nodes = json_context_alloc(ctx, count * sizeof(JsonNode*));
+	if (!nodes) {
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_node_unpack failed, alloc returned NULL");
+		return false;
 	}
-	json_allocator.free(jnode, sizeof(JsonNode), json_allocator.context);
+	for (ptrdiff_t i = 0; i < count; i++) {
+		nodes[i] = json_node_createCtx(ctx, NULL, _packedValue(packed, i));
+		if (!nodes[i]) {
+			while (i-- > 0) {
+				json_node_freeCtx(ctx, nodes[i]);
+			}
+			json_context_free(ctx, nodes, count * sizeof(JsonNode*));
+			return false;
+		}
+		nodes[i]->parent = jarray;
+	}
+	jarray->flags &= ~JSON_FLAG_PACKED;
+	AS_ARRAY(jarray).nodes = nodes;
+	AS_ARRAY(jarray).max = count;
+	json_context_free(ctx, packed, _packedSize(count));
+	return true;
+}
+
+JsonNode* json_node_childAt(const JsonNode* jnode, ptrdiff_t index, JsonNode* scratch) {
+	if (!jnode || !json_type_isComplex(jnode->value.type) || index < 0 || index >= AS_COMPLEX(jnode).count)
+		return NULL;
+	if (!IS_PACKED(jnode)) return AS_COMPLEX(jnode).nodes[index];
+	scratch->identifier = NULL;
+	scratch->identifierLength = 0;
+	scratch->value = _packedValue(AS_PACKED(jnode), index);
+	scratch->parent = NULL;
+	scratch->flags = 0;
+	return scratch;
+}
+
+// Reals are read with strtod, like the parser does. Strings are unescaped where they are, which only ever
+// shortens them, and terminated, the '\0' taking the place of the closing quote (or of what unescaping freed up).
+void json_node_decode(JsonNode* jnode) {
+	if (!jnode || !IS_UNDECODED(jnode)) return;
+	char* text = jnode->value.string;
+	ptrdiff_t length = jnode->value.stringLength;
+	if (jnode->value.type == JSON_REAL) {
+		jnode->value.real = json_node_readReal(jnode);
+		jnode->flags &= ~(JSON_FLAG_RAW | JSON_FLAG_UNDECODED);
+		return;
+	}
+	if (jnode->flags & JSON_FLAG_ESCAPED) {
+		length = _unescapeInPlace(text, length);
+	}
+	text[length] = '\0';
+	jnode->value.stringLength = length;
+	jnode->flags &= ~(JSON_FLAG_UNDECODED | JSON_FLAG_ESCAPED); // Still raw, the string is in the buffer
+}
+
+double json_node_readReal(const JsonNode* jnode) {
+	if (IS_INT(jnode)) return (double)AS_INT(jnode);
+	if (!IS_REAL(jnode)) return 0.0;
+	if (!IS_UNDECODED(jnode)) return AS_REAL(jnode);
+	char number[JSON_RAW_REAL_SIZE]; // The buffer isn't necessarily terminated after the number
+	memcpy(number, jnode->value.string, jnode->value.stringLength);
+	number[jnode->value.stringLength] = '\0';
+	return strtod(number, NULL);
+}
+
+// Escapes are unescaped into 'unit' first, and only taken if what they decode to fits.
+ptrdiff_t json_node_readString(const JsonNode* jnode, ptrdiff_t* offset, char* out, ptrdiff_t size) {
+	if (!IS_STRING(jnode) || !offset) return 0;
+	const char* text = jnode->value.string;
+	ptrdiff_t length = jnode->value.stringLength;
+	bool escaped = _isEscaped(jnode);
+	ptrdiff_t written = 0;
+	while (*offset < length && written < size) {
+		if (escaped && text[*offset] == '\\') {
+			char unit[4];
+			ptrdiff_t unitLength;
+			ptrdiff_t used = json_utils_unescape(text + *offset, length - *offset, unit, &unitLength); // The parser validated it
+			if (unitLength > size - written) break;
+			memcpy(out + written, unit, unitLength);
+			written += unitLength;
+			*offset += used;
+			continue;
+		}
+		const char* escape = escaped ? memchr(text + *offset, '\\', length - *offset) : NULL;
+		ptrdiff_t run = (escape ? escape - text : length) - *offset;
+		if (run > size - written) { // Cut before a character rather than in the middle of one
+			run = size - written;
+			while (run > 0 && ((unsigned char)text[*offset + run] & 0xC0) == 0x80) {
+				run--;
+			}
+			if (run == 0) break;
+		}
+		memcpy(out + written, text + *offset, run);
+		written += run;
+		*offset += run;
+	}
+	return written;
+}
+
+double json_node_real(JsonNode* jnode) {
+	json_node_decode(jnode);
+	if (IS_REAL(jnode)) return AS_REAL(jnode);
+	return IS_INT(jnode) ? (double)AS_INT(jnode) : 0.0;
+}
+
+const char* json_node_string(JsonNode* jnode) {
+	json_node_decode(jnode);
+	return IS_STRING(jnode) ? AS_STRING(jnode) : NULL;
+}
+
+ptrdiff_t json_node_stringLength(JsonNode* jnode) {
+	json_node_decode(jnode);
+	return IS_STRING(jnode) ? AS_STRING_LEN(jnode) : 0;
+}
+
+JsonNode* json_node_clone(const JsonNode* jnode) {
+	return json_node_cloneCtx(json_context_default(), jnode);
+}
+
+void json_node_free(JsonNode* jnode) {
+	json_node_freeCtx(json_context_default(), jnode);
 }
 
 
 JsonNode* json_object_impl(void** ptrs) {
-	JsonNode* jobject = json_node_create(NULL, (JsonValue){JSON_OBJECT, {0}});
+	return json_objectCtx_impl(json_context_default(), ptrs);
+}
+
+JsonNode* json_array_impl(JsonNode** jnodes) {
+	return json_arrayCtx_impl(json_context_default(), jnodes);
+}
+
+bool json_object_set(JsonNode* jobject, const char* key, JsonNode* value) {
+	return json_object_setCtx(json_context_default(), jobject, key, value);
+}
+
+bool json_object_setN(JsonNode* jobject, const char* key, ptrdiff_t length, JsonNode* value) {
+	return json_object_setNCtx(json_context_default(), jobject, key, length, value);
+}
+
+bool json_object_remove(JsonNode* jobject, const char* key) {
+	return json_object_removeCtx(json_context_default(), jobject, key);
+}
+
+bool json_array_insert(JsonNode* jarray, ptrdiff_t index, JsonNode* value) {
+	return json_array_insertCtx(json_context_default(), jarray, index, value);
+}
+
+bool json_array_remove(JsonNode* jarray, ptrdiff_t index) {
+	return json_array_removeCtx(json_context_default(), jarray, index);
+}
+
+bool json_array_replace(JsonNode* jarray, ptrdiff_t index, JsonNode* value) {
+	return json_array_replaceCtx(json_context_default(), jarray, index, value);
+}
+
+inline JsonNode* json_bool(bool boolean) {
+	return json_boolCtx(json_context_default(), boolean);
+}
+
+inline JsonNode* json_int(int64_t integer) {
+	return json_intCtx(json_context_default(), integer);
+}
+
+inline JsonNode* json_real(double real) {
+	return json_realCtx(json_context_default(), real);
+}
+
+inline JsonNode* json_null(void) {
+	return json_nullCtx(json_context_default());
+}
+
+inline JsonNode* json_string(char* string) {
+	return json_stringCtx(json_context_default(), string);
+}
+
+inline JsonNode* json_stringN(const char* string, ptrdiff_t length) {
+	return json_stringNCtx(json_context_default(), string, length);
+}
+
+
+JsonNode* json_node_createCtx(JsonContext* ctx, char* identifier, JsonValue value) {
+	JsonNode* jnode = json_context_alloc(ctx, _nodeSize(value.type));
+	if (!jnode) {
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_node_create failed, alloc returned NULL");
+		return NULL;
+	}
+	JSON_STATS_ADD(ctx, nodesCreated[value.type], 1);
+	// NOTE: Strings handed in without a length are taken to be '\0' terminated
+	jnode->identifier = identifier;
+	jnode->identifierLength = identifier ? (uint32_t)strlen(identifier) : 0;
+	jnode->value = value;
+	jnode->parent = NULL;
+	jnode->flags = 0;
+	if (value.type == JSON_STRING && value.string && value.stringLength == 0) {
+		jnode->value.stringLength = strlen(value.string);
+	}
+	if (json_type_isComplex(value.type)) {
+		// The first few children are stored with the node, a separate array is only allocated once they outgrow it
+		jnode->value.jcomplex.nodes = AS_CONTAINER(jnode)->inlineNodes;
+		memset(AS_CONTAINER(jnode)->hashes, 0, sizeof(AS_CONTAINER(jnode)->hashes));
+		AS_CONTAINER(jnode)->output = NULL;
+		jnode->value.jcomplex.max = JSON_INLINE_CHILDREN;
+		jnode->value.jcomplex.count = 0;
+	}
+	return jnode;
+}
+
+void json_node_appendCtx(JsonContext* ctx, JsonNode* parent, JsonNode* child) {
+	if (!parent || !child || !json_type_isComplex(parent->value.type) || IS_FROZEN(parent)) return;
+	if (!json_node_unpack(parent)) return;
+	if (parent->value.jcomplex.count >= parent->value.jcomplex.max) {
+		ptrdiff_t max = parent->value.jcomplex.max * JSON_DYNAMIC_ARRAY_GROW_BY;
+		if (max < JSON_DYNAMIC_ARRAY_CAPACITY) {
+			max = JSON_DYNAMIC_ARRAY_CAPACITY;
+		}
+		if (!_resizeChildren(ctx, parent, max)) {
+			json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_node_append failed, realloc returned NULL");
+			return;
+		}
+	}
+	parent->value.jcomplex.nodes[parent->value.jcomplex.count] = child;
+	parent->value.jcomplex.count++;
+	if (!IS_FROZEN(child)) { // A frozen child may have many parents, it's reference counted instead
+		child->parent = parent;
+	}
+	json_node_invalidate(parent);
+}
+
+bool json_node_reserveCtx(JsonContext* ctx, JsonNode* jnode, ptrdiff_t capacity) {
+	if (!jnode || !json_type_isComplex(jnode->value.type) || IS_FROZEN(jnode)) return false;
+	if (!json_node_unpack(jnode)) return false;
+	if (capacity <= jnode->value.jcomplex.max) return true;
+	if (!_resizeChildren(ctx, jnode, capacity)) {
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_node_reserve failed, realloc returned NULL");
+		return false;
+	}
+	return true;
+}
+
+char* json_node_allocStringCtx(JsonContext* ctx, JsonNode* jnode, ptrdiff_t length) {
+	if (!jnode || jnode->value.type != JSON_STRING || IS_FROZEN(jnode)) return NULL;
+	if (jnode->flags & JSON_FLAG_RAW) { // The parsed buffer owns the string
+		jnode->flags &= ~(JSON_FLAG_RAW | JSON_FLAG_UNDECODED | JSON_FLAG_ESCAPED);
+	} else {
+		_freeString(ctx, jnode, jnode->value.string, jnode->value.stringLength, JSON_FLAG_INLINE_STRING);
+	}
+	jnode->value.string = _allocString(ctx, jnode, length, JSON_FLAG_INLINE_STRING);
+	jnode->value.stringLength = jnode->value.string ? length : 0;
+	json_node_invalidate(jnode);
+	return jnode->value.string;
+}
+
+char* json_node_allocIdentifierCtx(JsonContext* ctx, JsonNode* jnode, ptrdiff_t length) {
+	if (!jnode || jnode->value.type == JSON_ERROR || IS_FROZEN(jnode)) return NULL;
+	if (length > UINT32_MAX) {
+		json_error_reportCtx(ctx, "JSON_ERROR: json_node_allocIdentifier failed, identifier too long");
+		return NULL;
+	}
+	_freeString(ctx, jnode, jnode->identifier, jnode->identifierLength, JSON_FLAG_INLINE_IDENTIFIER);
+	jnode->identifier = _allocString(ctx, jnode, length, JSON_FLAG_INLINE_IDENTIFIER);
+	jnode->identifierLength = jnode->identifier ? (uint32_t)length : 0;
+	json_node_invalidate(jnode->parent); // The identifier is part of its parent's hash, not its own
+	return jnode->identifier;
+}
+
+bool json_node_setIdentifierCtx(JsonContext* ctx, JsonNode* jnode, const char* identifier, ptrdiff_t length) {
+	if (!jnode || jnode->value.type == JSON_ERROR || IS_FROZEN(jnode)) return false;
+	if (!identifier) {
+		_freeString(ctx, jnode, jnode->identifier, jnode->identifierLength, JSON_FLAG_INLINE_IDENTIFIER);
+		jnode->identifier = NULL;
+		jnode->identifierLength = 0;
+		json_node_invalidate(jnode->parent);
+		return true;
+	}
+	char* copy = json_node_allocIdentifierCtx(ctx, jnode, length);
+	if (!copy) return false;
+	memcpy(copy, identifier, length);
+	return true;
+}
+
+JsonNode* json_node_cloneCtx(JsonContext* ctx, const JsonNode* jnode) {
+	if (!jnode) return NULL;
+	if (jnode->value.type == JSON_ERROR) return (JsonNode*)jnode; // Error nodes are static
+	JsonValue value = jnode->value;
+	if (value.type == JSON_REAL) {
+		value.real = json_node_readReal(jnode); // Decoded into the copy, the original is only read
+	} else if (value.type == JSON_STRING) {
+		value = (JsonValue){JSON_STRING, .string = NULL};
+	} else if (json_type_isComplex(value.type)) {
+		value = (JsonValue){value.type, {0}};
+	}
+	JsonNode* copy = json_node_createCtx(ctx, NULL, value);
+	if (!copy) return NULL;
+	if (!_cloneContents(ctx, copy, jnode)) {
+		json_node_freeCtx(ctx, copy);
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_node_clone failed, alloc returned NULL");
+		return NULL;
+	}
+	return copy;
+}
+
+void json_node_freeCtx(JsonContext* ctx, JsonNode* jnode) {
+	// Nothing is given back to an allocator without a free (an arena), so there's no need to walk the tree
+	if (!ctx->allocator.free) return;
+	JSON_STATS_START(timer);
+	_freeNode(ctx, jnode);
+	JSON_STATS_STOP(ctx, freeTime, timer);
+}
+
+// NOTE: 'values' are copied, an empty array isn't packed.
+JsonNode* json_packedArrayCtx(JsonContext* ctx, JsonType type, const void* values, ptrdiff_t count) {
+	if ((type != JSON_INT && type != JSON_REAL) || count < 0 || (!values && count > 0)) return NULL;
+	JsonNode* jarray = json_node_createCtx(ctx, NULL, (JsonValue){JSON_ARRAY, {0}});
+	if (!jarray || count == 0) return jarray;
+	if (!_pack(ctx, jarray, type, values, count)) {
+		json_node_freeCtx(ctx, jarray);
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_packedArray failed, alloc returned NULL");
+		return NULL;
+	}
+	return jarray;
+}
+
+
+JsonNode* json_objectCtx_impl(JsonContext* ctx, void** ptrs) {
+	JsonNode* jobject = json_node_createCtx(ctx, NULL, (JsonValue){JSON_OBJECT, {0}});
+	if (!jobject) return NULL;
 	ptrdiff_t i;
 	char* identifier = NULL;
 	for (i = 0; ptrs[i]; i++) {
@@ -134,58 +530,129 @@ JsonNode* json_object_impl(void** ptrs) {
 			identifier = (char*)ptrs[i];
 		} else {
 			JsonNode* jnode = (JsonNode*)ptrs[i];
-			int length = strlen(identifier);
-			void* temp = json_allocator.alloc(length + 1, json_allocator.context);
-			if (!temp) {
-				json_node_free(jobject);
-				json_error_reportCritical("JSON_ERROR: json_object failed, alloc returned NULL");
+			ptrdiff_t length = strlen(identifier);
+			char* copy = json_node_allocIdentifierCtx(ctx, jnode, length);
+			if (!copy) {
+				json_node_freeCtx(ctx, jobject);
+				json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_object failed, alloc returned NULL");
 				return NULL;
 			}
-			jnode->identifier = temp;
-			strcpy(jnode->identifier, identifier);
+			memcpy(copy, identifier, length + 1);
 			identifier = NULL;
-			json_node_append(jobject, jnode);
+			json_node_appendCtx(ctx, jobject, jnode);
 		}
 	}
 	return jobject;
 }
 
-JsonNode* json_array_impl(JsonNode** jnodes) {
-	JsonNode* jarray = json_node_create(NULL, (JsonValue){JSON_ARRAY, {0}});
+JsonNode* json_arrayCtx_impl(JsonContext* ctx, JsonNode** jnodes) {
+	JsonNode* jarray = json_node_createCtx(ctx, NULL, (JsonValue){JSON_ARRAY, {0}});
+	if (!jarray) return NULL;
 	ptrdiff_t i;
 	for (i = 0; jnodes[i]; i++) {
-		json_node_append(jarray, jnodes[i]);
+		json_node_appendCtx(ctx, jarray, jnodes[i]);
 	}
 	return jarray;
 }
 
-inline JsonNode* json_bool(bool boolean) {
-	return json_node_create(NULL, (JsonValue){JSON_BOOL, .boolean = boolean});
+JsonNode* json_boolCtx(JsonContext* ctx, bool boolean) {
+	return json_node_createCtx(ctx, NULL, (JsonValue){JSON_BOOL, .boolean = boolean});
 }
 
-inline JsonNode* json_int(int64_t integer) {
-	return json_node_create(NULL, (JsonValue){JSON_INT, .integer = integer});
+JsonNode* json_intCtx(JsonContext* ctx, int64_t integer) {
+	return json_node_createCtx(ctx, NULL, (JsonValue){JSON_INT, .integer = integer});
 }
 
-inline JsonNode* json_real(double real) {
-	return json_node_create(NULL, (JsonValue){JSON_REAL, .real = real});
+JsonNode* json_realCtx(JsonContext* ctx, double real) {
+	return json_node_createCtx(ctx, NULL, (JsonValue){JSON_REAL, .real = real});
 }
 
-inline JsonNode* json_null(void) {
-	return json_node_create(NULL, (JsonValue){JSON_NULL, {0}});
+JsonNode* json_nullCtx(JsonContext* ctx) {
+	return json_node_createCtx(ctx, NULL, (JsonValue){JSON_NULL, {0}});
 }
 
-inline JsonNode* json_string(char* string) {
-	return json_node_create(NULL, (JsonValue){JSON_STRING, .string = string});
+JsonNode* json_stringCtx(JsonContext* ctx, char* string) {
+	if (!string) return NULL;
+	return json_stringNCtx(ctx, string, strlen(string));
+}
+
+JsonNode* json_stringNCtx(JsonContext* ctx, const char* string, ptrdiff_t length) {
+	if (!string || length < 0) return NULL;
+	JsonNode* jnode = json_node_createCtx(ctx, NULL, (JsonValue){JSON_STRING, .string = NULL});
+	if (!jnode) return NULL;
+	char* copy = json_node_allocStringCtx(ctx, jnode, length);
+	if (!copy) {
+		json_node_freeCtx(ctx, jnode);
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_string failed, alloc returned NULL");
+		return NULL;
+	}
+	memcpy(copy, string, length);
+	copy[length] = '\0';
+	return jnode;
+}
+
+
+bool json_object_setCtx(JsonContext* ctx, JsonNode* jobject, const char* key, JsonNode* value) {
+	return json_object_setNCtx(ctx, jobject, key, key ? (ptrdiff_t)strlen(key) : 0, value);
+}
+
+bool json_object_setNCtx(JsonContext* ctx, JsonNode* jobject, const char* key, ptrdiff_t length, JsonNode* value) {
+	if (!value) return false;
+	if (!IS_OBJECT(jobject) || !key || IS_FROZEN(jobject) || !_rename(ctx, value, key, length)) {
+		json_node_freeCtx(ctx, value);
+		return false;
+	}
+	ptrdiff_t index = _memberIndex(jobject, value->identifier, value->identifierLength);
+	if (index < 0) return _insertAt(ctx, jobject, AS_OBJECT(jobject).count, value);
+	_replaceAt(ctx, jobject, index, value);
+	return true;
+}
+
+bool json_object_removeCtx(JsonContext* ctx, JsonNode* jobject, const char* key) {
+	if (!IS_OBJECT(jobject) || !key || IS_FROZEN(jobject)) return false;
+	ptrdiff_t index = _memberIndex(jobject, key, strlen(key));
+	if (index < 0) return false;
+	json_node_freeCtx(ctx, _detachAt(jobject, index));
+	return true;
+}
+
+bool json_array_insertCtx(JsonContext* ctx, JsonNode* jarray, ptrdiff_t index, JsonNode* value) {
+	if (!value) return false;
+	if (!IS_ARRAY(jarray) || IS_FROZEN(jarray) || index < 0 || index > AS_ARRAY(jarray).count
+		|| !_rename(ctx, value, NULL, 0)) {
+		json_node_freeCtx(ctx, value);
+		return false;
+	}
+	return _insertAt(ctx, jarray, index, value);
+}
+
+bool json_array_removeCtx(JsonContext* ctx, JsonNode* jarray, ptrdiff_t index) {
+	if (!IS_ARRAY(jarray) || IS_FROZEN(jarray) || index < 0 || index >= AS_ARRAY(jarray).count) return false;
+	if (!json_node_unpack(jarray)) return false;
+	json_node_freeCtx(ctx, _detachAt(jarray, index));
+	return true;
+}
+
+bool json_array_replaceCtx(JsonContext* ctx, JsonNode* jarray, ptrdiff_t index, JsonNode* value) {
+	if (!value) return false;
+	if (!IS_ARRAY(jarray) || IS_FROZEN(jarray) || index < 0 || index >= AS_ARRAY(jarray).count
+		|| !_rename(ctx, value, NULL, 0) || !json_node_unpack(jarray)) {
+		json_node_freeCtx(ctx, value);
+		return false;
+	}
+	_replaceAt(ctx, jarray, index, value);
+	return true;
 }
 
 
 JsonNode* json_property(JsonNode* jnode, char* identifier) {
 	if (!jnode || !identifier || jnode->value.type != JSON_OBJECT) return NULL;
+	ptrdiff_t length = strlen(identifier);
 	ptrdiff_t i;
 	for (i = 0; i < jnode->value.jcomplex.count; i++) {
-		if (strcmp(jnode->value.jcomplex.nodes[i]->identifier, identifier) == 0) {
-			return jnode->value.jcomplex.nodes[i];
+		JsonNode* child = jnode->value.jcomplex.nodes[i];
+		if (child->identifierLength == length && memcmp(child->identifier, identifier, length) == 0) {
+			return child;
 		}
 	}
 	return NULL;
@@ -194,6 +661,7 @@ JsonNode* json_property(JsonNode* jnode, char* identifier) {
 JsonNode* json_index(JsonNode* jnode, ptrdiff_t index) {
 	if (!jnode || jnode->value.type != JSON_ARRAY || index >= jnode->value.jcomplex.count) 
 		return NULL;
+	if (!json_node_unpack(jnode)) return NULL; // A packed array gets its nodes on the first indexed access
 	return jnode->value.jcomplex.nodes[index];
 }
 
@@ -229,8 +697,335 @@ JsonNode* json_get_impl(JsonNode* root, ...) {
 #undef TERMINATOR
 
 
-static bool _safeStringEqual(const char* s1, const char* s2) {
+// Frees the tree without recursing, so deep trees can't overflow the stack. Each container's children are taken
+// off its end one by one, and a child that's a container itself is gone into, with its parent pointer leading back.
+static void _freeNode(JsonContext* ctx, JsonNode* jnode) {
+	if (!_takeLast(jnode)) return;
+	JsonNode* node = jnode;
+	while (true) {
+		if (json_type_isComplex(node->value.type) && !IS_PACKED(node) && node->value.jcomplex.count > 0) {
+			JsonNode* child = node->value.jcomplex.nodes[--node->value.jcomplex.count];
+			if (_takeLast(child)) {
+				child->parent = node; // A frozen child may have been shared by other parents, but not anymore
+				node = child;
+			}
+			continue;
+		}
+		JsonNode* parent = node->parent;
+		_freeOwn(ctx, node);
+		if (node == jnode) break;
+		node = parent;
+	}
+}
+
+// Whether the node is to be freed, false for the static error nodes and shared nodes with other references left.
+static bool _takeLast(JsonNode* jnode) {
+	if (!jnode || jnode->value.type == JSON_ERROR) return false; // Error nodes are static, see json_error_node
+	// A frozen node may be shared, only the last reference frees it (and drops its references to its children)
+	return !IS_FROZEN(jnode) || json_atomic_add(&jnode->refs, -1) <= 0;
+}
+
+// Frees the node's own memory, once its children have been freed.
+static void _freeOwn(JsonContext* ctx, JsonNode* jnode) {
+	if (json_type_isComplex(jnode->value.type)) {
+		if (IS_PACKED(jnode)) {
+			json_context_free(ctx, AS_PACKED(jnode), _packedSize(jnode->value.jcomplex.count));
+		} else if (!HAS_INLINE_CHILDREN(jnode)) {
+			json_context_free(ctx, jnode->value.jcomplex.nodes, jnode->value.jcomplex.max * sizeof(JsonNode*));
+		}
+		JsonOutputCache* output = AS_CONTAINER(jnode)->output;
+		if (output) {
+			json_context_free(ctx, output, sizeof(JsonOutputCache) + output->capacity);
+		}
+	} else if (jnode->value.type == JSON_STRING && !(jnode->flags & JSON_FLAG_RAW)) {
+		_freeString(ctx, jnode, jnode->value.string, jnode->value.stringLength, JSON_FLAG_INLINE_STRING);
+	}
+	_freeString(ctx, jnode, jnode->identifier, jnode->identifierLength, JSON_FLAG_INLINE_IDENTIFIER);
+	json_context_free(ctx, jnode, _nodeSize(jnode->value.type));
+}
+
+// Moves the children of a container to a heap array of exactly 'max' slots.
+static bool _resizeChildren(JsonContext* ctx, JsonNode* jnode, ptrdiff_t max) {
+	JsonNode** nodes = jnode->value.jcomplex.nodes;
+	if (HAS_INLINE_CHILDREN(jnode)) {
+		nodes = json_context_alloc(ctx, max * sizeof(JsonNode*));
+		if (!nodes) return false;
+		memcpy(nodes, jnode->value.jcomplex.nodes, jnode->value.jcomplex.count * sizeof(JsonNode*));
+	} else {
+		nodes = json_context_realloc(ctx, nodes, max * sizeof(JsonNode*), jnode->value.jcomplex.max * sizeof(JsonNode*));
+		if (!nodes) return false;
+	}
+	jnode->value.jcomplex.nodes = nodes;
+	jnode->value.jcomplex.max = max;
+	return true;
+}
+
+// NOTE: A node keeps its type for life, so the size it was allocated with can always be recovered.
+static ptrdiff_t _nodeSize(JsonType type) {
+	if (json_type_isComplex(type))
+		return sizeof(JsonContainer);
+	return sizeof(JsonNode);
+}
+
+// Copies the identifier, string or children of 'jnode' into its freshly created copy.
+static bool _cloneContents(JsonContext* ctx, JsonNode* copy, const JsonNode* jnode) {
+	if (jnode->identifier) {
+		char* identifier = json_node_allocIdentifierCtx(ctx, copy, jnode->identifierLength);
+		if (!identifier) return false;
+		memcpy(identifier, jnode->identifier, jnode->identifierLength);
+	}
+	if (jnode->value.type == JSON_STRING) {
+		ptrdiff_t length = _decodedLength(jnode);
+		char* string = json_node_allocStringCtx(ctx, copy, length);
+		if (!string) return false;
+		ptrdiff_t offset = 0;
+		json_node_readString(jnode, &offset, string, length); // The copy owns its string, and has no text to decode
+	} else if (IS_PACKED(jnode)) {
+		return _pack(ctx, copy, AS_PACKED(jnode)->type, AS_PACKED(jnode)->values, jnode->value.jcomplex.count);
+	} else if (json_type_isComplex(jnode->value.type)) {
+		if (!json_node_reserveCtx(ctx, copy, jnode->value.jcomplex.count)) return false;
+		for (ptrdiff_t i = 0; i < jnode->value.jcomplex.count; i++) {
+			JsonNode* child = json_node_cloneCtx(ctx, jnode->value.jcomplex.nodes[i]);
+			if (!child) return false;
+			child->parent = copy;
+			copy->value.jcomplex.nodes[copy->value.jcomplex.count++] = child;
+		}
+	}
+	return true;
+}
+
+// An undecoded string is hashed as it's read, unescaped a piece at a time, so it hashes the same as decoded
+static uint64_t _hashString(const JsonNode* jnode) {
+	if (!_isEscaped(jnode)) return _hashBytes(FNV_OFFSET_BASIS, AS_STRING(jnode), AS_STRING_LEN(jnode));
+	char chunk[JSON_DECODE_CHUNK_SIZE];
+	uint64_t hash = FNV_OFFSET_BASIS;
+	ptrdiff_t offset = 0;
+	ptrdiff_t read;
+	while ((read = json_node_readString(jnode, &offset, chunk, sizeof(chunk))) > 0) {
+		hash = _hashBytes(hash, chunk, read);
+	}
+	return hash;
+}
+
+// NOTE: The cache is read and written atomically, since frozen trees are hashed from many threads at once.
+static uint64_t _hashContainer(const JsonNode* jnode, enum JsonHashMode mode) {
+	JsonContainer* container = AS_CONTAINER(jnode);
+	uint64_t hash = json_atomic_load64(&container->hashes[mode]);
+	if (hash) return hash;
+	bool isUnordered = mode == JSON_HASH_UNORDERED && jnode->value.type == JSON_OBJECT;
+	uint64_t unorderedSum = 0;
+	hash = _mix(jnode->value.type + 1);
+	JsonNode scratch; // A packed array hashes the same as it would unpacked
+	for (ptrdiff_t i = 0; i < AS_COMPLEX(jnode).count; i++) {
+		JsonNode* child = json_node_childAt(jnode, i, &scratch);
+		uint64_t childHash = json_node_hash(child, mode);
+		if (jnode->value.type == JSON_OBJECT) {
+			childHash = _mix(childHash ^ _mix(_hashBytes(FNV_OFFSET_BASIS, child->identifier, child->identifierLength)));
+		}
+		if (isUnordered) {
+			unorderedSum += childHash; // Addition doesn't care about the order
+		} else {
+			hash = _mix(hash ^ childHash);
+		}
+	}
+	hash = _mix(hash ^ unorderedSum ^ (uint64_t)AS_COMPLEX(jnode).count);
+	hash = hash ? hash : 1; // 0 means nothing is cached
+	json_atomic_store64(&container->hashes[mode], hash);
+	return hash;
+}
+
+// FNV-1a, byte by byte so the hash is the same on every platform. 'hash' is FNV_OFFSET_BASIS to start with, or
+// what hashing the bytes before these returned.
+static uint64_t _hashBytes(uint64_t hash, const char* bytes, ptrdiff_t length) {
+	for (ptrdiff_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+// The splitmix64 finalizer
+static uint64_t _mix(uint64_t hash) {
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebULL;
+	hash ^= hash >> 31;
+	return hash;
+}
+
+// The identifier and string share the inline buffer, so one is placed after the other if it's already there.
+static char* _allocString(JsonContext* ctx, JsonNode* jnode, ptrdiff_t length, uint8_t flag) {
+	bool isString = flag == JSON_FLAG_INLINE_STRING;
+	char* other = isString ? jnode->identifier : jnode->value.string;
+	ptrdiff_t otherLength = isString ? jnode->identifierLength : jnode->value.stringLength;
+	uint8_t otherFlag = isString ? JSON_FLAG_INLINE_IDENTIFIER : JSON_FLAG_INLINE_STRING;
+	ptrdiff_t used = (jnode->flags & otherFlag) ? other + otherLength + 1 - jnode->inlineStrings : 0;
+	char* string;
+	if (length + 1 <= JSON_INLINE_STRING_SIZE - used) {
+		jnode->flags |= flag;
+		string = jnode->inlineStrings + used;
+	} else {
+		jnode->flags &= ~flag;
+		string = json_context_alloc(ctx, length + 1);
+		if (!string) return NULL;
+	}
+	string[length] = '\0';
+	return string;
+}
+
+static void _freeString(JsonContext* ctx, JsonNode* jnode, char* string, ptrdiff_t length, uint8_t flag) {
+	if (!string) return;
+	if (jnode->flags & flag) {
+		jnode->flags &= ~flag;
+		return;
+	}
+	json_context_free(ctx, string, length + 1);
+}
+
+// Names the node 'key' (or nothing, for a NULL key), unless it's named that already
+static bool _rename(JsonContext* ctx, JsonNode* jnode, const char* key, ptrdiff_t length) {
+	if (_safeStringEqual(jnode->identifier, jnode->identifierLength, key, length)) return true;
+	return json_node_setIdentifierCtx(ctx, jnode, key, length);
+}
+
+static ptrdiff_t _memberIndex(const JsonNode* jobject, const char* key, ptrdiff_t length) {
+	for (ptrdiff_t i = 0; i < AS_OBJECT(jobject).count; i++) {
+		const JsonNode* child = AS_OBJECT(jobject).nodes[i];
+		if (_safeStringEqual(child->identifier, child->identifierLength, key, length)) return i;
+	}
+	return -1;
+}
+
+// Appending first, so the children grow the same way they do for json_node_append,
+// then moving the new child into place. 'child' is freed if there's no room for it.
+static bool _insertAt(JsonContext* ctx, JsonNode* parent, ptrdiff_t index, JsonNode* child) {
+	ptrdiff_t count = AS_COMPLEX(parent).count;
+	json_node_appendCtx(ctx, parent, child);
+	if (AS_COMPLEX(parent).count == count) {
+		json_node_freeCtx(ctx, child);
+		return false;
+	}
+	JsonNode** nodes = AS_COMPLEX(parent).nodes;
+	memmove(nodes + index + 1, nodes + index, (count - index) * sizeof(JsonNode*));
+	nodes[index] = child;
+	return true;
+}
+
+static void _replaceAt(JsonContext* ctx, JsonNode* parent, ptrdiff_t index, JsonNode* child) {
+	JsonNode* previous = AS_COMPLEX(parent).nodes[index];
+	AS_COMPLEX(parent).nodes[index] = child;
+	if (!IS_FROZEN(child)) {
+		child->parent = parent;
+	}
+	if (!IS_FROZEN(previous)) {
+		previous->parent = NULL;
+	}
+	json_node_invalidate(parent);
+	json_node_freeCtx(ctx, previous);
+}
+
+static JsonNode* _detachAt(JsonNode* parent, ptrdiff_t index) {
+	JsonNode** nodes = AS_COMPLEX(parent).nodes;
+	JsonNode* child = nodes[index];
+	memmove(nodes + index, nodes + index + 1, (AS_COMPLEX(parent).count - index - 1) * sizeof(JsonNode*));
+	AS_COMPLEX(parent).count--;
+	if (!IS_FROZEN(child)) {
+		child->parent = NULL;
+	}
+	json_node_invalidate(parent);
+	return child;
+}
+
+static bool _safeStringEqual(const char* s1, ptrdiff_t length1, const char* s2, ptrdiff_t length2) {
 	if (!s1 && !s2) return true;
 	if (!s1 || !s2) return false;
-	return strcmp(s1, s2) == 0;
+	return length1 == length2 && memcmp(s1, s2, length1) == 0;
+}
+
+// Compares the values of two strings, either of which may be undecoded. Escaped text is unescaped into chunks
+// as it's compared, which are compared as far as both have been read.
+static bool _stringValueEqual(const JsonNode* node1, const JsonNode* node2) {
+	if (!_isEscaped(node1) && !_isEscaped(node2))
+		return _safeStringEqual(AS_STRING(node1), AS_STRING_LEN(node1), AS_STRING(node2), AS_STRING_LEN(node2));
+	char chunk1[JSON_DECODE_CHUNK_SIZE], chunk2[JSON_DECODE_CHUNK_SIZE];
+	ptrdiff_t offset1 = 0, offset2 = 0;
+	ptrdiff_t read1 = 0, read2 = 0;
+	ptrdiff_t at1 = 0, at2 = 0;
+	while (true) {
+		if (at1 == read1) {
+			read1 = json_node_readString(node1, &offset1, chunk1, sizeof(chunk1));
+			at1 = 0;
+		}
+		if (at2 == read2) {
+			read2 = json_node_readString(node2, &offset2, chunk2, sizeof(chunk2));
+			at2 = 0;
+		}
+		if (read1 == 0 || read2 == 0) return read1 == read2; // Both have ended, or only one has
+		ptrdiff_t length = read1 - at1 < read2 - at2 ? read1 - at1 : read2 - at2;
+		if (memcmp(chunk1 + at1, chunk2 + at2, length) != 0) return false;
+		at1 += length;
+		at2 += length;
+	}
+}
+
+// Stores the array's elements as 'count' packed values, copied from 'values'. The array must be empty.
+static bool _pack(JsonContext* ctx, JsonNode* jarray, JsonType type, const void* values, ptrdiff_t count) {
+	JsonPackedArray* packed = json_context_alloc(ctx, _packedSize(count));
+	if (!packed) return false;
+	packed->ctx = ctx;
+	packed->type = type;
+	memcpy(packed->values, values, count * sizeof(JsonPackedValue));
+	AS_PACKED(jarray) = packed;
+	jarray->flags |= JSON_FLAG_PACKED;
+	AS_ARRAY(jarray).nodes = NULL;
+	AS_ARRAY(jarray).max = 0;
+	AS_ARRAY(jarray).count = count;
+	return true;
+}
+
+static JsonValue _packedValue(const JsonPackedArray* packed, ptrdiff_t index) {
+	if (packed->type == JSON_INT) return (JsonValue){JSON_INT, .integer = packed->values[index].integer};
+	return (JsonValue){JSON_REAL, .real = packed->values[index].real};
+}
+
+static ptrdiff_t _packedSize(ptrdiff_t count) {
+	return sizeof(JsonPackedArray) + count * sizeof(JsonPackedValue);
+}
+
+// Returns the unescaped length. Unescaping never writes past what it has read, so it can be done in place.
+// Whether the node is a string that's still escaped text, which has to be unescaped to be read
+static bool _isEscaped(const JsonNode* jnode) {
+	return (jnode->flags & (JSON_FLAG_UNDECODED | JSON_FLAG_ESCAPED)) == (JSON_FLAG_UNDECODED | JSON_FLAG_ESCAPED);
+}
+
+// The length of the string once it's decoded, which is its text's for a string without escapes
+static ptrdiff_t _decodedLength(const JsonNode* jnode) {
+	if (!_isEscaped(jnode)) return jnode->value.stringLength;
+	char chunk[JSON_DECODE_CHUNK_SIZE];
+	ptrdiff_t offset = 0;
+	ptrdiff_t length = 0;
+	ptrdiff_t read;
+	while ((read = json_node_readString(jnode, &offset, chunk, sizeof(chunk))) > 0) {
+		length += read;
+	}
+	return length;
+}
+
+static ptrdiff_t _unescapeInPlace(char* string, ptrdiff_t length) {
+	ptrdiff_t j = 0;
+	ptrdiff_t k = 0;
+	while (k < length) {
+		const char* escape = memchr(string + k, '\\', length - k);
+		ptrdiff_t run = escape ? escape - (string + k) : length - k;
+		memmove(string + j, string + k, run);
+		j += run;
+		k += run;
+		if (k < length) {
+			ptrdiff_t written;
+			k += json_utils_unescape(string + k, length - k, string + j, &written); // The parser validated it
+			j += written;
+		}
+	}
+	return j;
 }
@@ -10,7 +10,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#include "json_allocator.h"
+#include "json_config.h"
+#include "json_context.h"
 
 typedef enum {
 	JSON_ERROR,
@@ -29,7 +30,10 @@ typedef struct JsonValue {
 		int64_t integer;
 		double real;
 		bool boolean;
-		char* string;
+		struct {
+			char* string;
+			ptrdiff_t stringLength; // NOTE: The string may contain '\0', but is always terminated by one
+		};
 		struct {
 			struct JsonNode** nodes;
 			ptrdiff_t max;
@@ -38,20 +42,94 @@ typedef struct JsonValue {
 	};
 } JsonValue;
 
+enum JsonNodeFlags {
+	JSON_FLAG_INLINE_IDENTIFIER = 1 << 0,	// identifier points into inlineStrings
+	JSON_FLAG_INLINE_STRING = 1 << 1,		// value.string points into inlineStrings
+	JSON_FLAG_FROZEN = 1 << 2,				// Immutable and reference counted, see json_shared.h
+	JSON_FLAG_SERIALIZED = 1 << 3,			// Unchanged since JSON_WRITE_CACHED last wrote it, see json_serializer.h
+	JSON_FLAG_PACKED = 1 << 4,				// An array whose elements are stored as values in 'packed', not as nodes
+	JSON_FLAG_RAW = 1 << 5,					// value.string points into the buffer json_parseLazy parsed, which owns it
+	JSON_FLAG_UNDECODED = 1 << 6,			// A raw real or string, still the text it was parsed from
+	JSON_FLAG_ESCAPED = 1 << 7				// The undecoded string has escapes in it
+};
+
+// json_parseLazy decodes reals written with fewer characters than this when they're read, longer ones right away
+#define JSON_RAW_REAL_SIZE 64
+
+enum JsonHashMode {
+	JSON_HASH_ORDERED,		// Objects with the same members in a different order hash differently
+	JSON_HASH_UNORDERED,	// The order of an object's members doesn't matter (an array's still does)
+	JSON_HASH_MODE_COUNT
+};
+
+// NOTE: Short identifiers and strings are stored in inlineStrings, which they share.
+// So nodes must not be copied by value.
 typedef struct JsonNode {
 	char* identifier;
 	struct JsonValue value;
+	union {
+		struct JsonNode* parent;	// The container holding the node, while it's mutable
+		int32_t refs;				// How many references there are to it, once it's frozen
+	};
+	uint32_t identifierLength;
+	uint8_t flags;
+	char inlineStrings[JSON_INLINE_STRING_SIZE];
 } JsonNode;
 
+// A container's text as JSON_WRITE_CACHED last wrote it, only valid while the container is JSON_FLAG_SERIALIZED
+typedef struct JsonOutputCache {
+	ptrdiff_t length;
+	ptrdiff_t capacity;
+	int32_t depth;	// How deeply it was indented
+	uint16_t option;	// The layout it was written with, JSON_WRITE_ASCII included
+	char bytes[];
+} JsonOutputCache;
+
+typedef union JsonPackedValue {
+	int64_t integer;
+	double real;
+} JsonPackedValue;
+
+// The elements of a packed array, all JSON_INT (integer) or all JSON_REAL (real), 'count' of them as the array says.
+// 'ctx' is the context the array was allocated with, which turning them into nodes allocates through.
+typedef struct JsonPackedArray {
+	JsonContext* ctx;
+	JsonType type;
+	JsonPackedValue values[];
+} JsonPackedArray;
+
+// Containers are allocated as a JsonContainer, the node followed by what only containers need.
+// 'nodes' points at inlineNodes until the children outgrow it. A packed array has no nodes (NULL) until it's unpacked.
+typedef struct JsonContainer {
+	JsonNode node;
+	union {
+		JsonNode* inlineNodes[JSON_INLINE_CHILDREN];
+		JsonPackedArray* packed;
+	};
+	uint64_t hashes[JSON_HASH_MODE_COUNT]; // Cached by json_node_hash, 0 while unknown
+	JsonOutputCache* output;
+} JsonContainer;
+
 // Casts a JsonNode*
 #define AS_INT(jnode)		((jnode)->value.integer)
 #define AS_REAL(jnode)		((jnode)->value.real)
 #define AS_BOOL(jnode)		((jnode)->value.boolean)
 #define AS_STRING(jnode)	((jnode)->value.string)
+#define AS_STRING_LEN(jnode) ((jnode)->value.stringLength)
 #define AS_ARRAY(jnode)		((jnode)->value.jcomplex)
 #define AS_OBJECT(jnode)	((jnode)->value.jcomplex)
 // This one exists mainly for implementation clarity
 #define AS_COMPLEX(jnode)	((jnode)->value.jcomplex)
+#define AS_CONTAINER(jnode)	((JsonContainer*)(jnode))
+// True when a string is stored in the node itself rather than in a separate allocation
+#define IS_INLINE_STRING(jnode)		(((jnode)->flags & JSON_FLAG_INLINE_STRING) != 0)
+#define IS_INLINE_IDENTIFIER(jnode)	(((jnode)->flags & JSON_FLAG_INLINE_IDENTIFIER) != 0)
+#define IS_FROZEN(jnode)			(((jnode)->flags & JSON_FLAG_FROZEN) != 0)
+#define IS_PACKED(jnode)			(((jnode)->flags & JSON_FLAG_PACKED) != 0)
+#define IS_UNDECODED(jnode)			(((jnode)->flags & JSON_FLAG_UNDECODED) != 0)
+// True while a container's children are still stored in the node's own allocation
+#define HAS_INLINE_CHILDREN(jnode) (AS_COMPLEX(jnode).nodes == AS_CONTAINER(jnode)->inlineNodes)
+#define AS_PACKED(jnode)	(AS_CONTAINER(jnode)->packed)
 
 // Tests a JsonNode*
 #define IS_INT(jnode)		((jnode) && (jnode)->value.type == JSON_INT)
@@ -67,25 +145,119 @@ bool json_type_isComplex(JsonType);
 
 JsonNode* json_node_create(char*, JsonValue);
 void json_node_append(JsonNode*, JsonNode*);
+bool json_node_reserve(JsonNode*, ptrdiff_t capacity);
+char* json_node_allocString(JsonNode*, ptrdiff_t length);
+char* json_node_allocIdentifier(JsonNode*, ptrdiff_t length);
+bool json_node_setIdentifier(JsonNode*, const char*, ptrdiff_t length); // A NULL identifier removes it
 ptrdiff_t json_node_childrenCount(const JsonNode*);
 bool json_node_equals(const JsonNode*, const JsonNode*);
-void json_node_free(JsonNode*);
+bool json_node_valueEquals(const JsonNode*, const JsonNode*); // Same as above, but ignoring the two nodes' own identifiers
+// A stable 64-bit hash of the node's value (its own identifier isn't included), cached for containers.
+// NOTE: After changing a node's value directly (e.g. AS_INT(node) = 4), call json_node_invalidate on it,
+// which drops the cached hashes and marks the cached output of JSON_WRITE_CACHED stale. json_node_equals and
+// json_diff reject mismatches by the cached hashes, so a stale one makes them miss the change.
+uint64_t json_node_hash(const JsonNode*, enum JsonHashMode);
+void json_node_invalidate(JsonNode*);
+// Takes the node out of its container and returns it (or NULL if it's in none), the caller now owns it
+JsonNode* json_node_detach(JsonNode*);
+JsonNode* json_node_clone(const JsonNode*);
+void json_node_free(JsonNode*); // Doesn't recurse, and doesn't walk the tree at all if the allocator has no free
+
+// Packed arrays hold their numbers side by side, 8 bytes each, instead of a node per element. Parsing through a
+// context set with json_context_setPackArrays packs arrays of at least JSON_PACK_MIN_COUNT numbers that are all
+// integers or all reals. The serializer, json_node_equals, hashing and patching read them like any other array,
+// but AS_ARRAY(node).nodes is NULL. Accessing an element as a node (json_index, json_get) or changing the array
+// turns it into an ordinary array first, json_node_childAt reads an element into a scratch node without doing so.
+// NOTE: Frozen arrays are unpacked by json_shared_freeze, so they can be read from many threads.
+JsonNode* json_packedArray(JsonType, const void* values, ptrdiff_t count); // JSON_INT (int64_t) or JSON_REAL (double)
+const int64_t* json_array_asInt64s(const JsonNode*);	// NULL unless the array is packed with JSON_INT
+const double* json_array_asDoubles(const JsonNode*);	// NULL unless the array is packed with JSON_REAL
+bool json_node_unpack(JsonNode*);						// Gives a packed array a node per element, true if it has them
+// The container's child at 'index', and for a packed array the element written into 'scratch', so nothing is unpacked.
+// NOTE: The node returned for a packed element is only valid as long as 'scratch' is, and isn't in the array.
+JsonNode* json_node_childAt(const JsonNode*, ptrdiff_t index, JsonNode* scratch);
+
+// Reading the values of trees parsed by json_parseLazy, whose reals and strings are left as the text they were
+// parsed from until they're first read. Decoding happens in the parsed buffer, so it never allocates or fails,
+// and the result is kept. These work on any node, for nodes already decoded they're the same as the AS_ macros.
+// Call json_node_decode before reading or changing a value directly.
+// NOTE: Decoding writes to the node and the buffer, so a lazy tree read through these from many threads at once
+// has to be frozen first (json_shared_freeze decodes it).
+void json_node_decode(JsonNode*);
+double json_node_real(JsonNode*); // An integer's value as a double too, 0 for other types
+const char* json_node_string(JsonNode*); // NULL if the node isn't a string
+ptrdiff_t json_node_stringLength(JsonNode*);
+// These read a value without decoding it, which the library's own reading (json_node_equals, json_node_hash,
+// json_node_clone, the serializer, patching) does, so it never writes to a tree it's given as const.
+double json_node_readReal(const JsonNode*); // Like json_node_real
+// Writes the string's value from '*offset' (an offset into its text, 0 to start with) on into 'out', unescaped,
+// as much of it as fits without cutting a character in two, and moves '*offset' past what was read. Returns the
+// bytes written, 0 once the whole string has been read. 'size' has to be at least 4 for it to get anywhere.
+ptrdiff_t json_node_readString(const JsonNode*, ptrdiff_t* offset, char* out, ptrdiff_t size);
 
 JsonNode* json_object_impl(void**); // shouldn't be called, use the macro wrapper instead
 #define json_object(...) json_object_impl((void*[]){__VA_ARGS__, NULL})
-#define json_emptyObject() jnode_create(NULL, (JsonValue){JSON_OBJECT, 0})
+#define json_emptyObject() json_node_create(NULL, (JsonValue){JSON_OBJECT, {0}})
 JsonNode* json_array_impl(JsonNode**); // shouldn't be called, use the macro wrapper instead
 #define json_array(...) json_array_impl((JsonNode*[]){__VA_ARGS__, NULL})
-#define json_emptyArray() jnode_create(NULL, (JsonValue){JSON_ARRAY, 0})
+#define json_emptyArray() json_node_create(NULL, (JsonValue){JSON_ARRAY, {0}})
 JsonNode* json_bool(bool);
 JsonNode* json_int(int64_t);
 JsonNode* json_real(double);
 JsonNode* json_null(void);
-JsonNode* json_string(char*);
+JsonNode* json_string(char*); // NOTE: the string is copied
+JsonNode* json_stringN(const char*, ptrdiff_t length); // May contain '\0'
+
+// Changing a tree in place. The value handed in is always consumed: it's named (the key, or nothing for array
+// elements) and owned by the container, or freed if it can't be added. Whatever it replaces or removes is freed.
+// Setting a key that isn't in the object yet appends it, and inserting at the array's length appends too.
+// NOTE: The value mustn't be in another container, json_node_detach it first. Frozen containers are refused.
+bool json_object_set(JsonNode*, const char* key, JsonNode* value);
+bool json_object_setN(JsonNode*, const char* key, ptrdiff_t length, JsonNode* value);
+bool json_object_remove(JsonNode*, const char* key); // False if there's no such key
+bool json_array_insert(JsonNode*, ptrdiff_t index, JsonNode* value);
+bool json_array_remove(JsonNode*, ptrdiff_t index);
+bool json_array_replace(JsonNode*, ptrdiff_t index, JsonNode* value);
+
+// Same as above, but allocating through (and reporting errors to) the given context.
+// NOTE: A node must be freed with the same context it was allocated with.
+JsonNode* json_node_createCtx(JsonContext*, char*, JsonValue);
+void json_node_appendCtx(JsonContext*, JsonNode*, JsonNode*);
+// Makes room for exactly 'capacity' children, so a known number of appends won't reallocate.
+bool json_node_reserveCtx(JsonContext*, JsonNode*, ptrdiff_t capacity);
+// Replaces the node's string/identifier with room for 'length' chars plus the '\0', which the caller fills in.
+// The room is inside the node when it fits, so it's valid for as long as the node is.
+char* json_node_allocStringCtx(JsonContext*, JsonNode*, ptrdiff_t length);
+char* json_node_allocIdentifierCtx(JsonContext*, JsonNode*, ptrdiff_t length);
+bool json_node_setIdentifierCtx(JsonContext*, JsonNode*, const char*, ptrdiff_t length);
+// NOTE: The clone is a deep copy and never frozen, even if the original is.
+JsonNode* json_node_cloneCtx(JsonContext*, const JsonNode*);
+// NOTE: Freeing a frozen node only drops a reference to it, see json_shared.h.
+void json_node_freeCtx(JsonContext*, JsonNode*);
+JsonNode* json_packedArrayCtx(JsonContext*, JsonType, const void* values, ptrdiff_t count);
+
+JsonNode* json_objectCtx_impl(JsonContext*, void**);
+#define json_objectCtx(ctx, ...) json_objectCtx_impl(ctx, (void*[]){__VA_ARGS__, NULL})
+#define json_emptyObjectCtx(ctx) json_node_createCtx(ctx, NULL, (JsonValue){JSON_OBJECT, {0}})
+JsonNode* json_arrayCtx_impl(JsonContext*, JsonNode**);
+#define json_arrayCtx(ctx, ...) json_arrayCtx_impl(ctx, (JsonNode*[]){__VA_ARGS__, NULL})
+#define json_emptyArrayCtx(ctx) json_node_createCtx(ctx, NULL, (JsonValue){JSON_ARRAY, {0}})
+JsonNode* json_boolCtx(JsonContext*, bool);
+JsonNode* json_intCtx(JsonContext*, int64_t);
+JsonNode* json_realCtx(JsonContext*, double);
+JsonNode* json_nullCtx(JsonContext*);
+JsonNode* json_stringCtx(JsonContext*, char*);
+JsonNode* json_stringNCtx(JsonContext*, const char*, ptrdiff_t length);
+bool json_object_setCtx(JsonContext*, JsonNode*, const char* key, JsonNode* value);
+bool json_object_setNCtx(JsonContext*, JsonNode*, const char* key, ptrdiff_t length, JsonNode* value);
+bool json_object_removeCtx(JsonContext*, JsonNode*, const char* key);
+bool json_array_insertCtx(JsonContext*, JsonNode*, ptrdiff_t index, JsonNode* value);
+bool json_array_removeCtx(JsonContext*, JsonNode*, ptrdiff_t index);
+bool json_array_replaceCtx(JsonContext*, JsonNode*, ptrdiff_t index, JsonNode* value);
 
 JsonNode* json_property(JsonNode*, char*);
-JsonNode* json_index(JsonNode*, ptrdiff_t);
-#define json_get(node, ...) json_get_impl(node, __VA_ARGS__, -1)
+JsonNode* json_index(JsonNode*, ptrdiff_t); // Unpacks a packed array, which changes it (see json_node_unpack)
+#define json_get(node, ...) json_get_impl(node, __VA_ARGS__, (intptr_t)-1)
 JsonNode* json_get_impl(JsonNode*, ...); // NOTE: call the macro wrapper instead
 
 #endif // JSON4C_TYPES
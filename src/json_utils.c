@@ -1,34 +1,45 @@
 #include <string.h>
+#include <stdlib.h>
+#include <math.h>
 
 #include "json_utils.h"
-#include "json_allocator.h"
+#include "json_context.h"
 #include "json_error.h"
 #include "json_config.h"
 
-void json_utils_ensureCapacity_impl(void** ptr, size_t size, ptrdiff_t* capacity, ptrdiff_t count) {
+static bool _reserve(JsonContext*, char**, ptrdiff_t*, ptrdiff_t);
+// What gets escaped, besides '"', '\\' and control characters
+typedef enum EscapeMode {
+	ESCAPE_SOLIDUS,	// '/' too, the library's default
+	ESCAPE_ASCII,	// '/' and everything above U+007F
+	ESCAPE_MINIMAL	// Nothing else
+} EscapeMode;
+
+static ptrdiff_t _escapedLength(const char*, ptrdiff_t, EscapeMode);
+static void _escapeInto(char*, const char*, ptrdiff_t, EscapeMode);
+static uint32_t _parseHex4(const char*, ptrdiff_t);
+static bool _appendEscaped(JsonContext*, char**, ptrdiff_t*, ptrdiff_t*, const char*, ptrdiff_t, EscapeMode);
+
+
+void json_utils_ensureCapacity_impl(JsonContext* ctx, void** ptr, size_t size, ptrdiff_t* capacity, ptrdiff_t count) {
 	if (count < *capacity || !ptr || !(*ptr)) return;
 	ptrdiff_t newCapacity = *capacity == 1 ? 8 : *capacity * JSON_DYNAMIC_ARRAY_GROW_BY;
-	void* temp = json_allocator.realloc(
-		*ptr,
-		newCapacity * size,
-		*capacity * size,
-		json_allocator.context
-	);
+	void* temp = json_context_realloc(ctx, *ptr, newCapacity * size, *capacity * size);
 	if (!temp) {
-		json_error_report("JSON_ERROR: json_utils_ensureCapacity failed, realloc returned NULL");
+		json_error_reportCtx(ctx, "JSON_ERROR: json_utils_ensureCapacity failed, realloc returned NULL");
 		return;
 	}
 	*ptr = temp;
 	*capacity = newCapacity;
 }
 
-void json_utils_dynAppendStr_impl(char** buffer, ptrdiff_t* length, ptrdiff_t* offset, char** strings) {
+void json_utils_dynAppendStr_impl(JsonContext* ctx, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, char** strings) {
 	ptrdiff_t i = 0;
 	char* currentString = strings[i];
 	while (currentString != NULL) {
 		ptrdiff_t j;
 		for (j = 0; currentString[j] != '\0'; j++) {
-			json_utils_ensureCapacity(buffer, length, *offset);
+			json_utils_ensureCapacityCtx(ctx, buffer, length, *offset);
 			(*buffer)[(*offset)++] = currentString[j]; 
 		}
 		i++;
@@ -36,6 +47,96 @@ void json_utils_dynAppendStr_impl(char** buffer, ptrdiff_t* length, ptrdiff_t* o
 	}
 }
 
+bool json_utils_dynAppendN(char** buffer, ptrdiff_t* length, ptrdiff_t* offset, const char* string, ptrdiff_t count) {
+	return json_utils_dynAppendNCtx(json_context_default(), buffer, length, offset, string, count);
+}
+
+bool json_utils_dynAppendNCtx(JsonContext* ctx, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, const char* string, ptrdiff_t count) {
+	if (!_reserve(ctx, buffer, length, *offset + count)) return false;
+	memcpy(*buffer + *offset, string, count);
+	*offset += count;
+	return true;
+}
+
+bool json_utils_dynAppendEscaped(char** buffer, ptrdiff_t* length, ptrdiff_t* offset, const char* string, ptrdiff_t count) {
+	return json_utils_dynAppendEscapedCtx(json_context_default(), buffer, length, offset, string, count);
+}
+
+bool json_utils_dynAppendEscapedCtx(JsonContext* ctx, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, const char* string, ptrdiff_t count) {
+	return _appendEscaped(ctx, buffer, length, offset, string, count, ESCAPE_SOLIDUS);
+}
+
+bool json_utils_dynAppendAsciiEscaped(char** buffer, ptrdiff_t* length, ptrdiff_t* offset, const char* string, ptrdiff_t count) {
+	return json_utils_dynAppendAsciiEscapedCtx(json_context_default(), buffer, length, offset, string, count);
+}
+
+bool json_utils_dynAppendAsciiEscapedCtx(JsonContext* ctx, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, const char* string, ptrdiff_t count) {
+	return _appendEscaped(ctx, buffer, length, offset, string, count, ESCAPE_ASCII);
+}
+
+bool json_utils_dynAppendMinimalEscaped(char** buffer, ptrdiff_t* length, ptrdiff_t* offset, const char* string, ptrdiff_t count) {
+	return json_utils_dynAppendMinimalEscapedCtx(json_context_default(), buffer, length, offset, string, count);
+}
+
+bool json_utils_dynAppendMinimalEscapedCtx(JsonContext* ctx, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, const char* string, ptrdiff_t count) {
+	return _appendEscaped(ctx, buffer, length, offset, string, count, ESCAPE_MINIMAL);
+}
+
+
+ptrdiff_t json_utils_formatReal(double real, char* out) {
+	if (isnan(real) || isinf(real)) {
+		memcpy(out, "null", 5);
+		return 4;
+	}
+	if (real == 0.0) { // -0 included
+		memcpy(out, "0", 2);
+		return 1;
+	}
+	// The shortest precision that reads back the same gives the digits, and %e the decimal exponent
+	char scientific[JSON_UTILS_REAL_SIZE];
+	for (int precision = 1; precision <= 17; precision++) {
+		snprintf(scientific, sizeof(scientific), "%.*e", precision - 1, real);
+		if (strtod(scientific, NULL) == real) break;
+	}
+	char digits[18];
+	int digitCount = 0;
+	char* c = scientific + (real < 0);
+	for (; *c != 'e'; c++) {
+		if (*c != '.') digits[digitCount++] = *c;
+	}
+	while (digitCount > 1 && digits[digitCount - 1] == '0') digitCount--;
+	int exponent = atoi(c + 1) + 1; // The value is 0.digits * 10^exponent
+	ptrdiff_t length = 0;
+	if (real < 0) out[length++] = '-';
+	if (digitCount <= exponent && exponent <= 21) {
+		memcpy(out + length, digits, digitCount);
+		length += digitCount;
+		for (int i = digitCount; i < exponent; i++) out[length++] = '0';
+	} else if (0 < exponent && exponent <= 21) {
+		memcpy(out + length, digits, exponent);
+		length += exponent;
+		out[length++] = '.';
+		memcpy(out + length, digits + exponent, digitCount - exponent);
+		length += digitCount - exponent;
+	} else if (-6 < exponent && exponent <= 0) {
+		out[length++] = '0';
+		out[length++] = '.';
+		for (int i = exponent; i < 0; i++) out[length++] = '0';
+		memcpy(out + length, digits, digitCount);
+		length += digitCount;
+	} else {
+		out[length++] = digits[0];
+		if (digitCount > 1) {
+			out[length++] = '.';
+			memcpy(out + length, digits + 1, digitCount - 1);
+			length += digitCount - 1;
+		}
+		length += snprintf(out + length, JSON_UTILS_REAL_SIZE - length, "e%+d", exponent - 1);
+	}
+	out[length] = '\0';
+	return length;
+}
+
 
 char json_utils_unescapeChar(char* bytes) {
 	if (*bytes != '\\') return '\0';
@@ -58,15 +159,103 @@ char json_utils_unescapeChar(char* bytes) {
 		case '\\':
 			return '\\';
 		default:
-			json_error_report("JSON_ERROR: json_utils_unescapeChar returned '\\0', invalid input");
-			return '\0';
+			return '\0'; // invalid input
+	}
+}
+
+ptrdiff_t json_utils_unescape(const char* bytes, ptrdiff_t length, char* out, ptrdiff_t* written) {
+	if (length < 2 || bytes[0] != '\\') return 0;
+	if (bytes[1] != 'u') {
+		char character = json_utils_unescapeChar((char*)bytes);
+		if (character == '\0') return 0;
+		*out = character;
+		*written = 1;
+		return 2;
+	}
+	uint32_t codepoint = _parseHex4(bytes + 2, length - 2);
+	ptrdiff_t used = 6;
+	if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) return 0; // A low surrogate on its own
+	if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+		if (length < 12 || bytes[6] != '\\' || bytes[7] != 'u') return 0;
+		uint32_t low = _parseHex4(bytes + 8, length - 8);
+		if (low < 0xDC00 || low > 0xDFFF) return 0;
+		codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+		used = 12;
+	} else if (codepoint > 0xFFFF) {
+		return 0;
+	}
+	*written = json_utils_utf8Encode(codepoint, out);
+	return used;
+}
+
+ptrdiff_t json_utils_utf8Decode(const char* bytes, ptrdiff_t length, uint32_t* codepoint) {
+	const unsigned char* s = (const unsigned char*)bytes;
+	if (length < 1) return 0;
+	if (s[0] < 0x80) {
+		if (codepoint) *codepoint = s[0];
+		return 1;
+	}
+	// The second byte's range is what rules out overlong forms, surrogates and codepoints above U+10FFFF
+	ptrdiff_t sequenceLength;
+	unsigned char low = 0x80, high = 0xBF;
+	uint32_t value;
+	if (s[0] >= 0xC2 && s[0] <= 0xDF) {
+		sequenceLength = 2;
+		value = s[0] & 0x1F;
+	} else if (s[0] >= 0xE0 && s[0] <= 0xEF) {
+		sequenceLength = 3;
+		value = s[0] & 0x0F;
+		if (s[0] == 0xE0) low = 0xA0;
+		if (s[0] == 0xED) high = 0x9F;
+	} else if (s[0] >= 0xF0 && s[0] <= 0xF4) {
+		sequenceLength = 4;
+		value = s[0] & 0x07;
+		if (s[0] == 0xF0) low = 0x90;
+		if (s[0] == 0xF4) high = 0x8F;
+	} else {
+		return 0;
+	}
+	if (length < sequenceLength || s[1] < low || s[1] > high) return 0;
+	value = (value << 6) | (s[1] & 0x3F);
+	for (ptrdiff_t i = 2; i < sequenceLength; i++) {
+		if ((s[i] & 0xC0) != 0x80) return 0;
+		value = (value << 6) | (s[i] & 0x3F);
 	}
+	if (codepoint) *codepoint = value;
+	return sequenceLength;
+}
+
+ptrdiff_t json_utils_utf8Encode(uint32_t codepoint, char* out) {
+	if (codepoint < 0x80) {
+		out[0] = (char)codepoint;
+		return 1;
+	}
+	if (codepoint < 0x800) {
+		out[0] = (char)(0xC0 | (codepoint >> 6));
+		out[1] = (char)(0x80 | (codepoint & 0x3F));
+		return 2;
+	}
+	if (codepoint < 0x10000) {
+		out[0] = (char)(0xE0 | (codepoint >> 12));
+		out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+		out[2] = (char)(0x80 | (codepoint & 0x3F));
+		return 3;
+	}
+	out[0] = (char)(0xF0 | (codepoint >> 18));
+	out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+	out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+	out[3] = (char)(0x80 | (codepoint & 0x3F));
+	return 4;
 }
 
 char* json_utils_escapeChar(char character) {
-	char* string = json_allocator.alloc(3, json_allocator.context);
+	return json_utils_escapeCharCtx(json_context_default(), character);
+}
+
+char* json_utils_escapeCharCtx(JsonContext* ctx, char character) {
+	char* string = json_context_alloc(ctx, 3);
 	if (!string) {
-		json_error_reportCritical("JSON_ERROR: json_utils_escapeChar failed, alloc returned NULL");
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_utils_escapeChar failed, alloc returned NULL");
 		return NULL;
 	}
 	switch (character) {
@@ -87,64 +276,157 @@ char* json_utils_escapeChar(char character) {
 		case '"':
 			return strcpy(string, "\\\"");
 		default:
-			json_error_report("JSON_ERROR: json_utils_escapeChar returned NULL, invalid input");
-			json_allocator.free(string, 3, json_allocator.context);
+			json_error_reportCtx(ctx, "JSON_ERROR: json_utils_escapeChar returned NULL, invalid input");
+			json_context_free(ctx, string, 3);
 			return NULL;
 	}
 }
 
-static bool _isEscapable(char c) {
-	return c == '\t' || c == '\r' || c == '\n' || c == '\b' || c == '\f' || c == '/' || c == '\\';
+char* json_utils_toEscaped(char* string) {
+	return json_utils_toEscapedCtx(json_context_default(), string);
 }
 
-char* json_utils_toEscaped(char* string) {
-	ptrdiff_t addedMemory = 0;
-	ptrdiff_t i;
-	for (i = 0; string[i] != '\0'; i++) {
-		if (_isEscapable(string[i]))
-			addedMemory++;
-	}
-	char* newString = json_allocator.alloc(i + addedMemory + 1, json_allocator.context);
+char* json_utils_toEscapedCtx(JsonContext* ctx, char* string) {
+	ptrdiff_t length = strlen(string);
+	ptrdiff_t escapedLength = _escapedLength(string, length, ESCAPE_SOLIDUS);
+	char* newString = json_context_alloc(ctx, escapedLength + 1);
 	if (!newString) {
-		json_error_reportCritical("JSON_ERROR: json_utils_toEscaped failed, alloc returned NULL");
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_utils_toEscaped failed, alloc returned NULL");
 		return NULL;
 	}
+	_escapeInto(newString, string, length, ESCAPE_SOLIDUS);
+	newString[escapedLength] = '\0';
+	return newString;
+}
+
+
+// Grows the buffer until it can hold 'needed' bytes.
+static bool _reserve(JsonContext* ctx, char** buffer, ptrdiff_t* length, ptrdiff_t needed) {
+	if (needed <= *length) return true;
+	ptrdiff_t newLength = *length > 0 ? *length : JSON_BUFFER_CAPACITY;
+	while (newLength < needed) {
+		newLength *= JSON_DYNAMIC_ARRAY_GROW_BY;
+	}
+	char* temp = json_context_realloc(ctx, *buffer, newLength, *length);
+	if (!temp) {
+		json_error_reportCriticalCtx(ctx, "JSON_ERROR: json_utils_dynAppend failed, realloc returned NULL");
+		return false;
+	}
+	*buffer = temp;
+	*length = newLength;
+	return true;
+}
+
+static bool _appendEscaped
+	(JsonContext* ctx, char** buffer, ptrdiff_t* length, ptrdiff_t* offset, const char* string, ptrdiff_t count, EscapeMode mode) {
+	ptrdiff_t escapedLength = _escapedLength(string, count, mode);
+	if (escapedLength == count)
+		return json_utils_dynAppendNCtx(ctx, buffer, length, offset, string, count);
+	if (!_reserve(ctx, buffer, length, *offset + escapedLength)) return false;
+	_escapeInto(*buffer + *offset, string, count, mode);
+	*offset += escapedLength;
+	return true;
+}
+
+// NOTE: Other control characters, '\0' included, are written as \u00XX. With ESCAPE_ASCII, so is everything from
+// U+0080 up (as a surrogate pair above U+FFFF), and a byte that isn't part of valid UTF-8 becomes \ufffd.
+static ptrdiff_t _escapedLength(const char* string, ptrdiff_t length, EscapeMode mode) {
+	ptrdiff_t escapedLength = length;
+	for (ptrdiff_t i = 0; i < length; i++) {
+		unsigned char c = string[i];
+		if (c == '"' || c == '\\' || c == '\t' || c == '\r' || c == '\n' || c == '\b' || c == '\f') {
+			escapedLength += 1;
+		} else if (c == '/') {
+			escapedLength += mode != ESCAPE_MINIMAL;
+		} else if (c < 0x20) {
+			escapedLength += 5;
+		} else if (c >= 0x80 && mode == ESCAPE_ASCII) {
+			ptrdiff_t sequenceLength = json_utils_utf8Decode(string + i, length - i, NULL);
+			if (sequenceLength == 0) sequenceLength = 1;
+			// Only 4 byte sequences are above U+FFFF
+			escapedLength += (sequenceLength == 4 ? 12 : 6) - sequenceLength;
+			i += sequenceLength - 1;
+		}
+	}
+	return escapedLength;
+}
+
+static void _escapeInto(char* out, const char* string, ptrdiff_t length, EscapeMode mode) {
+	static const char hex[] = "0123456789abcdef";
 	ptrdiff_t offset = 0;
-	for (i = 0; string[i] != '\0'; i++, offset++) {
-		if (!_isEscapable(string[i])) {
-			newString[offset] = string[i];
+	for (ptrdiff_t i = 0; i < length; i++) {
+		unsigned char c = string[i];
+		if (c >= 0x80 && mode == ESCAPE_ASCII) {
+			uint32_t codepoint;
+			ptrdiff_t sequenceLength = json_utils_utf8Decode(string + i, length - i, &codepoint);
+			if (sequenceLength == 0) {
+				sequenceLength = 1;
+				codepoint = 0xFFFD;
+			}
+			uint32_t units[2] = { codepoint, 0 };
+			int unitCount = 1;
+			if (codepoint > 0xFFFF) {
+				units[0] = 0xD800 + ((codepoint - 0x10000) >> 10);
+				units[1] = 0xDC00 + ((codepoint - 0x10000) & 0x3FF);
+				unitCount = 2;
+			}
+			for (int k = 0; k < unitCount; k++) {
+				out[offset++] = '\\';
+				out[offset++] = 'u';
+				out[offset++] = hex[(units[k] >> 12) & 0xF];
+				out[offset++] = hex[(units[k] >> 8) & 0xF];
+				out[offset++] = hex[(units[k] >> 4) & 0xF];
+				out[offset++] = hex[units[k] & 0xF];
+			}
+			i += sequenceLength - 1;
 			continue;
 		}
-		newString[offset++] = '\\';
-		switch (string[i]) {
-			case '\t':
-				newString[offset] = 't';
-				break;
-			case '\r':
-				newString[offset] = 'r';
-				break;
-			case '\n':
-				newString[offset] = 'n';
-				break;
-			case '\b':
-				newString[offset] = 'b';
-				break;
-			case '\f':
-				newString[offset] = 'f';
-				break;
-			case '\\':
-				newString[offset] = '\\';
-				break;
+		char escaped;
+		switch (c) {
+			case '"': escaped = '"'; break;
+			case '\\': escaped = '\\'; break;
 			case '/':
-				newString[offset] = '/';
-				break;
-			case '"':
-				newString[offset] = '"';
+				if (mode == ESCAPE_MINIMAL) {
+					out[offset++] = c;
+					continue;
+				}
+				escaped = '/';
 				break;
+			case '\t': escaped = 't'; break;
+			case '\r': escaped = 'r'; break;
+			case '\n': escaped = 'n'; break;
+			case '\b': escaped = 'b'; break;
+			case '\f': escaped = 'f'; break;
+			default:
+				if (c < 0x20) {
+					memcpy(out + offset, "\\u00", 4);
+					out[offset + 4] = hex[c >> 4];
+					out[offset + 5] = hex[c & 0xF];
+					offset += 6;
+				} else {
+					out[offset++] = c;
+				}
+				continue;
 		}
+		out[offset++] = '\\';
+		out[offset++] = escaped;
 	}
-	newString[offset] = '\0';
-	return newString;
+}
+
+// Returns the value of 4 hex digits, or 0x110000 (past any codepoint) if they aren't.
+static uint32_t _parseHex4(const char* bytes, ptrdiff_t length) {
+	if (length < 4) return 0x110000;
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++) {
+		char c = bytes[i];
+		uint32_t digit;
+		if (c >= '0' && c <= '9') digit = c - '0';
+		else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+		else return 0x110000;
+		value = (value << 4) | digit;
+	}
+	return value;
 }
 
 
@@ -4,18 +4,53 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#include "json_context.h"
 
 #define json_utils_ensureCapacity(ptr, capacity, count)			\
-	json_utils_ensureCapacity_impl((void**)ptr, sizeof(*(*(ptr))), capacity, count)
-void json_utils_ensureCapacity_impl(void**, size_t, ptrdiff_t*, ptrdiff_t);
+	json_utils_ensureCapacityCtx(json_context_default(), ptr, capacity, count)
+#define json_utils_ensureCapacityCtx(ctx, ptr, capacity, count)	\
+	json_utils_ensureCapacity_impl(ctx, (void**)ptr, sizeof(*(*(ptr))), capacity, count)
+void json_utils_ensureCapacity_impl(JsonContext*, void**, size_t, ptrdiff_t*, ptrdiff_t);
 
 #define json_utils_dynAppendStr(bufferptr, lengthptr, offsetptr, ...)	\
-	json_utils_dynAppendStr_impl(bufferptr, lengthptr, offsetptr, (char*[]){__VA_ARGS__, NULL})
-void json_utils_dynAppendStr_impl(char**, ptrdiff_t*, ptrdiff_t*, char**);
+	json_utils_dynAppendStrCtx(json_context_default(), bufferptr, lengthptr, offsetptr, __VA_ARGS__)
+#define json_utils_dynAppendStrCtx(ctx, bufferptr, lengthptr, offsetptr, ...)	\
+	json_utils_dynAppendStr_impl(ctx, bufferptr, lengthptr, offsetptr, (char*[]){__VA_ARGS__, NULL})
+void json_utils_dynAppendStr_impl(JsonContext*, char**, ptrdiff_t*, ptrdiff_t*, char**);
+// Length-aware appends, these copy the whole string at once and report whether the buffer could grow.
+// NOTE: dynAppendEscaped writes the JSON escaped form, so the string may contain '\0'.
+bool json_utils_dynAppendN(char**, ptrdiff_t*, ptrdiff_t*, const char*, ptrdiff_t);
+bool json_utils_dynAppendEscaped(char**, ptrdiff_t*, ptrdiff_t*, const char*, ptrdiff_t);
+bool json_utils_dynAppendNCtx(JsonContext*, char**, ptrdiff_t*, ptrdiff_t*, const char*, ptrdiff_t);
+bool json_utils_dynAppendEscapedCtx(JsonContext*, char**, ptrdiff_t*, ptrdiff_t*, const char*, ptrdiff_t);
+// Like dynAppendEscaped, but everything outside ASCII is written as \uXXXX (bytes that aren't UTF-8 as \ufffd).
+bool json_utils_dynAppendAsciiEscaped(char**, ptrdiff_t*, ptrdiff_t*, const char*, ptrdiff_t);
+bool json_utils_dynAppendAsciiEscapedCtx(JsonContext*, char**, ptrdiff_t*, ptrdiff_t*, const char*, ptrdiff_t);
+// Like dynAppendEscaped, but only escapes what JSON requires ('"', '\\' and control characters), as RFC 8785 does.
+bool json_utils_dynAppendMinimalEscaped(char**, ptrdiff_t*, ptrdiff_t*, const char*, ptrdiff_t);
+bool json_utils_dynAppendMinimalEscapedCtx(JsonContext*, char**, ptrdiff_t*, ptrdiff_t*, const char*, ptrdiff_t);
+
+// Writes the shortest text that reads back as exactly 'real', formatted like JavaScript's Number.prototype.toString
+// (RFC 8785), into 'out', which has room for JSON_UTILS_REAL_SIZE chars, and returns its length. NaN and infinities,
+// which JSON can't hold, are written as null.
+#define JSON_UTILS_REAL_SIZE 32
+ptrdiff_t json_utils_formatReal(double real, char* out);
 
 char json_utils_unescapeChar(char*);
+// Decodes the escape sequence at 'bytes' (\uXXXX and surrogate pairs included) into at most 4 UTF-8 bytes.
+// Returns how many of the 'length' bytes it used and sets *written, or returns 0 if the escape is invalid.
+ptrdiff_t json_utils_unescape(const char* bytes, ptrdiff_t length, char* out, ptrdiff_t* written);
+// Returns the length of the UTF-8 sequence at 'bytes' and sets *codepoint (if not NULL), or 0 if it's invalid
+// (overlong, a surrogate, above U+10FFFF or cut short).
+ptrdiff_t json_utils_utf8Decode(const char* bytes, ptrdiff_t length, uint32_t* codepoint);
+// Writes the codepoint as UTF-8 into 'out', which has room for 4 bytes, and returns the length.
+ptrdiff_t json_utils_utf8Encode(uint32_t codepoint, char* out);
 char* json_utils_escapeChar(char);
 char* json_utils_toEscaped(char*);
+char* json_utils_escapeCharCtx(JsonContext*, char);
+char* json_utils_toEscapedCtx(JsonContext*, char*);
 
 bool json_buf_expect(char, char*, ptrdiff_t, ptrdiff_t*);
 char json_buf_get(char*, ptrdiff_t, ptrdiff_t*);
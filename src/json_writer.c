@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+
+#include "json_writer.h"
+#include "json_utils.h"
+
+// What's open at a depth, one byte per level
+#define LEVEL_OBJECT	(1 << 0)
+#define LEVEL_FILLED	(1 << 1) // Has a value (or, in an object, a key) written already
+#define LEVEL_KEYED		(1 << 2) // An object whose last key is waiting for its value
+#define LEVEL_FINISHED	(1 << 3) // Only at levels[0], once json_writer_finish has checked the document
+
+static JsonWriter* _createWriter(JsonContext*, JsonSink, enum JsonWriteOption);
+static bool _begin(JsonWriter*, bool isObject);
+static bool _end(JsonWriter*, bool isObject);
+static bool _beginValue(JsonWriter*);
+static bool _separate(JsonWriter*);
+static bool _put(JsonWriter*, const char*, ptrdiff_t);
+static bool _putEscaped(JsonWriter*, const char*, ptrdiff_t);
+static bool _putIndent(JsonWriter*, ptrdiff_t depth);
+static bool _passOn(JsonWriter*, ptrdiff_t above);
+static bool _refuse(JsonWriter*, JsonErrorCode);
+
+
+JsonWriter* json_writer_create(enum JsonWriteOption option) {
+	return json_writer_createCtx(json_context_default(), option);
+}
+
+JsonWriter* json_writer_createCtx(JsonContext* ctx, enum JsonWriteOption option) {
+	return _createWriter(ctx, (JsonSink){ NULL, NULL }, option);
+}
+
+JsonWriter* json_writer_createSink(JsonSink sink, enum JsonWriteOption option) {
+	return json_writer_createSinkCtx(json_context_default(), sink, option);
+}
+
+JsonWriter* json_writer_createSinkCtx(JsonContext* ctx, JsonSink sink, enum JsonWriteOption option) {
+	if (!sink.write) return NULL;
+	return _createWriter(ctx, sink, option);
+}
+
+void json_writer_reset(JsonWriter* writer) {
+	if (!writer) return;
+	writer->offset = 0;
+	writer->flushed = 0;
+	writer->error = (JsonError){ JSON_ERROR_NONE, 0, 0, 0 };
+	writer->depth = 0;
+	writer->levels[0] = 0;
+}
+
+void json_writer_destroy(JsonWriter* writer) {
+	if (!writer) return;
+	json_context_free(writer->ctx, writer->buffer, writer->length);
+	json_context_free(writer->ctx, writer, sizeof(JsonWriter));
+}
+
+
+bool json_writer_beginObject(JsonWriter* writer) {
+	return _begin(writer, true);
+}
+
+bool json_writer_endObject(JsonWriter* writer) {
+	return _end(writer, true);
+}
+
+bool json_writer_beginArray(JsonWriter* writer) {
+	return _begin(writer, false);
+}
+
+bool json_writer_endArray(JsonWriter* writer) {
+	return _end(writer, false);
+}
+
+bool json_writer_key(JsonWriter* writer, const char* key) {
+	return json_writer_keyN(writer, key, key ? (ptrdiff_t)strlen(key) : 0);
+}
+
+bool json_writer_keyN(JsonWriter* writer, const char* key, ptrdiff_t length) {
+	if (!writer || writer->error.code != JSON_ERROR_NONE) return false;
+	uint8_t* level = &writer->levels[writer->depth];
+	if (!key || length < 0 || !(*level & LEVEL_OBJECT) || (*level & LEVEL_KEYED))
+		return _refuse(writer, JSON_ERROR_INVALID_WRITE);
+	*level |= LEVEL_KEYED;
+	return _separate(writer)
+		&& _put(writer, "\"", 1)
+		&& _putEscaped(writer, key, length)
+		&& (writer->pretty ? _put(writer, "\": ", 3) : _put(writer, "\":", 2))
+		&& _passOn(writer, JSON_SINK_BUFFER_SIZE);
+}
+
+bool json_writer_int64(JsonWriter* writer, int64_t integer) {
+	char tempBuffer[21]; // 20 characters is exactly enough to hold int64_t min-value
+	int length = sprintf(tempBuffer, "%" PRId64, integer);
+	return _beginValue(writer) && _put(writer, tempBuffer, length) && _passOn(writer, JSON_SINK_BUFFER_SIZE);
+}
+
+// NOTE: Formatted like the serializer formats reals, so the output is the same as writing a tree. JSON has no
+// NaN or infinities, so those are refused rather than written as "nan" or "inf".
+bool json_writer_real(JsonWriter* writer, double real) {
+	if (writer && !isfinite(real)) return _refuse(writer, JSON_ERROR_INVALID_WRITE);
+	char tempBuffer[25]; // 24 characters is enough to hold a %g formatted double
+	int length = sprintf(tempBuffer, "%g", real);
+	return _beginValue(writer) && _put(writer, tempBuffer, length) && _passOn(writer, JSON_SINK_BUFFER_SIZE);
+}
+
+bool json_writer_string(JsonWriter* writer, const char* string) {
+	if (!string) return writer && _refuse(writer, JSON_ERROR_INVALID_WRITE);
+	return json_writer_stringN(writer, string, strlen(string));
+}
+
+bool json_writer_stringN(JsonWriter* writer, const char* string, ptrdiff_t length) {
+	if (writer && (!string || length < 0)) return _refuse(writer, JSON_ERROR_INVALID_WRITE);
+	return _beginValue(writer)
+		&& _put(writer, "\"", 1)
+		&& _putEscaped(writer, string, length)
+		&& _put(writer, "\"", 1)
+		&& _passOn(writer, JSON_SINK_BUFFER_SIZE);
+}
+
+bool json_writer_bool(JsonWriter* writer, bool boolean) {
+	return _beginValue(writer)
+		&& (boolean ? _put(writer, "true", 4) : _put(writer, "false", 5))
+		&& _passOn(writer, JSON_SINK_BUFFER_SIZE);
+}
+
+bool json_writer_null(JsonWriter* writer) {
+	return _beginValue(writer) && _put(writer, "null", 4) && _passOn(writer, JSON_SINK_BUFFER_SIZE);
+}
+
+
+bool json_writer_finish(JsonWriter* writer) {
+	if (!writer || writer->error.code != JSON_ERROR_NONE) return false;
+	if (writer->depth != 0 || !(writer->levels[0] & LEVEL_FILLED))
+		return _refuse(writer, JSON_ERROR_INVALID_WRITE);
+	if (writer->sink.write) {
+		if (!_passOn(writer, 0)) return false;
+	} else {
+		if (!_put(writer, "", 1)) return false; // The terminator, which isn't part of the text
+		writer->offset--;
+	}
+	writer->levels[0] |= LEVEL_FINISHED;
+	return true;
+}
+
+const char* json_writer_text(JsonWriter* writer, ptrdiff_t* length) {
+	if (!writer || writer->sink.write || !(writer->levels[0] & LEVEL_FINISHED)) return NULL;
+	if (length) {
+		*length = writer->offset;
+	}
+	return writer->buffer;
+}
+
+
+static JsonWriter* _createWriter(JsonContext* ctx, JsonSink sink, enum JsonWriteOption option) {
+	int flags = option & JSON_WRITE_ASCII;
+	option = (enum JsonWriteOption)(option & ~flags);
+	if (option != JSON_WRITE_PRETTY && option != JSON_WRITE_CONDENSED) return NULL;
+	JsonWriter* writer = json_context_alloc(ctx, sizeof(JsonWriter));
+	if (!writer) return NULL;
+	writer->ctx = ctx;
+	writer->sink = sink;
+	writer->pretty = option == JSON_WRITE_PRETTY;
+	writer->flags = flags;
+	writer->buffer = NULL; // Allocated by the first write
+	writer->length = 0;
+	json_writer_reset(writer);
+	return writer;
+}
+
+// Opens a container, as the next value
+static bool _begin(JsonWriter* writer, bool isObject) {
+	if (!_beginValue(writer)) return false;
+	if (writer->depth >= JSON_WRITER_MAX_DEPTH)
+		return _refuse(writer, JSON_ERROR_INVALID_WRITE);
+	writer->levels[++writer->depth] = isObject ? LEVEL_OBJECT : 0;
+	return (isObject ? _put(writer, "{", 1) : _put(writer, "[", 1)) && _passOn(writer, JSON_SINK_BUFFER_SIZE);
+}
+
+// Closes the container that's open, which has to be the kind asked for. An empty one stays on one line.
+static bool _end(JsonWriter* writer, bool isObject) {
+	if (!writer || writer->error.code != JSON_ERROR_NONE) return false;
+	uint8_t level = writer->levels[writer->depth];
+	if (writer->depth == 0 || ((level & LEVEL_OBJECT) != 0) != isObject || (level & LEVEL_KEYED))
+		return _refuse(writer, JSON_ERROR_INVALID_WRITE);
+	writer->depth--;
+	if ((level & LEVEL_FILLED) && writer->pretty && !(_put(writer, "\n", 1) && _putIndent(writer, writer->depth)))
+		return false;
+	return (isObject ? _put(writer, "}", 1) : _put(writer, "]", 1)) && _passOn(writer, JSON_SINK_BUFFER_SIZE);
+}
+
+// Checks that a value can go next, and writes what goes before it. In an object that's all been written
+// with its key already.
+static bool _beginValue(JsonWriter* writer) {
+	if (!writer || writer->error.code != JSON_ERROR_NONE) return false;
+	uint8_t* level = &writer->levels[writer->depth];
+	if (*level & LEVEL_OBJECT) {
+		if (!(*level & LEVEL_KEYED))
+			return _refuse(writer, JSON_ERROR_INVALID_WRITE);
+		*level &= ~LEVEL_KEYED;
+		return true;
+	}
+	if (writer->depth == 0 && (*level & LEVEL_FILLED)) // A document has a single root value
+		return _refuse(writer, JSON_ERROR_INVALID_WRITE);
+	return _separate(writer);
+}
+
+// Writes the ',' after the previous value (if there's one) and, when pretty, the newline and indentation.
+static bool _separate(JsonWriter* writer) {
+	uint8_t* level = &writer->levels[writer->depth];
+	bool filled = *level & LEVEL_FILLED;
+	*level |= LEVEL_FILLED;
+	if (writer->depth == 0) return true;
+	if (filled && !_put(writer, ",", 1)) return false;
+	return !writer->pretty || (_put(writer, "\n", 1) && _putIndent(writer, writer->depth));
+}
+
+static bool _put(JsonWriter* writer, const char* bytes, ptrdiff_t length) {
+	if (json_utils_dynAppendNCtx(writer->ctx, &writer->buffer, &writer->length, &writer->offset, bytes, length)) return true;
+	return _refuse(writer, JSON_ERROR_OUT_OF_MEMORY);
+}
+
+static bool _putEscaped(JsonWriter* writer, const char* string, ptrdiff_t length) {
+	bool written = (writer->flags & JSON_WRITE_ASCII)
+		? json_utils_dynAppendAsciiEscapedCtx(writer->ctx, &writer->buffer, &writer->length, &writer->offset, string, length)
+		: json_utils_dynAppendEscapedCtx(writer->ctx, &writer->buffer, &writer->length, &writer->offset, string, length);
+	return written || _refuse(writer, JSON_ERROR_OUT_OF_MEMORY);
+}
+
+static bool _putIndent(JsonWriter* writer, ptrdiff_t depth) {
+	static const char tabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+	const ptrdiff_t tabCount = sizeof(tabs) - 1;
+	for (; depth > tabCount; depth -= tabCount) {
+		if (!_put(writer, tabs, tabCount)) return false;
+	}
+	return _put(writer, tabs, depth);
+}
+
+// Gives the buffer to the sink once it holds more than 'above' bytes, so it's written in blocks. Without
+// a sink the whole document stays in the buffer.
+static bool _passOn(JsonWriter* writer, ptrdiff_t above) {
+	if (!writer->sink.write || writer->offset <= above) return true;
+	if (!writer->sink.write(writer->sink.user, writer->buffer, writer->offset))
+		return _refuse(writer, JSON_ERROR_OUTPUT);
+	writer->flushed += writer->offset;
+	writer->offset = 0;
+	return true;
+}
+
+// Fails the writer, the first failure is the one kept. Always false.
+static bool _refuse(JsonWriter* writer, JsonErrorCode code) {
+	if (writer->error.code == JSON_ERROR_NONE) {
+		writer->error = (JsonError){ code, writer->flushed + writer->offset, 0, 0 };
+		if (code != JSON_ERROR_OUT_OF_MEMORY) { // Running out has been reported already, by the append
+			json_error_reportCtx(writer->ctx, json_error_message(code));
+		}
+	}
+	return false;
+}
@@ -0,0 +1,91 @@
+/*
+	A JsonWriter writes a document straight from calls, without building it as nodes first, so nothing is
+	allocated besides its output buffer. The buffer is kept between documents, so a writer reused for many
+	responses stops allocating once it's written the largest of them.
+
+		JsonWriter* writer = json_writer_create(JSON_WRITE_CONDENSED);
+		while (...) {
+			json_writer_beginObject(writer);
+			json_writer_key(writer, "id");
+			json_writer_int64(writer, id);
+			json_writer_key(writer, "tags");
+			json_writer_beginArray(writer);
+			json_writer_string(writer, "new");
+			json_writer_endArray(writer);
+			json_writer_endObject(writer);
+			if (json_writer_finish(writer)) {
+				ptrdiff_t length;
+				const char* text = json_writer_text(writer, &length);
+				...
+			}
+			json_writer_reset(writer);
+		}
+		json_writer_destroy(writer);
+
+	Condensed, its output is what json_toString writes for the same document built as nodes, pretty it's laid out
+	like json_reformat lays documents out (reals are formatted like the serializer formats them). The calls are checked
+	against where they are in the document (a key only in an object and before each of its values, an end only for
+	the container that's open, a single root value), and reals have to be finite. The first call out of place or
+	failing to write fails the writer, and every call after it is ignored. They all return false then, and
+	writer->error says what went wrong.
+	A writer created with a sink gives it the output in blocks of JSON_SINK_BUFFER_SIZE bytes or so as it's written,
+	so the buffer stays at most twice that size (unless a single string is longer) however long the document is.
+
+	NOTE: Only JSON_WRITE_PRETTY and JSON_WRITE_CONDENSED (with or without JSON_WRITE_ASCII) are supported,
+	canonical output needs every member of an object before it can write any of them. Containers can be nested
+	JSON_WRITER_MAX_DEPTH deep. Like a context, a writer isn't synchronized.
+*/
+
+#ifndef JSON4C_WRITER
+#define JSON4C_WRITER
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "json_config.h"
+#include "json_context.h"
+#include "json_error.h"
+#include "json_serializer.h"
+
+typedef struct JsonWriter {
+	JsonContext* ctx; // allocated the writer and its buffer
+	JsonSink sink; // sink.write is NULL when the document is kept in the buffer
+	bool pretty;
+	int flags; // The JSON_WRITE_ASCII bit of the option
+	char* buffer;
+	ptrdiff_t length;
+	ptrdiff_t offset;
+	ptrdiff_t flushed; // Bytes given to the sink so far
+	JsonError error; // 'offset' is where in the output the failed call would have written
+	ptrdiff_t depth;
+	uint8_t levels[JSON_WRITER_MAX_DEPTH + 1]; // What's open at each depth, levels[0] is the document itself
+} JsonWriter;
+
+JsonWriter* json_writer_create(enum JsonWriteOption);
+JsonWriter* json_writer_createCtx(JsonContext*, enum JsonWriteOption);
+JsonWriter* json_writer_createSink(JsonSink, enum JsonWriteOption);
+JsonWriter* json_writer_createSinkCtx(JsonContext*, JsonSink, enum JsonWriteOption);
+void json_writer_reset(JsonWriter*); // Starts the next document, keeping the buffer
+void json_writer_destroy(JsonWriter*);
+
+bool json_writer_beginObject(JsonWriter*);
+bool json_writer_endObject(JsonWriter*);
+bool json_writer_beginArray(JsonWriter*);
+bool json_writer_endArray(JsonWriter*);
+bool json_writer_key(JsonWriter*, const char* key);
+bool json_writer_keyN(JsonWriter*, const char* key, ptrdiff_t length); // The key may contain '\0'
+bool json_writer_int64(JsonWriter*, int64_t);
+bool json_writer_real(JsonWriter*, double);
+bool json_writer_string(JsonWriter*, const char* string);
+bool json_writer_stringN(JsonWriter*, const char* string, ptrdiff_t length); // The string may contain '\0'
+bool json_writer_bool(JsonWriter*, bool);
+bool json_writer_null(JsonWriter*);
+
+// Checks that the root value is complete, and gives what's left of it to the sink, if there's one.
+bool json_writer_finish(JsonWriter*);
+// The finished document, '\0' terminated, NULL for a writer with a sink or one that failed.
+// NOTE: The text belongs to the writer, it stays valid until json_writer_reset or json_writer_destroy.
+const char* json_writer_text(JsonWriter*, ptrdiff_t* length);
+
+#endif // JSON4C_WRITER
@@ -1,13 +1,17 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 
 #include "../src/json.h"
 #include "json_tests.h"
 
+int json_failedExpectations = 0;
+
 #define EXPECT(x, y)															\
 	do {																		\
-		if (x != y) {															\
+		if ((x) != (y)) {														\
+			json_failedExpectations++;											\
 			fprintf(															\
 				stderr, 														\
 				"Assertion failed: " #x " == " #y ", in %s at [%s:%d]\n", 		\
@@ -31,6 +35,13 @@ void json_runTests(void) {
 	json_runParserTests(); 
 	json_runSerializerTests();
 	json_runUtilsTests();
+	json_runContextTests();
+	json_runStatsTests();
+	json_runPoolTests();
+	json_runSharedTests();
+	json_runHashTests();
+	json_runPatchTests();
+	json_runWriterTests();
 }
 
 // Tests to ensure node construction behaves as intended.
@@ -38,7 +49,8 @@ void json_runNodeTests(void) {
 	JsonNode* array = json_node_create(NULL, (JsonValue){JSON_ARRAY, {0}});
 	EXPECT(IS_ARRAY(array),				TO_BE(true));
 	EXPECT(array->identifier, 			TO_BE(NULL));
-	EXPECT(AS_ARRAY(array).max,			TO_BE(JSON_DYNAMIC_ARRAY_CAPACITY));
+	EXPECT(AS_ARRAY(array).max,			TO_BE(JSON_INLINE_CHILDREN));
+	EXPECT(HAS_INLINE_CHILDREN(array),	TO_BE(true));
 	EXPECT(AS_ARRAY(array).count, 		TO_BE(0));
 	EXPECT(array->value.type, 			TO_BE(JSON_ARRAY));
 	
@@ -53,7 +65,8 @@ void json_runNodeTests(void) {
 		json_node_append(array, node);
 	}
 	ptrdiff_t count = json_node_childrenCount(array);
-	EXPECT(AS_ARRAY(array).max, 		TO_BE(JSON_DYNAMIC_ARRAY_CAPACITY * JSON_DYNAMIC_ARRAY_GROW_BY));
+	EXPECT(AS_ARRAY(array).max >= count, TO_BE(true));
+	EXPECT(HAS_INLINE_CHILDREN(array),	TO_BE(false));
 	EXPECT(AS_ARRAY(array).count,		TO_BE(count));
 	
 	char* ip = "121.1265.75123";
@@ -78,6 +91,50 @@ void json_runNodeTests(void) {
 	EXPECT(isRefEqual,					TO_BE(true));
 	EXPECT(isUnequal,					TO_BE(true));
 	
+	// Short keys and strings share the node's inline buffer, longer ones get their own allocation
+	JsonNode* inlineObj = json_object("id", json_string("clancy"));
+	JsonNode* id = AS_OBJECT(inlineObj).nodes[0];
+	EXPECT(IS_INLINE_IDENTIFIER(id),	TO_BE(true));
+	EXPECT(IS_INLINE_STRING(id),		TO_BE(true));
+	EXPECT(strcmp(id->identifier, "id"), TO_BE(0));
+	EXPECT(strcmp(AS_STRING(id), "clancy"), TO_BE(0));
+	json_node_free(inlineObj);
+	char* longString = "a string that's too long to be stored inline";
+	JsonNode* longNode = json_string(longString);
+	EXPECT(IS_INLINE_STRING(longNode),	TO_BE(false));
+	EXPECT(strcmp(AS_STRING(longNode), longString), TO_BE(0));
+	json_node_free(longNode);
+	
+	// Changing a tree in place
+	JsonNode* settings = json_object("a", json_int(1), "b", json_int(2));
+	uint64_t hash = json_node_hash(settings, JSON_HASH_ORDERED);
+	EXPECT(json_object_set(settings, "a", json_string("one")), TO_BE(true));
+	EXPECT(json_object_set(settings, "c", json_int(3)), TO_BE(true));
+	EXPECT(json_node_hash(settings, JSON_HASH_ORDERED) == hash, TO_BE(false));
+	EXPECT(strcmp(AS_STRING(AS_OBJECT(settings).nodes[0]), "one"), TO_BE(0));
+	EXPECT(strcmp(AS_OBJECT(settings).nodes[2]->identifier, "c"), TO_BE(0));
+	EXPECT(json_object_remove(settings, "b"), TO_BE(true));
+	EXPECT(json_object_remove(settings, "b"), TO_BE(false));
+	EXPECT(AS_OBJECT(settings).count,	TO_BE(2));
+	JsonNode* list = json_array(json_int(0), json_int(2));
+	EXPECT(json_array_insert(list, 1, json_int(1)), TO_BE(true));
+	EXPECT(json_array_insert(list, 3, json_int(3)), TO_BE(true));
+	EXPECT(json_array_insert(list, 9, json_int(9)), TO_BE(false)); // Out of range, so the value is freed
+	EXPECT(json_array_replace(list, 0, json_string("zero")), TO_BE(true));
+	EXPECT(json_array_remove(list, 3),	TO_BE(true));
+	EXPECT(AS_ARRAY(list).count,		TO_BE(3));
+	EXPECT(AS_INT(json_index(list, 2)),	TO_BE(2));
+	EXPECT(json_index(list, 1)->parent,	TO_BE(list));
+	// A detached node can be moved to another container
+	JsonNode* moved = json_node_detach(json_index(list, 0));
+	EXPECT(moved->parent,				TO_BE(NULL));
+	EXPECT(json_object_set(settings, "moved", moved), TO_BE(true));
+	EXPECT(strcmp(AS_STRING(json_property(settings, "moved")), "zero"), TO_BE(0));
+	EXPECT(AS_INT(json_index(list, 0)),	TO_BE(1));
+	EXPECT(json_node_detach(settings),	TO_BE(NULL));
+	json_node_free(list);
+	json_node_free(settings);
+	
 	json_node_free(array);
 	json_node_free(obj1);
 	json_node_free(obj2);
@@ -104,6 +161,7 @@ void json_runParserTests(void) {
 	EXPECT(AS_INT(last),				TO_BE(5));
 	EXPECT(pastLast,					TO_BE(NULL));
 	EXPECT(equals,						TO_BE(true));
+	EXPECT(AS_ARRAY(numbers).max,		TO_BE(5)); // The parser sizes containers exactly
 	json_node_free(expectedNumbers);
 	json_node_free(numbers);
 	
@@ -135,6 +193,319 @@ void json_runParserTests(void) {
 	EXPECT(IS_ERROR(error),				TO_BE(true));
 	EXPECT(childCount,					TO_BE(0));
 	json_node_free(error);
+	
+	JsonError parseError;
+	error = json_parseFileCtx(json_context_default(), DATA_PATH "invalid.json", &parseError);
+	EXPECT(IS_ERROR(error),				TO_BE(true));
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_INVALID_LITERAL));
+	EXPECT(parseError.offset,			TO_BE(19));
+	EXPECT(parseError.line,				TO_BE(2));
+	EXPECT(parseError.column,			TO_BE(18));
+	
+	char truncated[] = "[1, 2,";
+	char missingColon[] = "{ \"a\" 1 }";
+	char trailing[] = "{} {}";
+	json_parseCtx(json_context_default(), truncated, strlen(truncated), &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_UNEXPECTED_END));
+	EXPECT(parseError.offset,			TO_BE(6));
+	EXPECT(parseError.line,				TO_BE(0)); // Not located yet
+	json_parseCtx(json_context_default(), missingColon, strlen(missingColon), &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_EXPECTED_COLON));
+	EXPECT(parseError.offset,			TO_BE(6));
+	json_parseCtx(json_context_default(), trailing, strlen(trailing), &parseError);
+	json_error_locate(&parseError, trailing);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_TRAILING_CHARACTERS));
+	EXPECT(parseError.column,			TO_BE(4));
+	
+	char message[128];
+	json_error_format(&parseError, message, sizeof(message));
+	EXPECT(strcmp(message, "JSON_ERROR: unexpected character(s) after the root value, at line 1 column 4 (byte 3)"), TO_BE(0));
+
+	// Strings have to be UTF-8, and \u escapes (surrogate pairs included) are decoded to it
+	char unicode[] = "[\"caf\\u00e9 \\ud83d\\ude00\", \"caf\xc3\xa9 \xf0\x9f\x98\x80\", \"\\u0041\\u20AC\"]";
+	JsonNode* strings = json_parse(unicode, strlen(unicode));
+	EXPECT(IS_ERROR(strings),			TO_BE(false));
+	EXPECT(strcmp(AS_STRING(json_index(strings, 0)), "caf\xc3\xa9 \xf0\x9f\x98\x80"), TO_BE(0));
+	EXPECT(json_node_equals(json_index(strings, 0), json_index(strings, 1)), TO_BE(true));
+	EXPECT(strcmp(AS_STRING(json_index(strings, 2)), "A\xe2\x82\xac"), TO_BE(0));
+	json_node_free(strings);
+	char* badStrings[] = {
+		"\"\\ud83d\"", "\"\\ude00\"", "\"\\u12g4\"",						// Lone surrogates, bad hex
+		"\"\xc3\"", "\"\xc0\xaf\"", "\"\xed\xa0\x80\"", "\"\xf4\x90\x80\x80\"",	// Cut short, overlong, surrogate, too large
+		"\"a long run of plain ASCII text \xff\"", "\"a long run of plain ASCII, caf\xc3\xa9, \x01\""
+	};
+	JsonErrorCode badCodes[] = {
+		JSON_ERROR_INVALID_ESCAPE, JSON_ERROR_INVALID_ESCAPE, JSON_ERROR_INVALID_ESCAPE,
+		JSON_ERROR_INVALID_UTF8, JSON_ERROR_INVALID_UTF8, JSON_ERROR_INVALID_UTF8, JSON_ERROR_INVALID_UTF8,
+		JSON_ERROR_INVALID_UTF8, JSON_ERROR_CONTROL_CHARACTER
+	};
+	ptrdiff_t badOffsets[] = { 1, 1, 1, 1, 1, 1, 1, 32, 35 };
+	for (size_t i = 0; i < sizeof(badStrings) / sizeof(badStrings[0]); i++) {
+		json_parseCtx(json_context_default(), badStrings[i], strlen(badStrings[i]), &parseError);
+		EXPECT(parseError.code,			TO_BE(badCodes[i]));
+		EXPECT(parseError.offset,		TO_BE(badOffsets[i]));
+	}
+
+	// The validator accepts what the parser accepts, and fails with the same error where it doesn't
+	char valid[] = " {\"a\": [1, -2.5e3, \"\\u00e9\\n\xc3\xa9\", true, false, null, {}], \"b\": {\"c\": []}} ";
+	char* invalid[] = { truncated, missingColon, trailing, "[1,]", "{\"a\":1,}", "[01]", "[tru]", "\"a\tb\"", "[1 2]", "", "[{\"a\":1]", "{\"a\":[1}", "[[],[{}],{\"a\":[]}]]" };
+	EXPECT(json_validate(valid, strlen(valid), &parseError), TO_BE(true));
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_NONE));
+	EXPECT(json_validate("1", 1, NULL),	TO_BE(true));
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		JsonError validateError;
+		JsonNode* parsed = json_parseCtx(json_context_default(), invalid[i], strlen(invalid[i]), &parseError);
+		EXPECT(json_validate(invalid[i], strlen(invalid[i]), &validateError), TO_BE(false));
+		EXPECT(validateError.code,		TO_BE(parseError.code));
+		EXPECT(validateError.offset,	TO_BE(parseError.offset));
+		json_node_free(parsed);
+	}
+	// Nesting doesn't recurse, so it's checked however deep it goes
+	ptrdiff_t nestedLength = 4000000;
+	char* nested = malloc(nestedLength);
+	memset(nested, '[', nestedLength / 2);
+	memset(nested + nestedLength / 2, ']', nestedLength / 2);
+	EXPECT(json_validate(nested, nestedLength, &parseError), TO_BE(true));
+	EXPECT(json_validate(nested, nestedLength - 1, &parseError), TO_BE(false));
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_UNEXPECTED_END));
+	nested[nestedLength / 2 + 1] = '}';
+	EXPECT(json_validate(nested, nestedLength, &parseError), TO_BE(false));
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_EXPECTED_COMMA_OR_BRACKET));
+	EXPECT(parseError.offset,			TO_BE(nestedLength / 2 + 1));
+	free(nested);
+
+	// Streamed parsing gives the same tree, with tokens (and a string longer than a block) split across blocks
+	JsonNode* large = json_emptyArray();
+	char* longString = malloc(JSON_FILE_BLOCK_SIZE + 2);
+	memset(longString, 'x', JSON_FILE_BLOCK_SIZE + 1);
+	longString[JSON_FILE_BLOCK_SIZE + 1] = '\0';
+	for (int i = 0; i < 20000; i++) {
+		json_array_insert(large, i, json_object(
+			"id", json_int(i * 7919),
+			"score", json_real(i / 7.0),
+			"name", json_string("caf\xc3\xa9 \"quoted\"\n\xf0\x9f\x98\x80"),
+			"tags", json_array(json_bool(i % 2), json_null())
+		));
+	}
+	json_array_insert(large, 10000, json_string(longString));
+	free(longString);
+	json_writeFile(large, GENERATED_DATA_PATH "large.json", JSON_WRITE_PRETTY);
+	json_node_free(large);
+	large = json_parseFile(GENERATED_DATA_PATH "large.json");
+	JsonNode* streamed = json_parseFileStreamedCtx(json_context_default(), GENERATED_DATA_PATH "large.json", &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_NONE));
+	EXPECT(json_node_equals(large, streamed), TO_BE(true));
+	json_node_free(streamed);
+	json_node_free(large);
+	remove(GENERATED_DATA_PATH "large.json");
+	streamed = json_parseFileStreamedCtx(json_context_default(), DATA_PATH "invalid.json", &parseError);
+	EXPECT(IS_ERROR(streamed),			TO_BE(true));
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_INVALID_LITERAL));
+	EXPECT(parseError.offset,			TO_BE(19));
+	json_parseFileStreamedCtx(json_context_default(), DATA_PATH "does_not_exist.json", &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_FILE));
+	EXPECT(json_parseFileCtx(json_context_default(), DATA_PATH, &parseError), TO_BE(NULL)); // A directory has no length
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_FILE));
+
+	// Limits fail a document as soon as it goes over one, with the limit's own error
+	JsonContext* limited = json_context_create();
+	char deepText[] = "[[[[1]]]]";
+	json_context_setLimits(limited, (JsonLimits){ .maxDepth = 3 });
+	JsonNode* withinLimits = json_parseCtx(limited, deepText + 1, 7, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_NONE));
+	json_node_freeCtx(limited, withinLimits);
+	EXPECT(IS_ERROR(json_parseCtx(limited, deepText, 9, &parseError)), TO_BE(true));
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_DEPTH));
+	EXPECT(parseError.offset,			TO_BE(3));
+	JsonParser* limitedParser = json_parser_createCtx(limited);
+	json_parser_parse(limitedParser, deepText, 9, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_DEPTH));
+	json_parser_destroy(limitedParser);
+	json_context_setLimits(limited, (JsonLimits){ .maxNodes = 4 });
+	withinLimits = json_parseCtx(limited, "[1,2,3]", 7, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_NONE));
+	json_node_freeCtx(limited, withinLimits);
+	json_parseCtx(limited, "[1,2,3,4]", 9, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_NODES));
+	EXPECT(parseError.offset,			TO_BE(7));
+	json_context_setPackArrays(limited, true); // Packed elements count all the same
+	json_parseCtx(limited, "[1,2,3,4]", 9, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_NODES));
+	EXPECT(parseError.offset,			TO_BE(7));
+	json_context_setPackArrays(limited, false);
+	json_parseCtx(limited, "[\"a\",true,null,{}]", 18, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_NODES));
+	EXPECT(parseError.offset,			TO_BE(15));
+	json_context_setLimits(limited, (JsonLimits){ .maxStringLength = 3 });
+	withinLimits = json_parseCtx(limited, "{\"abc\":\"ab\\u0063\"}", 18, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_NONE));
+	json_node_freeCtx(limited, withinLimits);
+	json_parseCtx(limited, "[\"ab\\u0063d\"]", 14, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_STRING));
+	EXPECT(parseError.offset,			TO_BE(1));
+	json_parseCtx(limited, "{\"abcd\":1}", 10, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_STRING));
+	char lazyLimited[] = "[\"abcd\"]";
+	json_parseLazyCtx(limited, lazyLimited, 8, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_STRING));
+	json_context_setLimits(limited, (JsonLimits){ .maxAllocated = sizeof(JsonContainer) + sizeof(JsonNode) + 16 });
+	withinLimits = json_parseCtx(limited, "[\"short\"]", 9, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_NONE));
+	json_node_freeCtx(limited, withinLimits);
+	json_parseCtx(limited, "[\"longer than the limit\"]", 26, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_ALLOCATED));
+	EXPECT(parseError.offset,			TO_BE(1));
+	json_parseCtx(limited, "[true,false]", 12, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_ALLOCATED));
+	EXPECT(parseError.offset,			TO_BE(6));
+	json_context_setLimits(limited, (JsonLimits){ .maxSize = 10 });
+	json_parseCtx(limited, "[1,2,3,4,5,6]", 13, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_SIZE));
+	EXPECT(parseError.offset,			TO_BE(10));
+	EXPECT(IS_ERROR(json_parseFileCtx(limited, DATA_PATH "invalid.json", &parseError)), TO_BE(true));
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_SIZE));
+	json_parseFileStreamedCtx(limited, DATA_PATH "invalid.json", &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_LIMIT_SIZE));
+	json_context_setLimits(limited, (JsonLimits){0});
+	withinLimits = json_parseCtx(limited, deepText, 9, &parseError);
+	EXPECT(parseError.code,				TO_BE(JSON_ERROR_NONE));
+	json_node_freeCtx(limited, withinLimits);
+	json_context_destroy(limited);
+
+#ifndef JSON_NO_PACKED_ARRAYS
+	// Arrays of numbers of one type are packed when the context asks for it, and written like any other array
+	char packedText[] = "{\"ints\":[3,-1,4,1,5,9,2,6],\"reals\":[0.5,-1.25,1e+300],\"mixed\":[1,2.5,3],"
+		"\"nested\":[1,[2,3],[],[7],\"a\",[0.5,1.5]]}";
+	JsonNode* notPacked = json_parse(packedText, strlen(packedText));
+	EXPECT(IS_PACKED(json_property(notPacked, "ints")), TO_BE(false));
+	json_node_free(notPacked);
+	JsonContext* packing = json_context_create();
+	json_context_setPackArrays(packing, true);
+	JsonNode* packed = json_parseCtx(packing, packedText, strlen(packedText), NULL);
+	JsonNode* ints = json_property(packed, "ints");
+	JsonNode* reals = json_property(packed, "reals");
+	char* written = json_toString(packed, JSON_WRITE_CONDENSED);
+	EXPECT(IS_PACKED(ints),				TO_BE(true));
+	EXPECT(json_array_asInt64s(ints)[5], TO_BE(9));
+	EXPECT(json_array_asDoubles(reals)[1], TO_BE(-1.25));
+	EXPECT(json_array_asDoubles(ints),	TO_BE(NULL));
+	EXPECT(IS_PACKED(json_property(packed, "mixed")), TO_BE(false));
+	EXPECT(IS_PACKED(json_get(packed, "nested", 1)), TO_BE(true));
+	EXPECT(IS_PACKED(json_get(packed, "nested", 3)), TO_BE(false)); // Too short to be worth it
+	EXPECT(json_node_childrenCount(packed), TO_BE(29));
+	EXPECT(strcmp(written, packedText),	TO_BE(0));
+	free(written);
+	JsonNode* unpacked = json_node_clone(packed);
+	EXPECT(IS_PACKED(json_property(unpacked, "ints")), TO_BE(true));
+	EXPECT(json_node_unpack(json_property(unpacked, "ints")), TO_BE(true));
+	EXPECT(IS_PACKED(json_property(unpacked, "ints")), TO_BE(false));
+	JsonNode scratch;
+	EXPECT(AS_REAL(json_node_childAt(json_property(unpacked, "reals"), 0, &scratch)), TO_BE(0.5));
+	EXPECT(IS_PACKED(json_property(unpacked, "reals")), TO_BE(true)); // Reading into a scratch node doesn't unpack
+	EXPECT(AS_REAL(json_get(unpacked, "nested", 5, 1)), TO_BE(1.5)); // json_get unpacks, like json_index does
+	EXPECT(AS_REAL(json_get(unpacked, "reals", 0)), TO_BE(0.5));
+	EXPECT(IS_PACKED(json_property(unpacked, "reals")), TO_BE(false));
+	EXPECT(json_node_equals(packed, unpacked), TO_BE(true));
+	EXPECT(json_node_hash(packed, JSON_HASH_ORDERED), TO_BE(json_node_hash(unpacked, JSON_HASH_ORDERED)));
+	char* canonical = json_toString(packed, JSON_WRITE_CANONICAL);
+	written = json_toString(unpacked, JSON_WRITE_CANONICAL);
+	EXPECT(strcmp(canonical, written),	TO_BE(0));
+	free(canonical);
+	free(written);
+	EXPECT(json_array_remove(ints, 0),	TO_BE(true));
+	EXPECT(IS_PACKED(ints),				TO_BE(false));
+	EXPECT(AS_INT(json_index(ints, 0)),	TO_BE(-1));
+	double doubles[] = { 0.5, -1.25, 1e300 };
+	JsonNode* built = json_packedArray(JSON_REAL, doubles, 3);
+	EXPECT(json_node_valueEquals(built, reals), TO_BE(true));
+	json_node_free(built);
+	json_node_free(unpacked);
+	json_node_freeCtx(packing, packed);
+	JsonParser* packingParser = json_parser_createCtx(packing);
+	EXPECT(IS_PACKED(json_property(json_parser_parse(packingParser, packedText, strlen(packedText), NULL), "reals")), TO_BE(true));
+	json_parser_destroy(packingParser);
+	json_context_destroy(packing);
+#endif
+
+	// Lazily parsed reals and strings are written as they were parsed, and decoded when they're first read
+	char lazyText[] = "{\"pi\":3.14159265358979323846,\"name\":\"caf\\u00e9 \\\"x\\\"\",\"plain\":\"abc\",\"list\":[2.5,\"a\",-1e-3]}";
+	char lazyBuffer[sizeof(lazyText)];
+	memcpy(lazyBuffer, lazyText, sizeof(lazyText));
+	JsonNode* lazy = json_parseLazy(lazyBuffer, strlen(lazyBuffer));
+	JsonNode* pi = json_property(lazy, "pi");
+	JsonNode* name = json_property(lazy, "name");
+	char* lazyWritten = json_toString(lazy, JSON_WRITE_CONDENSED);
+	EXPECT(IS_UNDECODED(pi),			TO_BE(true));
+	EXPECT(strcmp(lazyWritten, lazyText), TO_BE(0)); // The digits beyond a double's precision included
+	EXPECT(json_node_real(pi),			TO_BE(3.14159265358979323846));
+	EXPECT(IS_UNDECODED(pi),			TO_BE(false));
+	EXPECT(strcmp(json_node_string(name), "caf\xc3\xa9 \"x\""), TO_BE(0));
+	EXPECT(json_node_stringLength(name), TO_BE(9));
+	EXPECT(json_node_string(pi),		TO_BE(NULL));
+	free(lazyWritten);
+	JsonNode* eager = json_parse(lazyText, strlen(lazyText));
+	EXPECT(json_node_equals(lazy, eager), TO_BE(true)); // Decoding the rest
+	lazyWritten = json_toString(lazy, JSON_WRITE_CANONICAL);
+	char* eagerWritten = json_toString(eager, JSON_WRITE_CANONICAL);
+	EXPECT(strcmp(lazyWritten, eagerWritten), TO_BE(0));
+	free(lazyWritten);
+	free(eagerWritten);
+	json_node_free(eager);
+	json_node_free(lazy);
+	
+	// Comparing, hashing, cloning and writing read undecoded values without decoding them, the tree and its buffer
+	// are left as they were (so they can be read from many threads). The string is longer than a decoding chunk.
+	char readText[4096] = "{\"real\":0.25,\"text\":\"";
+	for (int i = 0; i < 200; i++) {
+		strcat(readText, i % 2 ? "\\u00e9\xe2\x82\xac\\n" : "ab\\ud83d\\ude00\\\"");
+	}
+	strcat(readText, "\"}");
+	char readBuffer[sizeof(readText)];
+	memcpy(readBuffer, readText, sizeof(readText));
+	JsonNode* lazyRead = json_parseLazy(readBuffer, strlen(readBuffer));
+	JsonNode* eagerRead = json_parse(readText, strlen(readText));
+	EXPECT(json_node_equals(lazyRead, eagerRead), TO_BE(true));
+	EXPECT(json_node_hash(lazyRead, JSON_HASH_ORDERED), TO_BE(json_node_hash(eagerRead, JSON_HASH_ORDERED)));
+	JsonNode* lazyCopy = json_node_clone(lazyRead);
+	EXPECT(json_node_equals(lazyCopy, eagerRead), TO_BE(true));
+	EXPECT(IS_UNDECODED(json_property(lazyCopy, "text")), TO_BE(false));
+	for (int i = 0; i < 2; i++) {
+		enum JsonWriteOption option = i ? JSON_WRITE_CANONICAL : (JSON_WRITE_CONDENSED | JSON_WRITE_ASCII);
+		lazyWritten = json_toString(lazyRead, option);
+		eagerWritten = json_toString(eagerRead, option);
+		EXPECT(strcmp(lazyWritten, eagerWritten), TO_BE(0));
+		free(lazyWritten);
+		free(eagerWritten);
+	}
+	AS_STRING(json_property(lazyCopy, "text"))[0] = 'b';
+	json_node_invalidate(json_property(lazyCopy, "text"));
+	EXPECT(json_node_equals(lazyRead, lazyCopy), TO_BE(false));
+	EXPECT(IS_UNDECODED(json_property(lazyRead, "real")), TO_BE(true));
+	EXPECT(IS_UNDECODED(json_property(lazyRead, "text")), TO_BE(true));
+	EXPECT(memcmp(readBuffer, readText, sizeof(readText)), TO_BE(0));
+	json_node_free(lazyCopy);
+	json_node_free(eagerRead);
+	json_node_free(lazyRead);
+}
+
+// A JsonSink collecting what it's given, which refuses anything past 'limit' bytes
+typedef struct TestSink {
+	char* bytes;
+	ptrdiff_t length;
+	ptrdiff_t offset;
+	ptrdiff_t limit;
+} TestSink;
+
+static bool _collect(void* user, const char* bytes, ptrdiff_t length) {
+	TestSink* sink = user;
+	if (sink->offset + length > sink->limit) return false;
+	return json_utils_dynAppendN(&sink->bytes, &sink->length, &sink->offset, bytes, length);
+}
+
+static void* _refusingAlloc(ptrdiff_t size, void* instance) {
+	(void)size;
+	(void)instance;
+	return NULL;
 }
 
 // Tests to ensure serialization behaves as intended.
@@ -167,6 +538,188 @@ void json_runSerializerTests(void) {
 	EXPECT(nodesEqual,					TO_BE(true));
 	json_node_free(nestedObject);
 	json_node_free(parsedNestedObject);
+	
+	// Strings carry their length, so they can hold '\0', and keys are escaped like values
+	JsonNode* embedded = json_object("quote\"d", json_stringN("a\0b\"", 4));
+	JsonNode* truncated = json_object("quote\"d", json_string("a"));
+	char* text = json_toString(embedded, JSON_WRITE_CONDENSED);
+	EXPECT(AS_STRING_LEN(AS_OBJECT(embedded).nodes[0]), TO_BE(4));
+	EXPECT(json_node_equals(embedded, truncated), TO_BE(false));
+	EXPECT(strcmp(text, "{\"quote\\\"d\":\"a\\u0000b\\\"\"}"), TO_BE(0));
+	free(text);
+	json_node_free(embedded);
+	json_node_free(truncated);
+	
+	// UTF-8 is written as is, unless the output has to be ASCII
+	JsonNode* greeting = json_string("caf\xc3\xa9 \xf0\x9f\x98\x80");
+	char* raw = json_toString(greeting, JSON_WRITE_CONDENSED);
+	char* ascii = json_toString(greeting, JSON_WRITE_CONDENSED | JSON_WRITE_ASCII);
+	JsonNode* parsedAscii = json_parse(ascii, strlen(ascii));
+	EXPECT(strcmp(raw, "\"caf\xc3\xa9 \xf0\x9f\x98\x80\""), TO_BE(0));
+	EXPECT(strcmp(ascii, "\"caf\\u00e9 \\ud83d\\ude00\""), TO_BE(0));
+	EXPECT(json_node_equals(greeting, parsedAscii), TO_BE(true));
+	free(raw);
+	free(ascii);
+	json_node_free(greeting);
+	json_node_free(parsedAscii);
+	
+	// Canonical output (RFC 8785), the key order and numbers are the RFC's examples
+	char unordered[] =
+		"{\"\\u20ac\": 1, \"\\r\": 2, \"\\ufb33\": 3, \"1\": 4, \"\\ud83d\\ude00\": 5, \"\\u0080\": 6, \"\\u00f6\": 7, "
+		"\"numbers\": [333333333.33333329, 1E30, 4.50, 2e-3, 0.000000000000000000000000001, -0.0, 1e21, 1e-7, 0.000001, "
+		"9007199254740993, 5e-324, 1.7976931348623157e308, 123456789012345680000], \"text\": \"a/b\\u001f\\n\"}";
+	JsonNode* canonical = json_parse(unordered, strlen(unordered));
+	JsonNode* reordered = json_object("b", json_array(json_int(1), json_real(0.5)), "a", json_object("d", json_null(), "c", json_bool(true)));
+	char* canonicalText = json_toString(canonical, JSON_WRITE_CANONICAL);
+	char* reorderedText = json_toString(reordered, JSON_WRITE_CANONICAL);
+	EXPECT(strcmp(canonicalText,
+		"{\"\\r\":2,\"1\":4,\"numbers\":[333333333.3333333,1e+30,4.5,0.002,1e-27,0,1e+21,1e-7,0.000001,"
+		"9007199254740992,5e-324,1.7976931348623157e+308,123456789012345680000],\"text\":\"a/b\\u001f\\n\","
+		"\"\xc2\x80\":6,\"\xc3\xb6\":7,\"\xe2\x82\xac\":1,\"\xf0\x9f\x98\x80\":5,\"\xef\xac\xb3\":3}"), TO_BE(0));
+	EXPECT(strcmp(reorderedText, "{\"a\":{\"c\":true,\"d\":null},\"b\":[1,0.5]}"), TO_BE(0));
+	EXPECT(strcmp(AS_OBJECT(reordered).nodes[0]->identifier, "b"), TO_BE(0)); // The tree keeps its order
+	free(canonicalText);
+	free(reorderedText);
+	json_node_free(canonical);
+	json_node_free(reordered);
+	
+	// Writing in parallel gives the same bytes, for a large array (with large containers in it) and a wide object
+	JsonNode* records = json_emptyArray();
+	JsonNode* wide = json_emptyObject();
+	for (int i = 0; i < 3 * JSON_PARALLEL_MIN_CHILDREN + 7; i++) {
+		char key[32];
+		sprintf(key, "key %d", i);
+		json_object_set(wide, key, json_real(i / 3.0));
+		json_array_insert(records, i, json_object(
+			"id", json_int(i),
+			"name", json_string("caf\xc3\xa9 \"quoted\""),
+			"tags", i == 42 ? json_emptyArray() : json_array(json_bool(i % 2), json_null())
+		));
+	}
+	json_array_insert(records, 42, wide);
+	enum JsonWriteOption options[] = { JSON_WRITE_PRETTY, JSON_WRITE_CONDENSED, JSON_WRITE_CONDENSED | JSON_WRITE_ASCII, JSON_WRITE_PRETTY | JSON_WRITE_CACHED };
+	for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+		char* serial = json_toString(records, options[i]);
+		char* parallel = json_toString(records, options[i] | JSON_WRITE_PARALLEL);
+		EXPECT(strcmp(serial, parallel), TO_BE(0));
+		free(serial);
+		free(parallel);
+	}
+	// A change below a container that was written in parallel still reaches the cached root (the first change
+	// leaves a child that the workers write next)
+	json_object_set(AS_ARRAY(records).nodes[5], "id", json_int(-5));
+	char* cachedFirst = json_toString(records, JSON_WRITE_CONDENSED | JSON_WRITE_CACHED | JSON_WRITE_PARALLEL);
+	json_object_set(AS_ARRAY(records).nodes[5], "name", json_string("changed"));
+	char* cachedSecond = json_toString(records, JSON_WRITE_CONDENSED | JSON_WRITE_CACHED | JSON_WRITE_PARALLEL);
+	char* uncached = json_toString(records, JSON_WRITE_CONDENSED);
+	EXPECT(strcmp(cachedFirst, uncached) != 0, TO_BE(true));
+	EXPECT(strcmp(cachedSecond, uncached), TO_BE(0));
+	free(cachedFirst);
+	free(cachedSecond);
+	free(uncached);
+	json_node_free(records);
+
+	// Reformatting goes from text to text. Condensed, it's what the serializer writes. Pretty, it indents every level
+	// once and writes empty containers as {} and [], while the serializer indents containers in arrays twice and
+	// puts tabs between empty brackets, so the two only agree on documents without those (like service_config.json).
+	char messy[] = " {\"a\" :[ 1 ,2.50, {} ,[ ] ,\"x\\/y\" ] , \"b\":{ \"c\" : null } } ";
+	char* layouts[] = {
+		"{\"a\":[1,2.50,{},[],\"x\\/y\"],\"b\":{\"c\":null}}",
+		"{\n\t\"a\": [\n\t\t1,\n\t\t2.50,\n\t\t{},\n\t\t[],\n\t\t\"x\\/y\"\n\t],\n\t\"b\": {\n\t\t\"c\": null\n\t}\n}"
+	};
+	enum JsonWriteOption layoutOptions[] = { JSON_WRITE_CONDENSED, JSON_WRITE_PRETTY };
+	JsonNode* platforms = json_parseFile(DATA_PATH "service_config.json");
+	char* condensedPlatforms = json_toString(platforms, JSON_WRITE_CONDENSED);
+	char* prettyPlatforms = json_toString(platforms, JSON_WRITE_PRETTY);
+	for (int i = 0; i < 2; i++) {
+		TestSink sink = { malloc(16), 16, 0, PTRDIFF_MAX };
+		EXPECT(json_reformat(messy, strlen(messy), (JsonSink){ _collect, &sink }, layoutOptions[i], NULL), TO_BE(true));
+		EXPECT(sink.offset == (ptrdiff_t)strlen(layouts[i]) && memcmp(sink.bytes, layouts[i], sink.offset) == 0, TO_BE(true));
+		sink.offset = 0;
+		char* input = i == 0 ? prettyPlatforms : condensedPlatforms;
+		char* output = i == 0 ? condensedPlatforms : prettyPlatforms;
+		EXPECT(json_reformat(input, strlen(input), (JsonSink){ _collect, &sink }, layoutOptions[i], NULL), TO_BE(true));
+		EXPECT(sink.offset == (ptrdiff_t)strlen(output) && memcmp(sink.bytes, output, sink.offset) == 0, TO_BE(true));
+		free(sink.bytes);
+	}
+	free(condensedPlatforms);
+	free(prettyPlatforms);
+	json_node_free(platforms);
+	// Tokens longer than the sink's blocks, invalid input and a sink that gives up
+	ptrdiff_t longLength = JSON_SINK_BUFFER_SIZE * 2 + 8;
+	char* longText = malloc(longLength);
+	memset(longText, 'x', longLength);
+	memcpy(longText, "[ \"", 3);
+	memcpy(longText + longLength - 2, "\"]", 2);
+	TestSink longSink = { malloc(16), 16, 0, PTRDIFF_MAX };
+	EXPECT(json_reformat(longText, longLength, (JsonSink){ _collect, &longSink }, JSON_WRITE_CONDENSED, NULL), TO_BE(true));
+	EXPECT(longSink.offset,				TO_BE(longLength - 1));
+	EXPECT(memcmp(longSink.bytes + 1, longText + 2, longLength - 2), TO_BE(0));
+	JsonError reformatError;
+	longSink.offset = 0;
+	EXPECT(json_reformat("[1,]", 4, (JsonSink){ _collect, &longSink }, JSON_WRITE_CONDENSED, &reformatError), TO_BE(false));
+	EXPECT(reformatError.code,			TO_BE(JSON_ERROR_UNEXPECTED_CHARACTER));
+	longSink.offset = 0;
+	longSink.limit = JSON_SINK_BUFFER_SIZE;
+	EXPECT(json_reformat(longText, longLength, (JsonSink){ _collect, &longSink }, JSON_WRITE_CONDENSED, &reformatError), TO_BE(false));
+	EXPECT(reformatError.code,			TO_BE(JSON_ERROR_OUTPUT));
+	free(longSink.bytes);
+	free(longText);
+	// The walk doesn't recurse either, however deep the document is nested
+	ptrdiff_t nestedLength = 4000000;
+	char* nested = malloc(nestedLength);
+	memset(nested, '[', nestedLength / 2);
+	memset(nested + nestedLength / 2, ']', nestedLength / 2);
+	TestSink nestedSink = { malloc(16), 16, 0, PTRDIFF_MAX };
+	EXPECT(json_reformat(nested, nestedLength, (JsonSink){ _collect, &nestedSink }, JSON_WRITE_CONDENSED, NULL), TO_BE(true));
+	EXPECT(nestedSink.offset == nestedLength && memcmp(nestedSink.bytes, nested, nestedLength) == 0, TO_BE(true));
+	JsonContext* refusing = json_context_create(); // The bits for deep nesting are allocated through the context
+	json_context_setAllocator(refusing, _refusingAlloc, NULL, NULL, NULL);
+	nestedSink.offset = 0;
+	EXPECT(json_reformatCtx(refusing, nested, nestedLength, (JsonSink){ _collect, &nestedSink }, JSON_WRITE_CONDENSED, &reformatError), TO_BE(false));
+	EXPECT(reformatError.code,			TO_BE(JSON_ERROR_OUT_OF_MEMORY));
+	json_context_setLimits(refusing, (JsonLimits){ .maxDepth = 10 });
+	EXPECT(json_reformatCtx(refusing, nested, nestedLength, (JsonSink){ _collect, &nestedSink }, JSON_WRITE_CONDENSED, &reformatError), TO_BE(false));
+	EXPECT(reformatError.code,			TO_BE(JSON_ERROR_LIMIT_DEPTH));
+	json_context_destroy(refusing);
+	free(nestedSink.bytes);
+	free(nested);
+	
+	// Cached writes copy unchanged containers and write the changed ones again
+	JsonNode* config = json_parseFile(DATA_PATH "service_config.json");
+	JsonNode* state = json_object("config", config, "counter", json_int(0));
+	JsonNode* copy = json_node_clone(state);
+	for (int pretty = 0; pretty < 2; pretty++) {
+		enum JsonWriteOption option = pretty ? JSON_WRITE_PRETTY : JSON_WRITE_CONDENSED;
+		char* first = json_toString(state, option | JSON_WRITE_CACHED);
+		JsonOutputCache* output = AS_CONTAINER(config)->output;
+		EXPECT(output != NULL,			TO_BE(true));
+		EXPECT((config->flags & JSON_FLAG_SERIALIZED) != 0, TO_BE(true));
+		json_object_set(state, "counter", json_int(pretty + 1));
+		json_object_set(copy, "counter", json_int(pretty + 1));
+		EXPECT((state->flags & JSON_FLAG_SERIALIZED) != 0, TO_BE(false));
+		char* second = json_toString(state, option | JSON_WRITE_CACHED);
+		char* expected = json_toString(copy, option);
+		EXPECT(strcmp(second, expected), TO_BE(0));
+		EXPECT(AS_CONTAINER(config)->output, TO_BE(output)); // Copied, not written again
+		// A change deep in the tree marks every container above it
+		json_array_replace(json_property(config, "supported_platforms"), 0, json_string("macOS"));
+		json_array_replace(json_get(copy, "config", "supported_platforms"), 0, json_string("macOS"));
+		EXPECT((config->flags & JSON_FLAG_SERIALIZED) != 0, TO_BE(false));
+		char* third = json_toString(state, option | JSON_WRITE_CACHED);
+		char* thirdExpected = json_toString(copy, option);
+		EXPECT(strcmp(third, thirdExpected), TO_BE(0));
+		EXPECT(strcmp(first, third) != 0, TO_BE(true));
+		free(first);
+		free(second);
+		free(expected);
+		free(third);
+		free(thirdExpected);
+		json_array_replace(json_property(config, "supported_platforms"), 0, json_string("Mac"));
+		json_array_replace(json_get(copy, "config", "supported_platforms"), 0, json_string("Mac"));
+	}
+	json_node_free(state);
+	json_node_free(copy);
 }
 
 // Tests to ensure utils functions behave as intended.
@@ -179,7 +732,8 @@ void json_runUtilsTests(void) {
 		json_utils_ensureCapacity(&buffer, &length, offset);
 		EXPECT(length,						TO_BE(8));
 		while (offset < 8) {
-			buffer[offset] = (char)offset++;
+			buffer[offset] = (char)offset;
+			offset++;
 		}
 		json_utils_ensureCapacity(&buffer, &length, offset);
 		EXPECT(length,						TO_BE(8 * JSON_DYNAMIC_ARRAY_GROW_BY));
@@ -226,8 +780,8 @@ void json_runUtilsTests(void) {
 	
 	// toEscaped
 	{
-		const char* expected = "\\\\\\t\\r";
-		char* escaped = json_utils_toEscaped("\\\t\r");
+		const char* expected = "\\\\\\t\\r\\\"\\u001f";
+		char* escaped = json_utils_toEscaped("\\\t\r\"\x1f");
 		EXPECT(strcmp(expected, escaped),	TO_BE(0));
 		free(escaped);
 	}
@@ -251,3 +805,560 @@ void json_runUtilsTests(void) {
 		EXPECT(dollar2,						TO_BE('$'));
 	}
 }
+
+static void* _countingAlloc(ptrdiff_t size, void* instance) {
+	(*(ptrdiff_t*)instance)++;
+	return malloc(size);
+}
+
+static void _countingFree(void* ptr, ptrdiff_t size, void* instance) {
+	(void)size;
+	(*(ptrdiff_t*)instance)--;
+	free(ptr);
+}
+
+// Tests to ensure contexts are independent of each other and of the default context.
+void json_runContextTests(void) {
+	ptrdiff_t liveAllocations = 0;
+	JsonContext* ctx = json_context_create();
+	json_context_setAllocator(ctx, _countingAlloc, _countingFree, NULL, &liveAllocations);
+	
+	char text[] = "{ \"name\": \"clancy\", \"tags\": [1, 2, 3] }";
+	JsonNode* parsed = json_parseCtx(ctx, text, strlen(text), NULL);
+	JsonNode* expected = json_objectCtx(ctx,
+		"name", json_stringCtx(ctx, "clancy"),
+		"tags", json_arrayCtx(ctx, json_intCtx(ctx, 1), json_intCtx(ctx, 2), json_intCtx(ctx, 3))
+	);
+	bool equals = json_node_equals(parsed, expected);
+	bool allocated = liveAllocations > 0;
+	char* condensed = json_toStringCtx(ctx, parsed, JSON_WRITE_CONDENSED);
+	EXPECT(equals,						TO_BE(true));
+	EXPECT(allocated,					TO_BE(true));
+	EXPECT(strcmp(condensed, "{\"name\":\"clancy\",\"tags\":[1,2,3]}"), TO_BE(0));
+	json_context_free(ctx, condensed, strlen(condensed) + 1);
+	json_node_freeCtx(ctx, parsed);
+	json_node_freeCtx(ctx, expected);
+	EXPECT(liveAllocations,				TO_BE(0));
+	
+	// Freeing doesn't recurse, so a tree too deep for the stack is freed too
+	JsonNode* deep = json_emptyArrayCtx(ctx);
+	JsonNode* innermost = deep;
+	for (int i = 0; i < 1000000; i++) {
+		JsonNode* inner = json_arrayCtx(ctx, json_intCtx(ctx, i));
+		json_node_appendCtx(ctx, innermost, inner);
+		innermost = inner;
+	}
+	json_node_freeCtx(ctx, deep);
+	EXPECT(liveAllocations,				TO_BE(0));
+	
+	// Validating nesting deeper than its inline bits allocates through the context it's given, under its limits
+	ptrdiff_t nestedLength = 2 * (JSON_VALIDATE_INLINE_DEPTH + 100);
+	char* nested = malloc(nestedLength);
+	memset(nested, '[', nestedLength / 2);
+	memset(nested + nestedLength / 2, ']', nestedLength / 2);
+	JsonError validateError;
+	EXPECT(json_validateCtx(ctx, nested, nestedLength, &validateError), TO_BE(true));
+	EXPECT(liveAllocations,				TO_BE(0));
+	JsonContext* refusing = json_context_create();
+	json_context_setAllocator(refusing, _refusingAlloc, _countingFree, NULL, &liveAllocations);
+	EXPECT(json_validateCtx(refusing, nested, nestedLength, &validateError), TO_BE(false));
+	EXPECT(validateError.code,			TO_BE(JSON_ERROR_OUT_OF_MEMORY));
+	json_context_setLimits(refusing, (JsonLimits){ .maxDepth = 10 });
+	JsonError parseError;
+	json_parseCtx(refusing, nested, nestedLength, &parseError);
+	EXPECT(json_validateCtx(refusing, nested, nestedLength, &validateError), TO_BE(false));
+	EXPECT(validateError.code,			TO_BE(JSON_ERROR_LIMIT_DEPTH));
+	EXPECT(validateError.offset,		TO_BE(parseError.offset));
+	EXPECT(validateError.offset,		TO_BE(10));
+	json_context_setLimits(refusing, (JsonLimits){ .maxSize = 100 });
+	EXPECT(json_validateCtx(refusing, nested, nestedLength, &validateError), TO_BE(false));
+	EXPECT(validateError.code,			TO_BE(JSON_ERROR_LIMIT_SIZE));
+	json_context_destroy(refusing);
+	free(nested);
+	
+	// A reclaimer frees trees on its own thread, shared trees only once their last reference is dropped
+	JsonReclaimer* reclaimer = json_reclaimer_createCtx(ctx);
+	JsonNode* trees[8];
+	for (int i = 0; i < 8; i++) {
+		trees[i] = json_parseCtx(ctx, text, strlen(text), NULL);
+	}
+	JsonNode* shared = json_shared_retain(json_shared_freeze(json_parseCtx(ctx, text, strlen(text), NULL)));
+	for (int i = 0; i < 8; i++) {
+		json_node_freeDeferred(reclaimer, trees[i]);
+	}
+	json_node_freeDeferred(reclaimer, shared);
+	json_reclaimer_drain(reclaimer);
+	EXPECT(AS_INT(json_get(shared, "tags", 2)), TO_BE(3));
+	json_node_freeDeferred(reclaimer, shared);
+	// Shared roots queued together are all freed, each is linked through the field its count is kept in
+	for (int i = 0; i < 8; i++) {
+		trees[i] = json_shared_freeze(json_parseCtx(ctx, text, strlen(text), NULL));
+	}
+	for (int i = 0; i < 8; i++) {
+		json_node_freeDeferred(reclaimer, trees[i]);
+	}
+	json_reclaimer_destroy(reclaimer);
+	EXPECT(liveAllocations,				TO_BE(0));
+	json_node_freeDeferred(NULL, json_parse(text, strlen(text))); // Freed right away
+	
+	// Without a free, nothing is given back, so freeing a tree doesn't walk it at all
+	JsonPool* arena = json_pool_create();
+	JsonContext* arenaCtx = json_context_create();
+	json_context_setAllocator(arenaCtx, json_pool_alloc, NULL, json_pool_realloc, arena);
+	JsonNode* scratch = json_parseCtx(arenaCtx, text, strlen(text), NULL);
+	EXPECT(IS_OBJECT(scratch),			TO_BE(true));
+	json_node_freeCtx(arenaCtx, scratch);
+	json_pool_destroy(arena);
+	json_context_destroy(arenaCtx);
+	
+	ptrdiff_t defaultErrors = json_error_count();
+	json_error_reportCtx(ctx, "JSON_ERROR: reported to ctx");
+	EXPECT(json_error_countCtx(ctx),	TO_BE(1));
+	EXPECT(json_error_count(),			TO_BE(defaultErrors));
+	json_context_destroy(ctx);
+}
+
+// Tests to ensure statistics are recorded per context (and only with JSON_STATS).
+void json_runStatsTests(void) {
+	JsonContext* ctx = json_context_create();
+	JsonStats stats;
+	char text[] = "[1, 2.5, \"three\", { \"four\": null }]";
+	JsonNode* parsed = json_parseCtx(ctx, text, strlen(text), NULL);
+	char* condensed = json_toStringCtx(ctx, parsed, JSON_WRITE_CONDENSED);
+	json_stats_getCtx(ctx, &stats);
+#ifdef JSON_STATS
+	EXPECT(stats.bytesParsed,			TO_BE((ptrdiff_t)strlen(text)));
+	EXPECT(stats.bytesWritten,			TO_BE((ptrdiff_t)strlen(condensed)));
+	EXPECT(stats.nodesCreated[JSON_ARRAY],	TO_BE(1));
+	EXPECT(stats.nodesCreated[JSON_OBJECT],	TO_BE(1));
+	EXPECT(stats.nodesCreated[JSON_INT],	TO_BE(1));
+	EXPECT(stats.nodesCreated[JSON_REAL],	TO_BE(1));
+	EXPECT(stats.nodesCreated[JSON_STRING],	TO_BE(1));
+	EXPECT(stats.nodesCreated[JSON_NULL],	TO_BE(1));
+	EXPECT(stats.bytesInUse > 0,		TO_BE(true));
+	EXPECT(stats.peakBytesInUse >= stats.bytesInUse, TO_BE(true));
+#else
+	EXPECT(stats.allocations,			TO_BE(0));
+	EXPECT(stats.bytesParsed,			TO_BE(0));
+#endif
+	json_context_free(ctx, condensed, strlen(condensed) + 1);
+	json_node_freeCtx(ctx, parsed);
+	json_stats_getCtx(ctx, &stats);
+	EXPECT(stats.bytesInUse,			TO_BE(0));
+	EXPECT(stats.allocations,			TO_BE(stats.frees));
+	
+	json_stats_resetCtx(ctx);
+	json_stats_getCtx(ctx, &stats);
+	EXPECT(stats.allocations,			TO_BE(0));
+	EXPECT(stats.peakBytesInUse,		TO_BE(0));
+	json_context_destroy(ctx);
+	
+	// The clock is monotonic, so timers never go backwards
+	int64_t earlier = json_stats_now();
+	EXPECT(json_stats_now() >= earlier,	TO_BE(true));
+	EXPECT(earlier > 0,					TO_BE(true));
+}
+
+// Tests to ensure the pool hands freed memory back out instead of growing.
+void json_runPoolTests(void) {
+	JsonPool* pool = json_pool_create();
+	JsonContext* ctx = json_context_create();
+	json_context_setAllocator(ctx, json_pool_alloc, json_pool_free, json_pool_realloc, pool);
+	
+	void* small = json_pool_alloc(sizeof(JsonNode), pool);
+	json_pool_free(small, sizeof(JsonNode), pool);
+	void* reused = json_pool_alloc(sizeof(JsonNode), pool);
+	EXPECT(reused,						TO_BE(small));
+	json_pool_free(reused, sizeof(JsonNode), pool);
+	
+	// After the first round every block should come from the free lists
+	ptrdiff_t reserved = 0;
+	for (int i = 0; i < 16; i++) {
+		if (i == 1) {
+			reserved = json_pool_reservedBytes(pool);
+		}
+		JsonNode* serviceConfig = json_parseFileCtx(ctx, DATA_PATH "service_config.json", NULL);
+		JsonNode* platforms = json_property(serviceConfig, "supported_platforms");
+		for (int j = 0; j < 40; j++) {
+			json_node_appendCtx(ctx, platforms, json_stringCtx(ctx, "Toaster"));
+		}
+		json_node_freeCtx(ctx, serviceConfig);
+	}
+	EXPECT(reserved > 0,				TO_BE(true));
+	EXPECT(json_pool_reservedBytes(pool),	TO_BE(reserved));
+	
+	json_context_destroy(ctx);
+	json_pool_destroy(pool);
+	
+	// A parser keeps its pool and scratch stack between documents, and drops its documents on reset
+	ptrdiff_t ownerAllocations = 0;
+	JsonContext* owner = json_context_create();
+	json_context_setAllocator(owner, _countingAlloc, _countingFree, NULL, &ownerAllocations);
+	JsonParser* parser = json_parser_createCtx(owner);
+	char wide[2 * JSON_PARSER_STACK_CAPACITY * 2 + 3] = "[";
+	for (int i = 0; i < 2 * JSON_PARSER_STACK_CAPACITY; i++) {
+		strcat(wide, i ? ",1" : "1");
+	}
+	strcat(wide, "]");
+	char* large = malloc(JSON_POOL_MAX_SIZE + 3);
+	memset(large, 'x', JSON_POOL_MAX_SIZE + 2);
+	large[0] = large[JSON_POOL_MAX_SIZE + 1] = '"';
+	large[JSON_POOL_MAX_SIZE + 2] = '\0';
+	ptrdiff_t warmAllocations = 0;
+	for (int i = 0; i < 8; i++) {
+		if (i == 1) {
+			reserved = json_pool_reservedBytes(parser->pool);
+			warmAllocations = ownerAllocations;
+		}
+		JsonNode* numbers = json_parser_parse(parser, wide, strlen(wide), NULL);
+		JsonNode* string = json_parser_parse(parser, large, strlen(large), NULL); // Too large to be pooled
+		EXPECT(AS_ARRAY(numbers).count,	TO_BE(2 * JSON_PARSER_STACK_CAPACITY));
+		EXPECT(AS_STRING_LEN(string),	TO_BE(JSON_POOL_MAX_SIZE));
+		json_parser_reset(parser);
+	}
+	EXPECT(json_pool_reservedBytes(parser->pool), TO_BE(reserved));
+	EXPECT(ownerAllocations,			TO_BE(warmAllocations));
+	JsonError error;
+	EXPECT(IS_ERROR(json_parser_parse(parser, "[1,", 3, &error)), TO_BE(true));
+	EXPECT(error.code,					TO_BE(JSON_ERROR_UNEXPECTED_END));
+	json_parser_destroy(parser);
+	EXPECT(ownerAllocations,			TO_BE(0));
+	json_context_destroy(owner);
+	free(large);
+}
+
+// Tests to ensure frozen trees are shared rather than copied, and updates leave the original alone.
+void json_runSharedTests(void) {
+	JsonNode* config = json_shared_freeze(json_parseFile(DATA_PATH "service_config.json"));
+	JsonNode* platforms = json_property(config, "supported_platforms");
+	EXPECT(IS_FROZEN(config),			TO_BE(true));
+	EXPECT(IS_FROZEN(platforms),		TO_BE(true));
+	
+	// Frozen trees can't be modified in place
+	JsonNode* rejected = json_null();
+	json_node_append(platforms, rejected);
+	EXPECT(AS_ARRAY(platforms).count,	TO_BE(5));
+	json_node_free(rejected);
+	
+	JsonNode* updated = json_shared_set(config, json_string("Toaster"), "supported_platforms", 1);
+	JsonNode* extended = json_shared_set(updated, json_int(3), "retries");
+	JsonNode* removed = json_shared_remove(extended, "telemetry");
+	JsonNode* missing = json_shared_remove(config, "does_not_exist");
+	EXPECT(missing,						TO_BE(NULL));
+	EXPECT(strcmp(AS_STRING(json_get(config, "supported_platforms", 1)), "Windows"), TO_BE(0));
+	EXPECT(strcmp(AS_STRING(json_get(updated, "supported_platforms", 1)), "Toaster"), TO_BE(0));
+	EXPECT(json_get(updated, "supported_platforms", 0),	TO_BE(json_get(config, "supported_platforms", 0)));
+	EXPECT(json_property(updated, "analytics"),			TO_BE(json_property(config, "analytics")));
+	EXPECT(AS_INT(json_property(extended, "retries")),	TO_BE(3));
+	EXPECT(json_property(updated, "retries"),			TO_BE(NULL));
+	EXPECT(json_property(removed, "telemetry"),			TO_BE(NULL));
+	EXPECT(AS_OBJECT(removed).count,	TO_BE(AS_OBJECT(extended).count - 1));
+	
+	// A clone is a plain, mutable deep copy
+	JsonNode* clone = json_node_clone(updated);
+	EXPECT(IS_FROZEN(clone),			TO_BE(false));
+	EXPECT(json_node_equals(clone, updated), TO_BE(true));
+	json_node_append(json_property(clone, "supported_platforms"), json_null());
+	EXPECT(json_node_equals(clone, updated), TO_BE(false));
+	json_node_free(clone);
+	
+	// Every version owns a reference to what it shares, so they can be released in any order
+	JsonNode* retained = json_shared_retain(config);
+	json_shared_release(config);
+	json_shared_release(updated);
+	json_shared_release(removed);
+	json_shared_release(extended);
+	EXPECT(strcmp(AS_STRING(json_get(retained, "supported_platforms", 4)), "Web"), TO_BE(0));
+	json_shared_release(retained);
+}
+
+// Tests to ensure hashes are stable, cached, and dropped when a tree changes.
+void json_runHashTests(void) {
+	char text[] = "{\"a\":[1,2.5,\"x\",true,null]}";
+	JsonNode* document = json_parse(text, sizeof(text) - 1);
+	// The hash must not change between runs, platforms or versions, it may be stored
+	EXPECT(json_node_hash(document, JSON_HASH_ORDERED),		TO_BE(10602882436292448752ULL));
+	EXPECT(json_node_hash(document, JSON_HASH_UNORDERED),	TO_BE(12806715029855317438ULL));
+	EXPECT(AS_CONTAINER(document)->hashes[JSON_HASH_ORDERED] != 0, TO_BE(true));
+	json_node_free(document);
+	
+	JsonNode* ab = json_object("a", json_int(1), "b", json_array(json_real(-0.0)));
+	JsonNode* ba = json_object("b", json_array(json_real(0.0)), "a", json_int(1));
+	EXPECT(json_node_hash(ab, JSON_HASH_ORDERED) == json_node_hash(ba, JSON_HASH_ORDERED), TO_BE(false));
+	EXPECT(json_node_hash(ab, JSON_HASH_UNORDERED),	TO_BE(json_node_hash(ba, JSON_HASH_UNORDERED)));
+	EXPECT(json_node_equals(ab, ba),	TO_BE(false));
+	
+	// Appending deep inside the tree drops the cached hashes all the way up
+	uint64_t before = json_node_hash(ab, JSON_HASH_UNORDERED);
+	json_node_append(json_property(ab, "b"), json_null());
+	EXPECT(AS_CONTAINER(ab)->hashes[JSON_HASH_UNORDERED],	TO_BE(0));
+	EXPECT(json_node_hash(ab, JSON_HASH_UNORDERED) == before, TO_BE(false));
+	json_node_append(json_property(ba, "b"), json_null());
+	EXPECT(json_node_hash(ab, JSON_HASH_UNORDERED),	TO_BE(json_node_hash(ba, JSON_HASH_UNORDERED)));
+	json_node_free(ab);
+	json_node_free(ba);
+	
+	// A change made directly, once followed by json_node_invalidate, is seen by comparisons and diffs
+	JsonNode* edited = json_object("a", json_array(json_int(1), json_int(2)));
+	JsonNode* target = json_object("a", json_array(json_int(1), json_int(3)));
+	EXPECT(json_node_equals(edited, target), TO_BE(false)); // Caches both trees' hashes
+	AS_INT(json_get(edited, "a", 1)) = 3;
+	json_node_invalidate(json_get(edited, "a", 1));
+	EXPECT(json_node_equals(edited, target), TO_BE(true));
+	AS_INT(json_get(edited, "a", 1)) = 4;
+	json_node_invalidate(json_get(edited, "a", 1));
+	EXPECT(json_node_equals(edited, target), TO_BE(false));
+	JsonNode* stalePatch = json_diff(edited, target);
+	EXPECT(AS_ARRAY(stalePatch).count,	TO_BE(1));
+	json_node_free(stalePatch);
+	json_node_free(edited);
+	json_node_free(target);
+}
+
+// Tests to ensure diffs are minimal, and that applying one turns the first tree into the second.
+void json_runPatchTests(void) {
+	char before[] = "{\"name\":\"json4c\",\"tags\":[\"a\",\"b\",\"c\",\"d\"],\"a/b\":1,\"old\":true,\"deep\":{\"x\":[1,2],\"y\":null}}";
+	char after[] = "{\"name\":\"json4c\",\"tags\":[\"a\",\"b\",\"z\",\"c\",\"d\"],\"a/b\":2,\"deep\":{\"x\":[1,2],\"y\":{\"z\":0}},\"new\":[]}";
+	JsonNode* from = json_parse(before, sizeof(before) - 1);
+	JsonNode* to = json_parse(after, sizeof(after) - 1);
+	JsonNode* patch = json_diff(from, to);
+	char* text = json_toString(patch, JSON_WRITE_CONDENSED);
+	// NOTE: The serializer escapes '/'
+	EXPECT(strcmp(text, "[{\"op\":\"remove\",\"path\":\"\\/old\"},"
+		"{\"op\":\"add\",\"path\":\"\\/tags\\/2\",\"value\":\"z\"},"
+		"{\"op\":\"replace\",\"path\":\"\\/a~1b\",\"value\":2},"
+		"{\"op\":\"replace\",\"path\":\"\\/deep\\/y\",\"value\":{\"z\":0}},"
+		"{\"op\":\"add\",\"path\":\"\\/new\",\"value\":[]}]"), TO_BE(0));
+	free(text);
+	EXPECT(json_patch_apply(&from, patch),	TO_BE(true));
+	EXPECT(json_node_equals(from, to),		TO_BE(true));
+	json_node_free(patch);
+	
+	// Identical trees diff to nothing, and a different root is replaced whole
+	patch = json_diff(from, to);
+	EXPECT(AS_ARRAY(patch).count,			TO_BE(0));
+	json_node_free(patch);
+	JsonNode* number = json_int(4);
+	patch = json_diff(from, number);
+	EXPECT(json_patch_apply(&from, patch),	TO_BE(true));
+	EXPECT(AS_INT(from),					TO_BE(4));
+	json_node_free(patch);
+	json_node_free(number);
+	
+	// Every operation from RFC 6902, and a failing test stopping the patch
+	char ops[] = "[{\"op\":\"copy\",\"from\":\"/tags\",\"path\":\"/copied\"},"
+		"{\"op\":\"move\",\"from\":\"/deep/y/z\",\"path\":\"/tags/-\"},"
+		"{\"op\":\"replace\",\"path\":\"/tags/0\",\"value\":\"first\"},"
+		"{\"op\":\"remove\",\"path\":\"/copied/1\"},"
+		"{\"op\":\"test\",\"path\":\"/tags/5\",\"value\":0}]";
+	patch = json_parse(ops, sizeof(ops) - 1);
+	EXPECT(json_patch_apply(&to, patch),	TO_BE(true));
+	EXPECT(strcmp(AS_STRING(json_get(to, "tags", 0)), "first"), TO_BE(0));
+	EXPECT(AS_INT(json_get(to, "tags", 5)),	TO_BE(0));
+	EXPECT(AS_OBJECT(json_get(to, "deep", "y")).count, TO_BE(0));
+	EXPECT(AS_ARRAY(json_property(to, "copied")).count, TO_BE(4));
+	EXPECT(json_get(to, "tags", 0)->parent,	TO_BE(json_property(to, "tags")));
+	json_node_free(patch);
+	char failing[] = "[{\"op\":\"add\",\"path\":\"/added\",\"value\":1},{\"op\":\"test\",\"path\":\"/added\",\"value\":2},"
+		"{\"op\":\"add\",\"path\":\"/never\",\"value\":1}]";
+	patch = json_parse(failing, sizeof(failing) - 1);
+	EXPECT(json_patch_apply(&to, patch),	TO_BE(false));
+	EXPECT(AS_INT(json_property(to, "added")), TO_BE(1));
+	EXPECT(json_property(to, "never"),		TO_BE(NULL));
+	json_node_free(patch);
+	char leadingZero[] = "[{\"op\":\"remove\",\"path\":\"/tags/01\"}]";
+	char intoItself[] = "[{\"op\":\"move\",\"from\":\"/deep\",\"path\":\"/deep/x/0\"}]";
+	patch = json_parse(leadingZero, sizeof(leadingZero) - 1);
+	EXPECT(json_patch_apply(&to, patch),	TO_BE(false));
+	json_node_free(patch);
+	patch = json_parse(intoItself, sizeof(intoItself) - 1);
+	EXPECT(json_patch_apply(&to, patch),	TO_BE(false));
+	EXPECT(IS_OBJECT(json_property(to, "deep")), TO_BE(true));
+	json_node_free(patch);
+	char lazyOps[] = "[{\"op\":\"\\u0061dd\",\"path\":\"/l\\u0061zy\",\"value\":\"\\u00e9\"}]";
+	char lazyOpsBuffer[sizeof(lazyOps)];
+	memcpy(lazyOpsBuffer, lazyOps, sizeof(lazyOps));
+	patch = json_parseLazy(lazyOpsBuffer, sizeof(lazyOps) - 1); // Read without being decoded
+	EXPECT(json_patch_apply(&to, patch),	TO_BE(true));
+	EXPECT(strcmp(AS_STRING(json_property(to, "lazy")), "\xc3\xa9"), TO_BE(0));
+	EXPECT(IS_UNDECODED(json_get(patch, 0, "path")), TO_BE(true));
+	EXPECT(memcmp(lazyOpsBuffer, lazyOps, sizeof(lazyOps)), TO_BE(0));
+	json_node_free(patch);
+	json_node_free(from);
+	json_node_free(to);
+	
+	// Merge patches, where null removes a member
+	char target[] = "{\"a\":\"b\",\"c\":{\"d\":\"e\",\"f\":\"g\"},\"list\":[1,2]}";
+	char merge[] = "{\"a\":\"z\",\"c\":{\"f\":null},\"list\":[3],\"h\":{\"i\":null,\"j\":1}}";
+	JsonNode* document = json_parse(target, sizeof(target) - 1);
+	JsonNode* mergePatch = json_parse(merge, sizeof(merge) - 1);
+	JsonNode* original = json_node_clone(document);
+	EXPECT(json_patch_applyMerge(&document, mergePatch), TO_BE(true));
+	text = json_toString(document, JSON_WRITE_CONDENSED);
+	EXPECT(strcmp(text, "{\"a\":\"z\",\"c\":{\"d\":\"e\"},\"list\":[3],\"h\":{\"j\":1}}"), TO_BE(0));
+	free(text);
+	JsonNode* diff = json_diffMerge(original, document);
+	text = json_toString(diff, JSON_WRITE_CONDENSED);
+	EXPECT(strcmp(text, "{\"a\":\"z\",\"c\":{\"f\":null},\"list\":[3],\"h\":{\"j\":1}}"), TO_BE(0));
+	free(text);
+	EXPECT(json_patch_applyMerge(&original, diff), TO_BE(true));
+	EXPECT(json_node_equals(original, document), TO_BE(true));
+	json_node_free(diff);
+	json_node_free(original);
+	json_node_free(mergePatch);
+	json_node_free(document);
+}
+
+static bool _writeSample(JsonWriter* writer) {
+	json_writer_beginObject(writer);
+	json_writer_key(writer, "a");
+	json_writer_beginArray(writer);
+	json_writer_int64(writer, 1);
+	json_writer_real(writer, 2.5);
+	json_writer_beginObject(writer);
+	json_writer_endObject(writer);
+	json_writer_beginArray(writer);
+	json_writer_endArray(writer);
+	json_writer_string(writer, "x/y");
+	json_writer_endArray(writer);
+	json_writer_key(writer, "b");
+	json_writer_beginObject(writer);
+	json_writer_key(writer, "c");
+	json_writer_null(writer);
+	json_writer_endObject(writer);
+	json_writer_endObject(writer);
+	return json_writer_finish(writer);
+}
+
+// Tests to ensure the streaming writer writes what the serializer would, and refuses calls out of place.
+void json_runWriterTests(void) {
+	char* layouts[] = {
+		"{\"a\":[1,2.5,{},[],\"x\\/y\"],\"b\":{\"c\":null}}",
+		"{\n\t\"a\": [\n\t\t1,\n\t\t2.5,\n\t\t{},\n\t\t[],\n\t\t\"x\\/y\"\n\t],\n\t\"b\": {\n\t\t\"c\": null\n\t}\n}"
+	};
+	enum JsonWriteOption layoutOptions[] = { JSON_WRITE_CONDENSED, JSON_WRITE_PRETTY };
+	for (int i = 0; i < 2; i++) {
+		JsonWriter* writer = json_writer_create(layoutOptions[i]);
+		EXPECT(_writeSample(writer),		TO_BE(true));
+		ptrdiff_t length;
+		const char* text = json_writer_text(writer, &length);
+		EXPECT(strcmp(text, layouts[i]),	TO_BE(0));
+		EXPECT(length,						TO_BE((ptrdiff_t)strlen(layouts[i])));
+		JsonNode* parsed = json_parse((char*)text, length);
+		char* serialized = json_toString(parsed, JSON_WRITE_CONDENSED);
+		EXPECT(strcmp(serialized, layouts[0]), TO_BE(0));
+		free(serialized);
+		json_node_free(parsed);
+		// The next document reuses the buffer
+		char* buffer = writer->buffer;
+		json_writer_reset(writer);
+		EXPECT(json_writer_text(writer, NULL), TO_BE(NULL));
+		EXPECT(_writeSample(writer),		TO_BE(true));
+		EXPECT(strcmp(json_writer_text(writer, NULL), layouts[i]), TO_BE(0));
+		EXPECT(writer->buffer == buffer,	TO_BE(true));
+		json_writer_destroy(writer);
+	}
+	EXPECT(json_writer_create(JSON_WRITE_CANONICAL), TO_BE(NULL));
+
+	// Scalars, as the root too
+	JsonWriter* writer = json_writer_create(JSON_WRITE_CONDENSED | JSON_WRITE_ASCII);
+	json_writer_beginArray(writer);
+	json_writer_int64(writer, INT64_MIN);
+	json_writer_bool(writer, true);
+	json_writer_bool(writer, false);
+	json_writer_string(writer, "caf\xc3\xa9 \"q\"\n");
+	json_writer_stringN(writer, "a\0b", 3);
+	json_writer_beginObject(writer);
+	json_writer_keyN(writer, "k\0", 2);
+	json_writer_real(writer, -0.125);
+	json_writer_endObject(writer);
+	json_writer_endArray(writer);
+	EXPECT(json_writer_finish(writer),	TO_BE(true));
+	EXPECT(strcmp(json_writer_text(writer, NULL),
+		"[-9223372036854775808,true,false,\"caf\\u00e9 \\\"q\\\"\\n\",\"a\\u0000b\",{\"k\\u0000\":-0.125}]"), TO_BE(0));
+	json_writer_reset(writer);
+	EXPECT(json_writer_string(writer, "root"), TO_BE(true));
+	EXPECT(json_writer_finish(writer),	TO_BE(true));
+	EXPECT(strcmp(json_writer_text(writer, NULL), "\"root\""), TO_BE(0));
+
+	// Calls out of place fail the writer, and the ones after them are ignored
+	json_writer_reset(writer);
+	json_writer_beginObject(writer);
+	EXPECT(json_writer_int64(writer, 1), TO_BE(false)); // No key
+	EXPECT(writer->error.code,			TO_BE(JSON_ERROR_INVALID_WRITE));
+	EXPECT(writer->error.offset,		TO_BE(1));
+	EXPECT(json_writer_key(writer, "a"), TO_BE(false));
+	EXPECT(json_writer_finish(writer),	TO_BE(false));
+	EXPECT(json_writer_text(writer, NULL), TO_BE(NULL));
+	json_writer_reset(writer);
+	json_writer_beginArray(writer);
+	EXPECT(json_writer_key(writer, "a"), TO_BE(false));
+	json_writer_reset(writer);
+	json_writer_beginArray(writer);
+	EXPECT(json_writer_endObject(writer), TO_BE(false));
+	json_writer_reset(writer);
+	json_writer_beginObject(writer);
+	json_writer_key(writer, "a");
+	EXPECT(json_writer_key(writer, "b"), TO_BE(false));
+	json_writer_reset(writer);
+	json_writer_beginObject(writer);
+	json_writer_key(writer, "a");
+	EXPECT(json_writer_endObject(writer), TO_BE(false)); // The key has no value
+	json_writer_reset(writer);
+	json_writer_null(writer);
+	EXPECT(json_writer_null(writer),	TO_BE(false)); // A second root
+	json_writer_reset(writer);
+	json_writer_beginArray(writer);
+	EXPECT(json_writer_real(writer, NAN), TO_BE(false)); // JSON has no NaN or infinities
+	EXPECT(writer->error.code,			TO_BE(JSON_ERROR_INVALID_WRITE));
+	json_writer_reset(writer);
+	EXPECT(json_writer_real(writer, -INFINITY), TO_BE(false));
+	json_writer_reset(writer);
+	EXPECT(json_writer_endArray(writer), TO_BE(false));
+	json_writer_reset(writer);
+	EXPECT(json_writer_finish(writer),	TO_BE(false)); // Nothing written
+	json_writer_reset(writer);
+	json_writer_beginArray(writer);
+	EXPECT(json_writer_finish(writer),	TO_BE(false)); // Still open
+	json_writer_reset(writer);
+	for (int i = 0; i < JSON_WRITER_MAX_DEPTH; i++) {
+		json_writer_beginArray(writer);
+	}
+	EXPECT(writer->error.code,			TO_BE(JSON_ERROR_NONE));
+	EXPECT(json_writer_beginArray(writer), TO_BE(false));
+	json_writer_destroy(writer);
+
+	// A sink is given the output in blocks, the same output the buffer would have held
+	JsonWriter* buffered = json_writer_create(JSON_WRITE_PRETTY);
+	TestSink sink = { malloc(16), 16, 0, PTRDIFF_MAX };
+	JsonWriter* streamed = json_writer_createSink((JsonSink){ _collect, &sink }, JSON_WRITE_PRETTY);
+	JsonWriter* both[] = { buffered, streamed };
+	for (int i = 0; i < 2; i++) {
+		json_writer_beginArray(both[i]);
+		for (int j = 0; j < 5000; j++) {
+			json_writer_beginObject(both[i]);
+			json_writer_key(both[i], "id");
+			json_writer_int64(both[i], j);
+			json_writer_key(both[i], "name");
+			json_writer_string(both[i], "some name or other");
+			json_writer_endObject(both[i]);
+		}
+		json_writer_endArray(both[i]);
+		EXPECT(json_writer_finish(both[i]), TO_BE(true));
+	}
+	ptrdiff_t length;
+	const char* text = json_writer_text(buffered, &length);
+	EXPECT(sink.offset,					TO_BE(length));
+	EXPECT(memcmp(sink.bytes, text, length), TO_BE(0));
+	EXPECT(json_writer_text(streamed, NULL), TO_BE(NULL));
+	EXPECT(streamed->length <= 2 * JSON_SINK_BUFFER_SIZE, TO_BE(true));
+	json_writer_reset(streamed);
+	sink.offset = 0;
+	sink.limit = JSON_SINK_BUFFER_SIZE;
+	json_writer_beginArray(streamed);
+	for (int j = 0; j < 5000 && json_writer_string(streamed, "some name or other"); j++);
+	EXPECT(streamed->error.code,		TO_BE(JSON_ERROR_OUTPUT));
+	free(sink.bytes);
+	json_writer_destroy(streamed);
+	json_writer_destroy(buffered);
+}
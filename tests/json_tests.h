@@ -1,11 +1,20 @@
 #ifndef JSON4C_TESTS
 #define JSON4C_TESTS
 
+extern int json_failedExpectations;
+
 void json_initTests(void);
 void json_runTests(void);
 void json_runNodeTests(void);
 void json_runParserTests(void);
 void json_runSerializerTests(void);
 void json_runUtilsTests(void);
+void json_runContextTests(void);
+void json_runStatsTests(void);
+void json_runPoolTests(void);
+void json_runSharedTests(void);
+void json_runHashTests(void);
+void json_runPatchTests(void);
+void json_runWriterTests(void);
 
 #endif // JSON4C_TESTS
@@ -7,5 +7,9 @@ int main(void) {
 	json_initTests();
 	json_runTests();
 	puts("tests finished");
+	if (json_failedExpectations > 0) {
+		printf("%d expectation(s) failed\n", json_failedExpectations);
+		return 1;
+	}
 	return 0;
 }